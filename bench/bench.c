@@ -0,0 +1,31 @@
+/*
+ * << Haru Free PDF Library >> -- bench.c
+ *
+ * URL: http://libharu.org
+ *
+ * Permission to use, copy, modify, distribute and sell this software
+ * and its documentation for any purpose is hereby granted without fee,
+ * provided that the above copyright notice appear in all copies and
+ * that both that copyright notice and this permission notice appear
+ * in supporting documentation.
+ * It is provided "as is" without express or implied warranty.
+ *
+ */
+
+#include "bench.h"
+
+double
+bench_now  (void)
+{
+    return (double)clock () / CLOCKS_PER_SEC;
+}
+
+
+void
+bench_report  (const char  *name,
+               double       elapsed,
+               long         iterations)
+{
+    printf ("%-32s %10ld iter %9.3f s %10.1f ns/iter\n", name, iterations,
+            elapsed, elapsed * 1e9 / (iterations > 0 ? iterations : 1));
+}
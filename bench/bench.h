@@ -0,0 +1,33 @@
+/*
+ * << Haru Free PDF Library >> -- bench.h
+ *
+ * URL: http://libharu.org
+ *
+ * Permission to use, copy, modify, distribute and sell this software
+ * and its documentation for any purpose is hereby granted without fee,
+ * provided that the above copyright notice appear in all copies and
+ * that both that copyright notice and this permission notice appear
+ * in supporting documentation.
+ * It is provided "as is" without express or implied warranty.
+ *
+ */
+
+#ifndef _HPDF_BENCH_H
+#define _HPDF_BENCH_H
+
+#include <stdio.h>
+#include <time.h>
+
+/* process CPU time in seconds, good enough for comparing two
+ * implementations within the same run.
+ */
+double
+bench_now  (void);
+
+
+void
+bench_report  (const char  *name,
+               double       elapsed,
+               long         iterations);
+
+#endif /* _HPDF_BENCH_H */
@@ -0,0 +1,151 @@
+/*
+ * << Haru Free PDF Library >> -- bench_cidwidth.c
+ *
+ * URL: http://libharu.org
+ *
+ * Permission to use, copy, modify, distribute and sell this software
+ * and its documentation for any purpose is hereby granted without fee,
+ * provided that the above copyright notice appear in all copies and
+ * that both that copyright notice and this permission notice appear
+ * in supporting documentation.
+ * It is provided "as is" without express or implied warranty.
+ *
+ */
+
+#include <stdlib.h>
+#include "hpdf.h"
+#include "hpdf_font.h"
+#include "bench.h"
+
+#define NUM_ROUNDS    200
+#define MAX_CID       9000
+#define TEXT_CHARS    2000
+#define TEXT_ROUNDS   2000
+
+
+static void
+error_handler  (HPDF_STATUS   error_no,
+                HPDF_STATUS   detail_no,
+                void         *user_data)
+{
+    HPDF_UNUSED (user_data);
+
+    printf ("ERROR: error_no=%04X, detail_no=%u\n", (HPDF_UINT)error_no,
+            (HPDF_UINT)detail_no);
+    exit (1);
+}
+
+
+/* the linear scan of the widths list HPDF_CIDFontDef_GetCIDWidth used
+ * before */
+static HPDF_INT16
+LegacyGetCIDWidth  (HPDF_FontDef  fontdef,
+                    HPDF_UINT16   cid)
+{
+    HPDF_CIDFontDefAttr attr = (HPDF_CIDFontDefAttr)fontdef->attr;
+    HPDF_UINT i;
+
+    for (i = 0; i < attr->widths->count; i++) {
+        HPDF_CID_Width *w = (HPDF_CID_Width *)HPDF_List_ItemAt (attr->widths,
+                i);
+
+        if (w->cid == cid)
+            return w->width;
+    }
+
+    return attr->DW;
+}
+
+
+typedef HPDF_INT16 (*GetCIDWidthFunc) (HPDF_FontDef, HPDF_UINT16);
+static GetCIDWidthFunc volatile legacy_fn = LegacyGetCIDWidth;
+static GetCIDWidthFunc volatile current_fn = HPDF_CIDFontDef_GetCIDWidth;
+
+
+static long
+lookup_all  (GetCIDWidthFunc  fn,
+             HPDF_FontDef     fontdef)
+{
+    long sum = 0;
+    HPDF_UINT cid;
+    int round;
+
+    for (round = 0; round < NUM_ROUNDS; round++)
+        for (cid = 0; cid < MAX_CID; cid++)
+            sum += fn (fontdef, (HPDF_UINT16)cid);
+
+    return sum;
+}
+
+
+int
+main  (void)
+{
+    HPDF_Doc pdf;
+    HPDF_Page page;
+    HPDF_Font font;
+    HPDF_FontDef fontdef;
+    const long iterations = (long)NUM_ROUNDS * MAX_CID;
+    char text[TEXT_CHARS * 2 + 1];
+    long legacy_sum;
+    long current_sum;
+    HPDF_REAL width = 0;
+    HPDF_UINT cid;
+    HPDF_UINT mismatches = 0;
+    double start;
+    double elapsed;
+    int i;
+
+    pdf = HPDF_New (error_handler, NULL);
+    HPDF_UseKRFonts (pdf);
+    HPDF_UseKREncodings (pdf);
+    page = HPDF_AddPage (pdf);
+    font = HPDF_GetFont (pdf, "Dotum", "KSCms-UHC-H");
+    fontdef = ((HPDF_FontAttr)font->attr)->fontdef;
+    HPDF_Page_SetFontAndSize (page, font, 10);
+
+    printf ("Dotum: %u widths\n",
+            ((HPDF_CIDFontDefAttr)fontdef->attr)->widths->count);
+
+    for (cid = 0; cid < MAX_CID; cid++)
+        if (legacy_fn (fontdef, (HPDF_UINT16)cid) !=
+                current_fn (fontdef, (HPDF_UINT16)cid))
+            mismatches++;
+
+    start = bench_now ();
+    legacy_sum = lookup_all (legacy_fn, fontdef);
+    elapsed = bench_now () - start;
+    bench_report ("linear scan", elapsed, iterations);
+
+    start = bench_now ();
+    current_sum = lookup_all (current_fn, fontdef);
+    elapsed = bench_now () - start;
+    bench_report ("HPDF_CIDFontDef_GetCIDWidth", elapsed, iterations);
+
+    /* hangul syllables of KS X 1001 mixed with ascii */
+    for (i = 0; i < TEXT_CHARS; i++) {
+        if (i % 8 == 7) {
+            text[i * 2] = ' ';
+            text[i * 2 + 1] = (char)('a' + i % 26);
+        } else {
+            text[i * 2] = (char)(0xB0 + i % 25);
+            text[i * 2 + 1] = (char)(0xA1 + (i * 7) % 94);
+        }
+    }
+    text[TEXT_CHARS * 2] = 0;
+
+    start = bench_now ();
+    for (i = 0; i < TEXT_ROUNDS; i++)
+        width += HPDF_Page_TextWidth (page, text);
+    elapsed = bench_now () - start;
+    bench_report ("HPDF_Page_TextWidth (CJK)", elapsed,
+            (long)TEXT_ROUNDS * TEXT_CHARS);
+    printf ("%-32s %10.0f chars/s\n", "",
+            (double)TEXT_ROUNDS * TEXT_CHARS / elapsed);
+
+    printf ("mismatches: %u, width %.1f\n", mismatches,
+            width / TEXT_ROUNDS);
+    HPDF_Free (pdf);
+
+    return (mismatches == 0 && legacy_sum == current_sum) ? 0 : 1;
+}
@@ -0,0 +1,109 @@
+/*
+ * << Haru Free PDF Library >> -- bench_cmaptables.c
+ *
+ * URL: http://libharu.org
+ *
+ * Permission to use, copy, modify, distribute and sell this software
+ * and its documentation for any purpose is hereby granted without fee,
+ * provided that the above copyright notice appear in all copies and
+ * that both that copyright notice and this permission notice appear
+ * in supporting documentation.
+ * It is provided "as is" without express or implied warranty.
+ *
+ */
+
+#include <stdlib.h>
+#include "hpdf.h"
+#include "bench.h"
+
+#define NUM_DOCS  50
+
+static const char * const ENCODING_NAMES[] = {
+    "90ms-RKSJ-H", "90ms-RKSJ-V", "90msp-RKSJ-H", "EUC-H", "EUC-V",
+    "KSCms-UHC-H", "KSCms-UHC-HW-H", "KSCms-UHC-HW-V", "KSC-EUC-H",
+    "KSC-EUC-V", "GBK-EUC-H", "GBK-EUC-V", "GB-EUC-H", "GB-EUC-V",
+    "ETen-B5-H", "ETen-B5-V", "UTF-8", NULL
+};
+
+
+static void
+error_handler  (HPDF_STATUS   error_no,
+                HPDF_STATUS   detail_no,
+                void         *user_data)
+{
+    HPDF_UNUSED (user_data);
+
+    printf ("ERROR: error_no=%04X, detail_no=%u\n", (HPDF_UINT)error_no,
+            (HPDF_UINT)detail_no);
+    exit (1);
+}
+
+
+/* creates documents which each use every CJK encoder and write a line of
+ * japanese text. the tables are rebuilt for every document when they are
+ * freed in between, as they were before they were shared.
+ */
+static HPDF_UINT32
+make_docs  (HPDF_BOOL  share)
+{
+    HPDF_UINT32 size = 0;
+    int i;
+
+    for (i = 0; i < NUM_DOCS; i++) {
+        HPDF_Doc pdf = HPDF_New (error_handler, NULL);
+        const char * const *name;
+        HPDF_Page page;
+
+        HPDF_UseJPEncodings (pdf);
+        HPDF_UseKREncodings (pdf);
+        HPDF_UseCNSEncodings (pdf);
+        HPDF_UseCNTEncodings (pdf);
+        HPDF_UseUTFEncodings (pdf);
+        HPDF_UseJPFonts (pdf);
+
+        for (name = ENCODING_NAMES; *name; name++)
+            HPDF_GetEncoder (pdf, *name);
+
+        page = HPDF_AddPage (pdf);
+        HPDF_Page_SetFontAndSize (page,
+                HPDF_GetFont (pdf, "MS-Mincho", "90ms-RKSJ-H"), 12);
+        HPDF_Page_BeginText (page);
+        HPDF_Page_TextOut (page, 50, 700,
+                "\x82\xb1\x82\xf1\x82\xc9\x82\xbf\x82\xcd");
+        HPDF_Page_EndText (page);
+
+        HPDF_SaveToStream (pdf);
+        size += HPDF_GetStreamSize (pdf);
+        HPDF_Free (pdf);
+
+        if (!share)
+            HPDF_FreeFontCache ();
+    }
+
+    return size;
+}
+
+
+int
+main  (void)
+{
+    HPDF_UINT32 rebuilt_size;
+    HPDF_UINT32 shared_size;
+    double start;
+
+    start = bench_now ();
+    rebuilt_size = make_docs (HPDF_FALSE);
+    bench_report ("tables built per document", bench_now () - start,
+            NUM_DOCS);
+
+    start = bench_now ();
+    shared_size = make_docs (HPDF_TRUE);
+    bench_report ("tables shared", bench_now () - start, NUM_DOCS);
+
+    HPDF_FreeFontCache ();
+
+    printf ("output size: %u / %u\n", (HPDF_UINT)rebuilt_size,
+            (HPDF_UINT)shared_size);
+
+    return rebuilt_size == shared_size ? 0 : 1;
+}
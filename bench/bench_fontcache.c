@@ -0,0 +1,90 @@
+/*
+ * << Haru Free PDF Library >> -- bench_fontcache.c
+ *
+ * URL: http://libharu.org
+ *
+ * Permission to use, copy, modify, distribute and sell this software
+ * and its documentation for any purpose is hereby granted without fee,
+ * provided that the above copyright notice appear in all copies and
+ * that both that copyright notice and this permission notice appear
+ * in supporting documentation.
+ * It is provided "as is" without express or implied warranty.
+ *
+ */
+
+#include <stdlib.h>
+#include "hpdf.h"
+#include "bench.h"
+
+#define NUM_DOCS  200
+
+
+static void
+error_handler  (HPDF_STATUS   error_no,
+                HPDF_STATUS   detail_no,
+                void         *user_data)
+{
+    HPDF_UNUSED (user_data);
+
+    printf ("ERROR: error_no=%04X, detail_no=%u\n", (HPDF_UINT)error_no,
+            (HPDF_UINT)detail_no);
+    exit (1);
+}
+
+
+/* creates documents which each load the same font, as a server rendering
+ * one document per request would.
+ */
+static void
+load_docs  (const char  *path,
+            HPDF_BOOL    use_cache)
+{
+    int i;
+
+    for (i = 0; i < NUM_DOCS; i++) {
+        HPDF_Doc pdf = HPDF_New (error_handler, NULL);
+
+        if (use_cache)
+            HPDF_UseFontCache (pdf);
+
+        HPDF_LoadTTFontFromFile (pdf, path, HPDF_TRUE);
+        HPDF_Free (pdf);
+    }
+}
+
+
+static void
+bench_font  (const char  *path)
+{
+    double start;
+
+    printf ("%s\n", path);
+
+    start = bench_now ();
+    load_docs (path, HPDF_FALSE);
+    bench_report ("without font cache", bench_now () - start, NUM_DOCS);
+
+    start = bench_now ();
+    load_docs (path, HPDF_TRUE);
+    bench_report ("with font cache", bench_now () - start, NUM_DOCS);
+
+    HPDF_FreeFontCache ();
+}
+
+
+int
+main  (int     argc,
+       char  **argv)
+{
+    int i;
+
+    if (argc < 2) {
+        bench_font (BENCH_DEMO_DIR "/ttfont/PenguinAttack.ttf");
+        return 0;
+    }
+
+    for (i = 1; i < argc; i++)
+        bench_font (argv[i]);
+
+    return 0;
+}
@@ -0,0 +1,121 @@
+/*
+ * << Haru Free PDF Library >> -- bench_fontsave.c
+ *
+ * URL: http://libharu.org
+ *
+ * Permission to use, copy, modify, distribute and sell this software
+ * and its documentation for any purpose is hereby granted without fee,
+ * provided that the above copyright notice appear in all copies and
+ * that both that copyright notice and this permission notice appear
+ * in supporting documentation.
+ * It is provided "as is" without express or implied warranty.
+ *
+ */
+
+#include <stdlib.h>
+#include "hpdf.h"
+#include "hpdf_font.h"
+#include "bench.h"
+
+#define NUM_ROUNDS  5
+
+
+static void
+error_handler  (HPDF_STATUS   error_no,
+                HPDF_STATUS   detail_no,
+                void         *user_data)
+{
+    HPDF_UNUSED (user_data);
+
+    printf ("ERROR: error_no=%04X, detail_no=%u\n", (HPDF_UINT)error_no,
+            (HPDF_UINT)detail_no);
+    exit (1);
+}
+
+
+/* the font data is written by worker threads, so the time spent on them
+ * is measured by the wall clock.
+ */
+static double
+wall_now  (void)
+{
+    struct timespec ts;
+
+    timespec_get (&ts, TIME_UTC);
+    return (double)ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+/* embeds the fonts with every character of the BMP used and saves the
+ * document with compression. returns the size of the document.
+ */
+static HPDF_UINT32
+save_fonts  (const char  **paths,
+             int           count)
+{
+    HPDF_Doc pdf = HPDF_New (error_handler, NULL);
+    HPDF_UINT32 size;
+    int i;
+
+    HPDF_SetCompressionMode (pdf, HPDF_COMP_ALL);
+    HPDF_AddPage (pdf);
+
+    for (i = 0; i < count; i++) {
+        HPDF_Font font = HPDF_GetFont (pdf, HPDF_LoadTTFontFromFile (pdf,
+                paths[i], HPDF_TRUE), NULL);
+        HPDF_FontDef fontdef = ((HPDF_FontAttr)font->attr)->fontdef;
+        HPDF_UINT code;
+
+        for (code = 0x20; code <= 0xFFFF; code++)
+            HPDF_TTFontDef_GetCharWidth (fontdef, code);
+    }
+
+    HPDF_SaveToStream (pdf);
+    size = HPDF_GetStreamSize (pdf);
+    HPDF_Free (pdf);
+
+    return size;
+}
+
+
+int
+main  (int     argc,
+       char  **argv)
+{
+    const char **paths = (const char **)argv + 1;
+    int count = argc - 1;
+    HPDF_UINT32 serial_size = 0;
+    HPDF_UINT32 parallel_size = 0;
+    double start;
+    int round;
+    int i;
+
+    /* fonts of the same file are loaded once, so give several files */
+    if (count < 2) {
+        printf ("usage: %s font.ttf font.ttf ...\n", argv[0]);
+        return 1;
+    }
+
+    /* a document with a single font writes it while the objects are
+     * written, as every document did before.
+     */
+    start = wall_now ();
+    for (round = 0; round < NUM_ROUNDS; round++) {
+        serial_size = 0;
+        for (i = 0; i < count; i++)
+            serial_size += save_fonts (paths + i, 1);
+    }
+    bench_report ("one font per document", wall_now () - start,
+            NUM_ROUNDS);
+
+    start = wall_now ();
+    for (round = 0; round < NUM_ROUNDS; round++)
+        parallel_size = save_fonts (paths, count);
+    bench_report ("all fonts in one document", wall_now () - start,
+            NUM_ROUNDS);
+
+    printf ("%d fonts, document size: %u / %u\n", count, serial_size,
+            parallel_size);
+
+    return (parallel_size > 0) ? 0 : 1;
+}
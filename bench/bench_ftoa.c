@@ -0,0 +1,200 @@
+/*
+ * << Haru Free PDF Library >> -- bench_ftoa.c
+ *
+ * URL: http://libharu.org
+ *
+ * Permission to use, copy, modify, distribute and sell this software
+ * and its documentation for any purpose is hereby granted without fee,
+ * provided that the above copyright notice appear in all copies and
+ * that both that copyright notice and this permission notice appear
+ * in supporting documentation.
+ * It is provided "as is" without express or implied warranty.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "hpdf_consts.h"
+#include "hpdf_utils.h"
+#include "bench.h"
+
+#define NUM_VALUES  4096
+#define NUM_ROUNDS  2000
+
+/* the digit-loop formatter HPDF_FToA2 used to be, kept as the reference
+ * for both speed and output.
+ */
+static char*
+LegacyFToA2  (char       *s,
+              HPDF_REAL   val,
+              char       *eptr,
+              HPDF_UINT   decimal_places)
+{
+    HPDF_INT32 int_val;
+    HPDF_INT32 fpart_val;
+    char buf[HPDF_REAL_LEN + 1];
+    char* sptr = s;
+    char* t;
+    HPDF_UINT32 i;
+    HPDF_REAL round;
+
+    if (val > HPDF_LIMIT_MAX_REAL)
+        val = HPDF_LIMIT_MAX_REAL;
+    else
+    if (val < HPDF_LIMIT_MIN_REAL)
+        val = HPDF_LIMIT_MIN_REAL;
+
+    t = buf + HPDF_REAL_LEN;
+    *t-- = 0;
+
+    if (val < 0) {
+        *s++ = '-';
+        val = -val;
+    }
+
+    round = 0.5f / HPDF_DECIMAL_ROUND_COEFFICIENT[decimal_places];
+    int_val = (HPDF_INT32)(val + round);
+    fpart_val = (HPDF_INT32)((HPDF_REAL)(val - int_val + round) *
+            HPDF_DECIMAL_ROUND_COEFFICIENT[decimal_places]);
+
+    for (i = 0; i < decimal_places; i++) {
+        *t = (char)((char)(fpart_val % 10) + '0');
+        fpart_val /= 10;
+        t--;
+    }
+
+    *t-- = '.';
+    *t = '0';
+    if (int_val == 0)
+        t--;
+
+    while (int_val > 0) {
+        *t = (char)((char)(int_val % 10) + '0');
+        int_val /= 10;
+        t--;
+    }
+
+    t++;
+    while (s <= eptr && *t != 0)
+        *s++ = *t++;
+    s--;
+
+    while (s > sptr) {
+        if (*s == '0')
+            *s = 0;
+        else {
+            if (*s == '.')
+                *s = 0;
+            break;
+        }
+        s--;
+    }
+
+    return (*s == 0) ? s : ++s;
+}
+
+
+static int
+verify  (const HPDF_REAL  *values,
+         int               count)
+{
+    char expected[HPDF_TMP_BUF_SIZ];
+    char actual[HPDF_TMP_BUF_SIZ];
+    HPDF_UINT places;
+    int mismatches = 0;
+    int i;
+
+    for (places = 0; places <= HPDF_MAX_DECIMAL_PLACES; places++) {
+        for (i = 0; i < count; i++) {
+            char *e;
+            char *a;
+
+            memset (expected, 0, sizeof(expected));
+            memset (actual, 0x7f, sizeof(actual));
+            e = LegacyFToA2 (expected, values[i], expected +
+                    sizeof(expected) - 1, places);
+            a = HPDF_FToA2 (actual, values[i], actual + sizeof(actual) - 1,
+                    places);
+
+            if (e - expected != a - actual ||
+                    memcmp (expected, actual, e - expected) != 0) {
+                if (mismatches++ < 10)
+                    printf ("mismatch: %.9g (%u places) legacy '%s' "
+                            "new '%.*s'\n", values[i], places, expected,
+                            (int)(a - actual), actual);
+            }
+        }
+    }
+
+    return mismatches;
+}
+
+
+typedef char* (*FToA2Func)  (char       *s,
+                             HPDF_REAL   val,
+                             char       *eptr,
+                             HPDF_UINT   decimal_places);
+
+/* called through pointers so that neither side gets inlined into the loop */
+static FToA2Func volatile legacy_fn = LegacyFToA2;
+static FToA2Func volatile current_fn = HPDF_FToA2;
+
+
+static double
+run  (FToA2Func         fn,
+      const HPDF_REAL  *values,
+      unsigned long    *sink)
+{
+    char buf[HPDF_TMP_BUF_SIZ];
+    char *eptr = buf + HPDF_TMP_BUF_SIZ - 1;
+    double start = bench_now ();
+    int round;
+    int i;
+
+    for (round = 0; round < NUM_ROUNDS; round++)
+        for (i = 0; i < NUM_VALUES; i++)
+            *sink += (unsigned long)(fn (buf, values[i], eptr,
+                        HPDF_DEF_TEXT_PLACEMENT_ACCURACY) - buf);
+
+    return bench_now () - start;
+}
+
+
+int
+main  (void)
+{
+    static HPDF_REAL values[NUM_VALUES];
+    unsigned long sink = 0;
+    int mismatches;
+    int i;
+
+    /* coordinates as they come out of typical vector drawing code */
+    srand (1);
+    for (i = 0; i < NUM_VALUES; i++) {
+        switch (i % 4) {
+            case 0:
+                values[i] = (HPDF_REAL)(rand () % 842);
+                break;
+            case 1:
+                values[i] = (HPDF_REAL)(rand () % 84200) / 100;
+                break;
+            case 2:
+                values[i] = (HPDF_REAL)rand () / RAND_MAX * 1190 - 595;
+                break;
+            default:
+                values[i] = (HPDF_REAL)rand () / RAND_MAX;
+        }
+    }
+
+    mismatches = verify (values, NUM_VALUES);
+    printf ("output check: %d mismatches\n", mismatches);
+
+    bench_report ("legacy FToA2", run (legacy_fn, values, &sink),
+            (long)NUM_ROUNDS * NUM_VALUES);
+    bench_report ("HPDF_FToA2", run (current_fn, values, &sink),
+            (long)NUM_ROUNDS * NUM_VALUES);
+
+    printf ("(checksum %lu)\n", sink);
+
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,160 @@
+/*
+ * << Haru Free PDF Library >> -- bench_glyphid.c
+ *
+ * URL: http://libharu.org
+ *
+ * Permission to use, copy, modify, distribute and sell this software
+ * and its documentation for any purpose is hereby granted without fee,
+ * provided that the above copyright notice appear in all copies and
+ * that both that copyright notice and this permission notice appear
+ * in supporting documentation.
+ * It is provided "as is" without express or implied warranty.
+ *
+ */
+
+#include <stdlib.h>
+#include "hpdf.h"
+#include "hpdf_font.h"
+#include "bench.h"
+
+#define NUM_ROUNDS  50
+
+
+static void
+error_handler  (HPDF_STATUS   error_no,
+                HPDF_STATUS   detail_no,
+                void         *user_data)
+{
+    HPDF_UNUSED (user_data);
+
+    printf ("ERROR: error_no=%04X, detail_no=%u\n", (HPDF_UINT)error_no,
+            (HPDF_UINT)detail_no);
+    exit (1);
+}
+
+
+/* the linear segment scan HPDF_TTFontDef_GetGlyphid used before */
+static HPDF_UINT16
+LegacyGetGlyphid  (HPDF_FontDef   fontdef,
+                   HPDF_UINT32    unicode)
+{
+    HPDF_TTFontDefAttr attr = (HPDF_TTFontDefAttr)fontdef->attr;
+    HPDF_UINT16 *pend_count = attr->cmap.end_count;
+    HPDF_UINT seg_count = attr->cmap.seg_count_x2 / 2;
+    HPDF_UINT i;
+
+    if (attr->cmap.format == 0) {
+        unicode &= 0xFF;
+        return attr->cmap.glyph_id_array[unicode];
+    }
+
+    for (i = 0; i < seg_count; i++) {
+        if (unicode <= *pend_count)
+            break;
+        pend_count++;
+    }
+
+    if (i == seg_count || attr->cmap.start_count[i] > unicode)
+        return 0;
+
+    if (attr->cmap.id_range_offset[i] == 0)
+        return (HPDF_UINT16)(unicode + attr->cmap.id_delta[i]);
+    else {
+        HPDF_UINT idx = attr->cmap.id_range_offset[i] / 2 +
+            (unicode - attr->cmap.start_count[i]) - (seg_count - i);
+
+        if (idx > attr->cmap.glyph_id_array_count)
+            return 0;
+
+        return (HPDF_UINT16)(attr->cmap.glyph_id_array[idx] +
+                attr->cmap.id_delta[i]);
+    }
+}
+
+
+/* called through pointers, so neither version is inlined into the loop */
+typedef HPDF_UINT16 (*GetGlyphidFunc) (HPDF_FontDef, HPDF_UINT32);
+static GetGlyphidFunc volatile legacy_fn = LegacyGetGlyphid;
+static GetGlyphidFunc volatile current_fn = HPDF_TTFontDef_GetGlyphid;
+
+
+static unsigned long
+lookup_all  (GetGlyphidFunc  fn,
+             HPDF_FontDef    fontdef)
+{
+    unsigned long sum = 0;
+    HPDF_UINT code;
+    int round;
+
+    for (round = 0; round < NUM_ROUNDS; round++)
+        for (code = 0x20; code <= 0xFFFF; code++)
+            sum += fn (fontdef, code);
+
+    return sum;
+}
+
+
+static int
+bench_font  (const char  *path)
+{
+    HPDF_Doc pdf;
+    HPDF_Font font;
+    HPDF_FontDef fontdef;
+    HPDF_TTFontDefAttr attr;
+    const long iterations = (long)NUM_ROUNDS * (0xFFFF - 0x20 + 1);
+    unsigned long legacy_sum;
+    unsigned long current_sum;
+    HPDF_UINT code;
+    HPDF_UINT mismatches = 0;
+    double start;
+    double elapsed;
+
+    pdf = HPDF_New (error_handler, NULL);
+    font = HPDF_GetFont (pdf, HPDF_LoadTTFontFromFile (pdf, path, HPDF_FALSE),
+            NULL);
+    fontdef = ((HPDF_FontAttr)font->attr)->fontdef;
+    attr = (HPDF_TTFontDefAttr)fontdef->attr;
+
+    printf ("%s: cmap format %u, %u segments\n", path,
+            (HPDF_UINT)attr->cmap.format,
+            (HPDF_UINT)attr->cmap.seg_count_x2 / 2);
+
+    for (code = 0; code <= 0xFFFF; code++)
+        if (legacy_fn (fontdef, (HPDF_UINT16)code) !=
+                current_fn (fontdef, (HPDF_UINT16)code))
+            mismatches++;
+
+    start = bench_now ();
+    legacy_sum = lookup_all (legacy_fn, fontdef);
+    elapsed = bench_now () - start;
+    bench_report ("linear scan", elapsed, iterations);
+    printf ("%-32s %10.0f lookups/s\n", "", iterations / elapsed);
+
+    start = bench_now ();
+    current_sum = lookup_all (current_fn, fontdef);
+    elapsed = bench_now () - start;
+    bench_report ("HPDF_TTFontDef_GetGlyphid", elapsed, iterations);
+    printf ("%-32s %10.0f lookups/s\n", "", iterations / elapsed);
+
+    printf ("mismatches: %u\n", mismatches);
+    HPDF_Free (pdf);
+
+    return (mismatches == 0 && legacy_sum == current_sum) ? 0 : 1;
+}
+
+
+int
+main  (int     argc,
+       char  **argv)
+{
+    int ret = 0;
+    int i;
+
+    if (argc < 2)
+        return bench_font (BENCH_DEMO_DIR "/ttfont/PenguinAttack.ttf");
+
+    for (i = 1; i < argc; i++)
+        ret |= bench_font (argv[i]);
+
+    return ret;
+}
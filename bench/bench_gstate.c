@@ -0,0 +1,101 @@
+/*
+ * << Haru Free PDF Library >> -- bench_gstate.c
+ *
+ * URL: http://libharu.org
+ *
+ * Permission to use, copy, modify, distribute and sell this software
+ * and its documentation for any purpose is hereby granted without fee,
+ * provided that the above copyright notice appear in all copies and
+ * that both that copyright notice and this permission notice appear
+ * in supporting documentation.
+ * It is provided "as is" without express or implied warranty.
+ *
+ */
+
+#include <stdlib.h>
+#include "hpdf.h"
+#include "hpdf_pages.h"
+#include "bench.h"
+
+#define NUM_CELLS  200000
+
+
+static void
+error_handler  (HPDF_STATUS   error_no,
+                HPDF_STATUS   detail_no,
+                void         *user_data)
+{
+    HPDF_UNUSED (user_data);
+
+    printf ("ERROR: error_no=%04X, detail_no=%u\n", (HPDF_UINT)error_no,
+            (HPDF_UINT)detail_no);
+    exit (1);
+}
+
+
+/* draws a table the way report generators do: every cell sets its
+ * complete style, although it rarely differs from the previous cell.
+ */
+static void
+draw_cells  (HPDF_Page   page,
+             HPDF_Font   font)
+{
+    int i;
+
+    for (i = 0; i < NUM_CELLS; i++) {
+        HPDF_REAL x = (HPDF_REAL)(i % 10) * 50;
+        HPDF_REAL y = (HPDF_REAL)(i / 10 % 70) * 10;
+
+        HPDF_Page_SetLineWidth (page, 0.5);
+        HPDF_Page_SetRGBStroke (page, 0.2, 0.2, 0.2);
+        HPDF_Page_SetRGBFill (page, (i % 7) ? 1.0 : 0.9, 1.0, 1.0);
+        HPDF_Page_Rectangle (page, x, y, 50, 10);
+        HPDF_Page_FillStroke (page);
+
+        HPDF_Page_BeginText (page);
+        HPDF_Page_SetFontAndSize (page, font, 8);
+        HPDF_Page_SetRGBFill (page, 0, 0, 0);
+        HPDF_Page_TextOut (page, x + 2, y + 2, "cell");
+        HPDF_Page_EndText (page);
+    }
+}
+
+
+static HPDF_UINT
+run  (const char  *name,
+      HPDF_UINT    mode)
+{
+    HPDF_Doc pdf;
+    HPDF_Page page;
+    HPDF_Font font;
+    HPDF_UINT size;
+    double start;
+
+    pdf = HPDF_New (error_handler, NULL);
+    HPDF_SetOptimizationMode (pdf, mode);
+    page = HPDF_AddPage (pdf);
+    font = HPDF_GetFont (pdf, "Helvetica", NULL);
+
+    start = bench_now ();
+    draw_cells (page, font);
+    bench_report (name, bench_now () - start, NUM_CELLS);
+
+    size = HPDF_Stream_Size (((HPDF_PageAttr)page->attr)->stream);
+    printf ("%-32s %10u bytes of content\n", "", size);
+    HPDF_Free (pdf);
+
+    return size;
+}
+
+
+int
+main  (void)
+{
+    HPDF_UINT plain = run ("HPDF_OPTIMIZE_NONE", HPDF_OPTIMIZE_NONE);
+    HPDF_UINT optimized = run ("HPDF_OPTIMIZE_GSTATE", HPDF_OPTIMIZE_GSTATE);
+
+    printf ("content saved: %.1f%%\n",
+            100.0 * (plain - optimized) / (plain ? plain : 1));
+
+    return optimized <= plain ? 0 : 1;
+}
@@ -0,0 +1,105 @@
+/*
+ * << Haru Free PDF Library >> -- bench_peephole.c
+ *
+ * URL: http://libharu.org
+ *
+ * Permission to use, copy, modify, distribute and sell this software
+ * and its documentation for any purpose is hereby granted without fee,
+ * provided that the above copyright notice appear in all copies and
+ * that both that copyright notice and this permission notice appear
+ * in supporting documentation.
+ * It is provided "as is" without express or implied warranty.
+ *
+ */
+
+#include <stdlib.h>
+#include "hpdf.h"
+#include "hpdf_pages.h"
+#include "bench.h"
+
+#define NUM_LINES  20000
+
+
+static void
+error_handler  (HPDF_STATUS   error_no,
+                HPDF_STATUS   detail_no,
+                void         *user_data)
+{
+    HPDF_UNUSED (user_data);
+
+    printf ("ERROR: error_no=%04X, detail_no=%u\n", (HPDF_UINT)error_no,
+            (HPDF_UINT)detail_no);
+    exit (1);
+}
+
+
+/* writes text the way a simple layout loop does: words are shown one by
+ * one, lines are advanced relative to an indent, and optional decorations
+ * are wrapped in q/Q whether or not they draw anything.
+ */
+static void
+draw_lines  (HPDF_Page   page,
+             HPDF_Font   font)
+{
+    int i;
+
+    HPDF_Page_BeginText (page);
+    HPDF_Page_SetFontAndSize (page, font, 9);
+    HPDF_Page_MoveTextPos (page, 40, 800);
+
+    for (i = 0; i < NUM_LINES; i++) {
+        HPDF_Page_MoveTextPos (page, 0, -11);
+        HPDF_Page_MoveTextPos (page, (i % 3) * 12.5f, 0);
+        HPDF_Page_ShowText (page, "Lorem ");
+        HPDF_Page_ShowText (page, "ipsum ");
+        HPDF_Page_ShowText (page, "dolor");
+        HPDF_Page_MoveTextPos (page, -(i % 3) * 12.5f, 0);
+    }
+
+    HPDF_Page_EndText (page);
+
+    for (i = 0; i < NUM_LINES; i++) {
+        HPDF_Page_GSave (page);
+        if (i % 10 == 0) {
+            HPDF_Page_SetLineWidth (page, 0.5);
+            HPDF_Page_MoveTo (page, 40, 20);
+            HPDF_Page_LineTo (page, 550, 20);
+            HPDF_Page_Stroke (page);
+        }
+        HPDF_Page_GRestore (page);
+    }
+}
+
+
+int
+main  (void)
+{
+    HPDF_Doc pdf;
+    HPDF_Page page;
+    HPDF_Font font;
+    HPDF_UINT before;
+    HPDF_UINT after;
+    HPDF_UINT saved;
+    double start;
+
+    pdf = HPDF_New (error_handler, NULL);
+    page = HPDF_AddPage (pdf);
+    font = HPDF_GetFont (pdf, "Helvetica", NULL);
+
+    draw_lines (page, font);
+    before = HPDF_Stream_Size (((HPDF_PageAttr)page->attr)->stream);
+
+    start = bench_now ();
+    HPDF_Page_OptimizeContents (page);
+    bench_report ("HPDF_Page_OptimizeContents", bench_now () - start,
+            NUM_LINES);
+
+    after = HPDF_Stream_Size (((HPDF_PageAttr)page->attr)->stream);
+    saved = HPDF_Page_GetOptimizedBytes (page);
+    printf ("content: %u -> %u bytes, %u saved (%.1f%%)\n", before, after,
+            saved, 100.0 * saved / before);
+
+    HPDF_Free (pdf);
+
+    return before - after == saved ? 0 : 1;
+}
@@ -0,0 +1,110 @@
+/*
+ * << Haru Free PDF Library >> -- bench_polyline.c
+ *
+ * URL: http://libharu.org
+ *
+ * Permission to use, copy, modify, distribute and sell this software
+ * and its documentation for any purpose is hereby granted without fee,
+ * provided that the above copyright notice appear in all copies and
+ * that both that copyright notice and this permission notice appear
+ * in supporting documentation.
+ * It is provided "as is" without express or implied warranty.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "hpdf.h"
+#include "hpdf_pages.h"
+#include "bench.h"
+
+#define NUM_POINTS  100000
+#define NUM_ROUNDS  10
+
+
+static void
+error_handler  (HPDF_STATUS   error_no,
+                HPDF_STATUS   detail_no,
+                void         *user_data)
+{
+    HPDF_UNUSED (user_data);
+
+    printf ("ERROR: error_no=%04X, detail_no=%u\n", (HPDF_UINT)error_no,
+            (HPDF_UINT)detail_no);
+    exit (1);
+}
+
+
+/* reads back the whole content stream of a page */
+static HPDF_BYTE*
+page_contents  (HPDF_Page   page,
+                HPDF_UINT  *size)
+{
+    HPDF_Stream stream = ((HPDF_PageAttr)page->attr)->stream;
+    HPDF_BYTE *buf;
+
+    *size = HPDF_Stream_Size (stream);
+    buf = malloc (*size + 1);
+    HPDF_Stream_Seek (stream, 0, HPDF_SEEK_SET);
+    HPDF_Stream_Read (stream, buf, size);
+
+    return buf;
+}
+
+
+int
+main  (void)
+{
+    static HPDF_Point points[NUM_POINTS];
+    HPDF_Doc pdf;
+    HPDF_Page single;
+    HPDF_Page bulk;
+    HPDF_BYTE *single_buf;
+    HPDF_BYTE *bulk_buf;
+    HPDF_UINT single_size;
+    HPDF_UINT bulk_size;
+    double start;
+    int round;
+    int i;
+
+    /* a noisy chart line */
+    srand (1);
+    for (i = 0; i < NUM_POINTS; i++) {
+        points[i].x = 20 + (HPDF_REAL)i * 550 / NUM_POINTS;
+        points[i].y = 400 + (HPDF_REAL)(rand () % 30000) / 100;
+    }
+
+    pdf = HPDF_New (error_handler, NULL);
+    single = HPDF_AddPage (pdf);
+    bulk = HPDF_AddPage (pdf);
+
+    start = bench_now ();
+    for (round = 0; round < NUM_ROUNDS; round++) {
+        HPDF_Page_MoveTo (single, points[0].x, points[0].y);
+        for (i = 1; i < NUM_POINTS; i++)
+            HPDF_Page_LineTo (single, points[i].x, points[i].y);
+        HPDF_Page_Stroke (single);
+    }
+    bench_report ("MoveTo/LineTo", bench_now () - start,
+            (long)NUM_ROUNDS * NUM_POINTS);
+
+    start = bench_now ();
+    for (round = 0; round < NUM_ROUNDS; round++) {
+        HPDF_Page_Polyline (bulk, points, NUM_POINTS);
+        HPDF_Page_Stroke (bulk);
+    }
+    bench_report ("HPDF_Page_Polyline", bench_now () - start,
+            (long)NUM_ROUNDS * NUM_POINTS);
+
+    single_buf = page_contents (single, &single_size);
+    bulk_buf = page_contents (bulk, &bulk_size);
+    printf ("output check: %s (%u bytes)\n", (single_size == bulk_size &&
+            memcmp (single_buf, bulk_buf, single_size) == 0) ? "identical" :
+            "DIFFERENT", bulk_size);
+
+    free (single_buf);
+    free (bulk_buf);
+    HPDF_Free (pdf);
+
+    return single_size == bulk_size ? 0 : 1;
+}
@@ -0,0 +1,113 @@
+/*
+ * << Haru Free PDF Library >> -- bench_subsetcache.c
+ *
+ * URL: http://libharu.org
+ *
+ * Permission to use, copy, modify, distribute and sell this software
+ * and its documentation for any purpose is hereby granted without fee,
+ * provided that the above copyright notice appear in all copies and
+ * that both that copyright notice and this permission notice appear
+ * in supporting documentation.
+ * It is provided "as is" without express or implied warranty.
+ *
+ */
+
+#include <stdlib.h>
+#include "hpdf.h"
+#include "bench.h"
+
+#define NUM_DOCS  200
+
+
+static void
+error_handler  (HPDF_STATUS   error_no,
+                HPDF_STATUS   detail_no,
+                void         *user_data)
+{
+    HPDF_UNUSED (user_data);
+
+    printf ("ERROR: error_no=%04X, detail_no=%u\n", (HPDF_UINT)error_no,
+            (HPDF_UINT)detail_no);
+    exit (1);
+}
+
+
+/* creates compressed documents which each embed the same glyphs of the
+ * font, as a batch of invoices would. returns the size of the last one.
+ */
+static HPDF_UINT32
+save_docs  (const char  *path,
+            HPDF_BOOL    use_subset_cache)
+{
+    HPDF_UINT32 size = 0;
+    int i;
+
+    for (i = 0; i < NUM_DOCS; i++) {
+        HPDF_Doc pdf = HPDF_New (error_handler, NULL);
+        HPDF_Page page;
+        HPDF_Font font;
+
+        if (use_subset_cache)
+            HPDF_UseSubsetCache (pdf);
+        else
+            HPDF_UseFontCache (pdf);
+
+        HPDF_SetCompressionMode (pdf, HPDF_COMP_ALL);
+        font = HPDF_GetFont (pdf, HPDF_LoadTTFontFromFile (pdf, path,
+                HPDF_TRUE), NULL);
+
+        page = HPDF_AddPage (pdf);
+        HPDF_Page_BeginText (page);
+        HPDF_Page_SetFontAndSize (page, font, 12);
+        HPDF_Page_TextOut (page, 50, 700,
+                "Invoice 2024-0815: 3 items, total 1,234.56 EUR");
+        HPDF_Page_EndText (page);
+
+        HPDF_SaveToStream (pdf);
+        size = HPDF_GetStreamSize (pdf);
+        HPDF_Free (pdf);
+    }
+
+    return size;
+}
+
+
+static int
+bench_font  (const char  *path)
+{
+    HPDF_UINT32 font_cache_size;
+    HPDF_UINT32 subset_cache_size;
+    double start;
+
+    printf ("%s\n", path);
+
+    start = bench_now ();
+    font_cache_size = save_docs (path, HPDF_FALSE);
+    bench_report ("with font cache", bench_now () - start, NUM_DOCS);
+
+    start = bench_now ();
+    subset_cache_size = save_docs (path, HPDF_TRUE);
+    bench_report ("with subset cache", bench_now () - start, NUM_DOCS);
+
+    printf ("document size: %u / %u\n", font_cache_size, subset_cache_size);
+    HPDF_FreeFontCache ();
+
+    return (font_cache_size == subset_cache_size) ? 0 : 1;
+}
+
+
+int
+main  (int     argc,
+       char  **argv)
+{
+    int ret = 0;
+    int i;
+
+    if (argc < 2)
+        return bench_font (BENCH_DEMO_DIR "/ttfont/PenguinAttack.ttf");
+
+    for (i = 1; i < argc; i++)
+        ret |= bench_font (argv[i]);
+
+    return ret;
+}
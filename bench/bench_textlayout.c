@@ -0,0 +1,186 @@
+/*
+ * << Haru Free PDF Library >> -- bench_textlayout.c
+ *
+ * URL: http://libharu.org
+ *
+ * Permission to use, copy, modify, distribute and sell this software
+ * and its documentation for any purpose is hereby granted without fee,
+ * provided that the above copyright notice appear in all copies and
+ * that both that copyright notice and this permission notice appear
+ * in supporting documentation.
+ * It is provided "as is" without express or implied warranty.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "hpdf.h"
+#include "bench.h"
+
+#define NUM_ROUNDS      20
+#define TEXT_REPEAT     60
+
+static const char *paragraph =
+    "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do "
+    "eiusmod tempor incididunt ut labore et dolore magna aliqua. Ut enim "
+    "ad minim veniam, quis nostrud exercitation ullamco laboris nisi ut "
+    "aliquip ex ea commodo consequat. Duis aute irure dolor in "
+    "reprehenderit in voluptate velit esse cillum dolore eu fugiat nulla "
+    "pariatur.\n";
+
+static const HPDF_REAL column_widths[] = {120, 180, 260, 400};
+#define NUM_WIDTHS  (sizeof(column_widths) / sizeof(column_widths[0]))
+
+
+static void
+error_handler  (HPDF_STATUS   error_no,
+                HPDF_STATUS   detail_no,
+                void         *user_data)
+{
+    HPDF_UNUSED (user_data);
+
+    printf ("ERROR: error_no=%04X, detail_no=%u\n", (HPDF_UINT)error_no,
+            (HPDF_UINT)detail_no);
+    exit (1);
+}
+
+
+static HPDF_Font
+load_font  (HPDF_Doc     pdf,
+            const char  *path)
+{
+    if (!path)
+        return HPDF_GetFont (pdf, "Helvetica", NULL);
+
+    HPDF_UseUTFEncodings (pdf);
+    return HPDF_GetFont (pdf, HPDF_LoadTTFontFromFile (pdf, path, HPDF_TRUE),
+            "UTF-8");
+}
+
+
+static HPDF_Page
+begin_column  (HPDF_Doc    pdf,
+               HPDF_Font   font)
+{
+    HPDF_Page page = HPDF_AddPage (pdf);
+
+    HPDF_Page_BeginText (page);
+    HPDF_Page_SetFontAndSize (page, font, 10);
+
+    return page;
+}
+
+
+/* flows the text through columns of each width, one column per page */
+static HPDF_UINT
+flow_text_rect  (const char  *text,
+                 const char  *font_path,
+                 HPDF_UINT   *size)
+{
+    HPDF_Doc pdf = HPDF_New (error_handler, NULL);
+    HPDF_Font font = load_font (pdf, font_path);
+    HPDF_UINT text_len = (HPDF_UINT)strlen (text);
+    HPDF_UINT pages = 0;
+    HPDF_UINT i;
+
+    HPDF_SetErrorHandler (pdf, NULL);
+    for (i = 0; i < NUM_WIDTHS; i++) {
+        HPDF_UINT pos = 0;
+
+        while (pos < text_len) {
+            HPDF_Page page = begin_column (pdf, font);
+            HPDF_UINT len;
+
+            HPDF_Page_TextRect (page, 50, 800, 50 + column_widths[i], 50,
+                    text + pos, HPDF_TALIGN_JUSTIFY, &len);
+            HPDF_Page_EndText (page);
+            pos += len;
+            pages++;
+        }
+    }
+
+    HPDF_SaveToStream (pdf);
+    *size = HPDF_GetStreamSize (pdf);
+    HPDF_Free (pdf);
+
+    return pages;
+}
+
+
+/* the same with one text layout, which is measured once */
+static HPDF_UINT
+flow_text_layout  (const char  *text,
+                   const char  *font_path,
+                   HPDF_UINT   *size)
+{
+    HPDF_Doc pdf = HPDF_New (error_handler, NULL);
+    HPDF_Font font = load_font (pdf, font_path);
+    HPDF_TextLayout layout = HPDF_CreateTextLayout (pdf, text);
+    HPDF_UINT text_len = (HPDF_UINT)strlen (text);
+    HPDF_UINT pages = 0;
+    HPDF_UINT i;
+
+    HPDF_SetErrorHandler (pdf, NULL);
+    for (i = 0; i < NUM_WIDTHS; i++) {
+        HPDF_TextLayout_SetPos (layout, 0);
+
+        while (HPDF_TextLayout_GetPos (layout) < text_len) {
+            HPDF_Page page = begin_column (pdf, font);
+
+            HPDF_Page_TextLayoutRect (page, layout, 50, 800,
+                    50 + column_widths[i], 50, HPDF_TALIGN_JUSTIFY, NULL);
+            HPDF_Page_EndText (page);
+            pages++;
+        }
+    }
+
+    HPDF_TextLayout_Free (layout);
+    HPDF_SaveToStream (pdf);
+    *size = HPDF_GetStreamSize (pdf);
+    HPDF_Free (pdf);
+
+    return pages;
+}
+
+
+int
+main  (int     argc,
+       char  **argv)
+{
+    const char *font_path = argc > 1 ? argv[1] : NULL;
+    HPDF_UINT paragraph_len = (HPDF_UINT)strlen (paragraph);
+    char *text = malloc (paragraph_len * TEXT_REPEAT + 1);
+    HPDF_UINT rect_pages = 0;
+    HPDF_UINT layout_pages = 0;
+    HPDF_UINT rect_size = 0;
+    HPDF_UINT layout_size = 0;
+    double start;
+    double elapsed;
+    int i;
+
+    for (i = 0; i < TEXT_REPEAT; i++)
+        memcpy (text + paragraph_len * i, paragraph, paragraph_len);
+    text[paragraph_len * TEXT_REPEAT] = 0;
+
+    printf ("%u bytes of text, %s\n", paragraph_len * TEXT_REPEAT,
+            font_path ? font_path : "Helvetica");
+
+    start = bench_now ();
+    for (i = 0; i < NUM_ROUNDS; i++)
+        rect_pages = flow_text_rect (text, font_path, &rect_size);
+    elapsed = bench_now () - start;
+    bench_report ("HPDF_Page_TextRect", elapsed, (long)NUM_ROUNDS * rect_pages);
+
+    start = bench_now ();
+    for (i = 0; i < NUM_ROUNDS; i++)
+        layout_pages = flow_text_layout (text, font_path, &layout_size);
+    elapsed = bench_now () - start;
+    bench_report ("HPDF_Page_TextLayoutRect", elapsed,
+            (long)NUM_ROUNDS * layout_pages);
+
+    printf ("pages: %u / %u, bytes: %u / %u\n", rect_pages, layout_pages,
+            rect_size, layout_size);
+    free (text);
+
+    return (rect_pages == layout_pages && rect_size == layout_size) ? 0 : 1;
+}
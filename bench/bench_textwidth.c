@@ -0,0 +1,185 @@
+/*
+ * << Haru Free PDF Library >> -- bench_textwidth.c
+ *
+ * URL: http://libharu.org
+ *
+ * Permission to use, copy, modify, distribute and sell this software
+ * and its documentation for any purpose is hereby granted without fee,
+ * provided that the above copyright notice appear in all copies and
+ * that both that copyright notice and this permission notice appear
+ * in supporting documentation.
+ * It is provided "as is" without express or implied warranty.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "hpdf.h"
+#include "hpdf_utils.h"
+#include "hpdf_font.h"
+#include "bench.h"
+
+#define NUM_ROUNDS  200
+#define TEXT_LEN    (1024 * 1024)
+
+static const char *paragraph =
+    "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do "
+    "eiusmod tempor incididunt ut labore et dolore magna aliqua.\tUt enim "
+    "ad minim veniam, quis nostrud exercitation ullamco laboris nisi ut "
+    "aliquip ex ea commodo consequat.\r\n";
+
+
+static void
+error_handler  (HPDF_STATUS   error_no,
+                HPDF_STATUS   detail_no,
+                void         *user_data)
+{
+    HPDF_UNUSED (user_data);
+
+    printf ("ERROR: error_no=%04X, detail_no=%u\n", (HPDF_UINT)error_no,
+            (HPDF_UINT)detail_no);
+    exit (1);
+}
+
+
+/* the byte loop of the text_width_fn of single byte fonts used before */
+static HPDF_TextWidth
+LegacyTextWidth  (HPDF_Font         font,
+                  const HPDF_BYTE  *text,
+                  HPDF_UINT         len)
+{
+    HPDF_FontAttr attr = (HPDF_FontAttr)font->attr;
+    HPDF_TextWidth ret = {0, 0, 0, 0};
+    HPDF_UINT i;
+    HPDF_BYTE b = 0;
+
+    for (i = 0; i < len; i++) {
+        b = text[i];
+        ret.numchars++;
+        ret.width += attr->widths[b];
+
+        if (HPDF_IS_WHITE_SPACE(b)) {
+            ret.numspace++;
+            ret.numwords++;
+        }
+    }
+
+    if (!HPDF_IS_WHITE_SPACE(b))
+        ret.numwords++;
+
+    return ret;
+}
+
+
+/* called through pointers, so neither version is inlined into the loop */
+typedef HPDF_TextWidth (*TextWidthFunc) (HPDF_Font, const HPDF_BYTE *,
+        HPDF_UINT);
+static TextWidthFunc volatile legacy_fn = LegacyTextWidth;
+static TextWidthFunc volatile current_fn = HPDF_Font_TextWidth;
+
+
+static int
+same  (HPDF_TextWidth  a,
+       HPDF_TextWidth  b)
+{
+    return a.numchars == b.numchars && a.numwords == b.numwords &&
+        a.width == b.width && a.numspace == b.numspace;
+}
+
+
+static HPDF_UINT
+check_font  (HPDF_Font   font,
+             HPDF_BYTE  *text)
+{
+    HPDF_BYTE noise[600 + 16];
+    HPDF_UINT mismatches = 0;
+    HPDF_UINT len;
+
+    /* every byte value, white space or not */
+    for (len = 0; len < sizeof(noise); len++)
+        noise[len] = (HPDF_BYTE)(len * 37 + (len >> 4));
+
+    current_fn (font, noise, sizeof(noise));
+
+    /* every length up to a few blocks, at every alignment */
+    for (len = 0; len < 600; len++) {
+        if (!same (legacy_fn (font, text + len % 16, len),
+                    current_fn (font, text + len % 16, len)))
+            mismatches++;
+        if (!same (legacy_fn (font, noise + len % 16, len),
+                    current_fn (font, noise + len % 16, len)))
+            mismatches++;
+    }
+
+    return mismatches;
+}
+
+
+static int
+bench_font  (const char  *name,
+             HPDF_Font    font,
+             HPDF_BYTE   *text)
+{
+    HPDF_TextWidth legacy_tw = {0, 0, 0, 0};
+    HPDF_TextWidth current_tw = {0, 0, 0, 0};
+    HPDF_UINT mismatches;
+    double start;
+    double elapsed;
+    int round;
+
+    printf ("%s\n", name);
+
+    /* the widths of a TrueType font are filled in when first measured */
+    current_tw = current_fn (font, text, TEXT_LEN);
+    mismatches = check_font (font, text);
+
+    start = bench_now ();
+    for (round = 0; round < NUM_ROUNDS; round++)
+        legacy_tw = legacy_fn (font, text, TEXT_LEN);
+    elapsed = bench_now () - start;
+    bench_report ("byte loop", elapsed, NUM_ROUNDS);
+    printf ("%-32s %10.0f MB/s\n", "", NUM_ROUNDS * (TEXT_LEN / 1e6) /
+            elapsed);
+
+    start = bench_now ();
+    for (round = 0; round < NUM_ROUNDS; round++)
+        current_tw = current_fn (font, text, TEXT_LEN);
+    elapsed = bench_now () - start;
+    bench_report ("HPDF_Font_TextWidth", elapsed, NUM_ROUNDS);
+    printf ("%-32s %10.0f MB/s\n", "", NUM_ROUNDS * (TEXT_LEN / 1e6) /
+            elapsed);
+
+    printf ("mismatches: %u\n", mismatches);
+
+    return (mismatches == 0 && same (legacy_tw, current_tw)) ? 0 : 1;
+}
+
+
+int
+main  (int     argc,
+       char  **argv)
+{
+    const char *path = (argc > 1) ? argv[1] :
+            BENCH_DEMO_DIR "/ttfont/PenguinAttack.ttf";
+    HPDF_BYTE *text = malloc (TEXT_LEN + 16);
+    size_t plen = strlen (paragraph);
+    HPDF_Doc pdf;
+    HPDF_UINT i;
+    int ret = 0;
+
+    for (i = 0; i < TEXT_LEN + 16; i++)
+        text[i] = (HPDF_BYTE)paragraph[i % plen];
+
+    pdf = HPDF_New (error_handler, NULL);
+
+    ret |= bench_font ("Helvetica", HPDF_GetFont (pdf, "Helvetica", NULL),
+            text);
+    ret |= bench_font (path, HPDF_GetFont (pdf,
+                HPDF_LoadTTFontFromFile (pdf, path, HPDF_FALSE),
+                "WinAnsiEncoding"), text);
+
+    HPDF_Free (pdf);
+    free (text);
+
+    return ret;
+}
@@ -0,0 +1,116 @@
+/*
+ * << Haru Free PDF Library >> -- bench_ttload.c
+ *
+ * URL: http://libharu.org
+ *
+ * Permission to use, copy, modify, distribute and sell this software
+ * and its documentation for any purpose is hereby granted without fee,
+ * provided that the above copyright notice appear in all copies and
+ * that both that copyright notice and this permission notice appear
+ * in supporting documentation.
+ * It is provided "as is" without express or implied warranty.
+ *
+ */
+
+#include <stdlib.h>
+#include "hpdf.h"
+#include "hpdf_fontdef.h"
+#include "bench.h"
+
+#define NUM_ROUNDS  20
+
+
+static void
+error_handler  (HPDF_STATUS   error_no,
+                HPDF_STATUS   detail_no,
+                void         *user_data)
+{
+    HPDF_UNUSED (user_data);
+
+    printf ("ERROR: error_no=%04X, detail_no=%u\n", (HPDF_UINT)error_no,
+            (HPDF_UINT)detail_no);
+    exit (1);
+}
+
+
+typedef HPDF_Stream (*ReaderNewFunc) (HPDF_MMgr, const char *);
+
+
+/* parses the font, uses every character of the BMP, so that composite
+ * glyphs are resolved, and writes the subset the way an embedded font is
+ * written. returns the size of the subset.
+ */
+static HPDF_UINT32
+load_and_subset  (HPDF_MMgr      mmgr,
+                  ReaderNewFunc  reader_new,
+                  const char    *path)
+{
+    HPDF_FontDef fontdef;
+    HPDF_Stream out;
+    HPDF_UINT32 size;
+    HPDF_UINT code;
+
+    fontdef = HPDF_TTFontDef_Load (mmgr, reader_new (mmgr, path), HPDF_TRUE);
+    if (!fontdef)
+        return 0;
+
+    for (code = 0x20; code <= 0xFFFF; code++)
+        HPDF_TTFontDef_GetCharWidth (fontdef, code);
+
+    out = HPDF_MemStream_New (mmgr, 0);
+    HPDF_TTFontDef_SaveFontData (fontdef, out);
+    size = out->size;
+
+    HPDF_Stream_Free (out);
+    HPDF_FontDef_Free (fontdef);
+
+    return size;
+}
+
+
+static int
+bench_font  (const char  *path)
+{
+    HPDF_Doc pdf;
+    HPDF_UINT32 file_size = 0;
+    HPDF_UINT32 mapped_size = 0;
+    double start;
+    int round;
+
+    pdf = HPDF_New (error_handler, NULL);
+
+    printf ("%s\n", path);
+
+    start = bench_now ();
+    for (round = 0; round < NUM_ROUNDS; round++)
+        file_size = load_and_subset (pdf->mmgr, HPDF_FileReader_New, path);
+    bench_report ("HPDF_FileReader", bench_now () - start, NUM_ROUNDS);
+
+    start = bench_now ();
+    for (round = 0; round < NUM_ROUNDS; round++)
+        mapped_size = load_and_subset (pdf->mmgr, HPDF_MappedFileReader_New,
+                path);
+    bench_report ("HPDF_MappedFileReader", bench_now () - start, NUM_ROUNDS);
+
+    printf ("subset size: %u / %u\n", file_size, mapped_size);
+    HPDF_Free (pdf);
+
+    return (file_size > 0 && file_size == mapped_size) ? 0 : 1;
+}
+
+
+int
+main  (int     argc,
+       char  **argv)
+{
+    int ret = 0;
+    int i;
+
+    if (argc < 2)
+        return bench_font (BENCH_DEMO_DIR "/ttfont/PenguinAttack.ttf");
+
+    for (i = 1; i < argc; i++)
+        ret |= bench_font (argv[i]);
+
+    return ret;
+}
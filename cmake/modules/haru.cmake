@@ -17,6 +17,7 @@ check_include_files(stdint.h LIBHPDF_HAVE_STDINT_H)
 check_include_files(stdlib.h LIBHPDF_HAVE_STDLIB_H)
 check_include_files(strings.h LIBHPDF_HAVE_STRINGS_H)
 check_include_files(string.h LIBHPDF_HAVE_STRING_H)
+check_include_files(sys/mman.h LIBHPDF_HAVE_SYS_MMAN_H)
 check_include_files(sys/stat.h LIBHPDF_HAVE_SYS_STAT_H)
 check_include_files(sys/types.h LIBHPDF_HAVE_SYS_TYPES_H)
 check_include_files(unistd.h LIBHPDF_HAVE_UNISTD_H)
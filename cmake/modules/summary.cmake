@@ -39,6 +39,7 @@ Library options:
 LIBHPDF_SHARED:		${LIBHPDF_SHARED}
 LIBHPDF_STATIC:		${LIBHPDF_STATIC}
 LIBHPDF_EXAMPLES:	${LIBHPDF_EXAMPLES}
+LIBHPDF_BENCHMARKS:	${LIBHPDF_BENCHMARKS}
 DEVPAK:			${DEVPAK}
 
 Optional libraries:
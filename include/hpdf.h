@@ -77,6 +77,7 @@ typedef HPDF_HANDLE   HPDF_Dict;
 typedef HPDF_HANDLE   HPDF_EmbeddedFile;
 typedef HPDF_HANDLE   HPDF_OutputIntent;
 typedef HPDF_HANDLE   HPDF_Xref;
+typedef HPDF_HANDLE   HPDF_TextLayout;
 
 #else
 
@@ -323,6 +324,48 @@ HPDF_LoadTTFontFromFile2 (HPDF_Doc     pdf,
                           HPDF_BOOL    embedding);
 
 
+/* The font is parsed directly from the buffer, which is not copied. When
+ * the font is embedded the buffer must stay valid until the document is
+ * freed, otherwise only during the call.
+ */
+HPDF_EXPORT(const char*)
+HPDF_LoadTTFontFromMem (HPDF_Doc          pdf,
+                        const HPDF_BYTE  *buffer,
+                        HPDF_UINT         size,
+                        HPDF_BOOL         embedding);
+
+
+HPDF_EXPORT(const char*)
+HPDF_LoadTTFontFromMem2 (HPDF_Doc          pdf,
+                         const HPDF_BYTE  *buffer,
+                         HPDF_UINT         size,
+                         HPDF_UINT         index,
+                         HPDF_BOOL         embedding);
+
+
+/* TrueType fonts loaded from files by the document are parsed once per
+ * process and shared with the other documents which use the font cache.
+ * Cached fonts stay in memory until HPDF_FreeFontCache is called.
+ */
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_UseFontCache  (HPDF_Doc   pdf);
+
+
+/* frees the cached fonts, and the shared tables of CJK and UTF-8 encoders,
+ * which are not used by any document */
+HPDF_EXPORT(void)
+HPDF_FreeFontCache  (void);
+
+
+/* the document uses the font cache, and the finished font data of the
+ * subsets it embeds is kept with the cached font. a document which embeds
+ * the same glyphs of the font again copies the data instead of subsetting
+ * and compressing the font. the subsets are freed with the cached font.
+ */
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_UseSubsetCache  (HPDF_Doc   pdf);
+
+
 HPDF_EXPORT(HPDF_STATUS)
 HPDF_AddPageLabel  (HPDF_Doc            pdf,
                     HPDF_UINT           page_num,
@@ -1025,6 +1068,42 @@ HPDF_EXPORT(HPDF_STATUS)
 HPDF_Font_EmbedAllGlyphs  (HPDF_Font  font);
 
 
+/* The embedded subset of a TrueType font used by Type0 fonts keeps only the
+ * used glyphs, numbered densely, with loca, hmtx and post trimmed to them.
+ * It has no effect when a single byte font uses the same TrueType font.
+ */
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_Font_UseCompactSubset  (HPDF_Font  font);
+
+
+/*--------------------------------------------------------------------------*/
+/*----- text layout --------------------------------------------------------*/
+
+/* a copy of the text, which is measured once with the font it is laid out
+ * with by HPDF_Page_TextLayoutRect. the measurements are kept for laying
+ * out the text again at another width or font size. a text layout is freed
+ * with HPDF_TextLayout_Free, or with the document by HPDF_Free and
+ * HPDF_FreeDocAll.
+ */
+HPDF_EXPORT(HPDF_TextLayout)
+HPDF_CreateTextLayout  (HPDF_Doc     pdf,
+                        const char  *text);
+
+
+HPDF_EXPORT(void)
+HPDF_TextLayout_Free  (HPDF_TextLayout  layout);
+
+
+/* the offset in bytes of the text HPDF_Page_TextLayoutRect continues at */
+HPDF_EXPORT(HPDF_UINT)
+HPDF_TextLayout_GetPos  (HPDF_TextLayout  layout);
+
+
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_TextLayout_SetPos  (HPDF_TextLayout  layout,
+                         HPDF_UINT        pos);
+
+
 /*--------------------------------------------------------------------------*/
 /*----- attachements -------------------------------------------------------*/
 
@@ -1064,6 +1143,16 @@ HPDF_Page_TextWidth  (HPDF_Page    page,
                       const char  *text);
 
 
+/* the ...Len functions take len bytes of text, which need not end with a
+ * NUL character. a len over HPDF_LIMIT_MAX_STRING_LEN raises
+ * HPDF_STRING_OUT_OF_RANGE.
+ */
+HPDF_EXPORT(HPDF_REAL)
+HPDF_Page_TextWidthLen  (HPDF_Page    page,
+                         const char  *text,
+                         HPDF_UINT    len);
+
+
 HPDF_EXPORT(HPDF_UINT)
 HPDF_Page_MeasureText  (HPDF_Page    page,
                         const char  *text,
@@ -1072,6 +1161,15 @@ HPDF_Page_MeasureText  (HPDF_Page    page,
                         HPDF_REAL   *real_width);
 
 
+HPDF_EXPORT(HPDF_UINT)
+HPDF_Page_MeasureTextLen  (HPDF_Page    page,
+                           const char  *text,
+                           HPDF_UINT    len,
+                           HPDF_REAL    width,
+                           HPDF_BOOL    wordwrap,
+                           HPDF_REAL   *real_width);
+
+
 HPDF_EXPORT(HPDF_REAL)
 HPDF_Page_GetWidth  (HPDF_Page   page);
 
@@ -1329,6 +1427,27 @@ HPDF_Page_Rectangle  (HPDF_Page  page,
                       HPDF_REAL  height);
 
 
+/* m, l (bulk) */
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_Page_Polyline  (HPDF_Page          page,
+                     const HPDF_Point  *points,
+                     HPDF_UINT          num_points);
+
+
+/* m, l, h (bulk) */
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_Page_Polygon  (HPDF_Page          page,
+                    const HPDF_Point  *points,
+                    HPDF_UINT          num_points);
+
+
+/* c (bulk) */
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_Page_CurveToArray  (HPDF_Page          page,
+                         const HPDF_Point  *points,
+                         HPDF_UINT          num_points);
+
+
 /*--- Path painting operator ---------------------------------------------*/
 
 /* S */
@@ -1468,7 +1587,37 @@ HPDF_EXPORT(HPDF_STATUS)
 HPDF_Page_ShowText  (HPDF_Page    page,
                      const char  *text);
 
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_Page_ShowTextLen  (HPDF_Page    page,
+                        const char  *text,
+                        HPDF_UINT    len);
+
 /* TJ */
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_Page_ShowTextRuns  (HPDF_Page             page,
+                         const HPDF_TextRun   *runs,
+                         HPDF_UINT             count);
+
+/* Tj and TJ with glyph ids, e.g. from a text shaper. only a Type0 font
+ * based on a TrueType font can be used, other fonts raise
+ * HPDF_PAGE_INVALID_FONT. the glyphs are written horizontally with the
+ * "Identity-H" cmap, without encoding. glyph ids the font does not have
+ * raise HPDF_INVALID_PARAMETER.
+ * advances are in thousandths of the font size like the widths of the
+ * font. a glyph whose advance differs from its width in the hmtx table
+ * moves the next glyph by the difference. NULL advances uses the widths.
+ * clusters are the offsets in bytes into text of the characters each glyph
+ * shows, which go into the ToUnicode cmap decoded by the encoder of the
+ * font. with NULL text or clusters, a glyph shows the characters the font
+ * maps to it.
+ */
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_Page_ShowGlyphs  (HPDF_Page            page,
+                       const HPDF_UINT16   *glyphs,
+                       const HPDF_REAL     *advances,
+                       HPDF_UINT            count,
+                       const char          *text,
+                       const HPDF_UINT     *clusters);
 
 /* ' */
 HPDF_EXPORT(HPDF_STATUS)
@@ -1785,6 +1934,14 @@ HPDF_Page_TextOut  (HPDF_Page    page,
                     const char  *text);
 
 
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_Page_TextOutLen  (HPDF_Page    page,
+                       HPDF_REAL    xpos,
+                       HPDF_REAL    ypos,
+                       const char  *text,
+                       HPDF_UINT    len);
+
+
 HPDF_EXPORT(HPDF_STATUS)
 HPDF_Page_TextRect  (HPDF_Page            page,
                      HPDF_REAL            left,
@@ -1796,6 +1953,33 @@ HPDF_Page_TextRect  (HPDF_Page            page,
                      HPDF_UINT           *len);
 
 
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_Page_TextRectLen  (HPDF_Page            page,
+                        HPDF_REAL            left,
+                        HPDF_REAL            top,
+                        HPDF_REAL            right,
+                        HPDF_REAL            bottom,
+                        const char          *text,
+                        HPDF_UINT            text_len,
+                        HPDF_TextAlignment   align,
+                        HPDF_UINT           *len);
+
+
+/* the same as HPDF_Page_TextRect for the text of the layout, starting at
+ * its position. the position is moved past the text put in the rectangle,
+ * so that a call with the next rectangle continues the text.
+ */
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_Page_TextLayoutRect  (HPDF_Page            page,
+                           HPDF_TextLayout      layout,
+                           HPDF_REAL            left,
+                           HPDF_REAL            top,
+                           HPDF_REAL            right,
+                           HPDF_REAL            bottom,
+                           HPDF_TextAlignment   align,
+                           HPDF_UINT           *len);
+
+
 HPDF_EXPORT(HPDF_STATUS)
 HPDF_Page_SetSlideShow  (HPDF_Page              page,
                          HPDF_TransitionStyle   type,
@@ -1819,6 +2003,12 @@ HPDF_EXPORT(HPDF_STATUS)
 HPDF_Page_WriteComment (HPDF_Page    page,
                         const char  *text);
 
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_Page_OptimizeContents  (HPDF_Page  page);
+
+HPDF_EXPORT(HPDF_UINT)
+HPDF_Page_GetOptimizedBytes  (HPDF_Page  page);
+
 HPDF_EXPORT(HPDF_Annotation)
 HPDF_Page_TextField  (HPDF_Page            page,
                       HPDF_Doc             pdf,
@@ -1892,6 +2082,10 @@ HPDF_SetTextPlacementAccuracy (HPDF_Doc  pdf,
 HPDF_EXPORT(HPDF_STATUS)
 HPDF_SetWriteFontWidths (HPDF_Doc  pdf,
                          HPDF_BOOL write_font_widths);
+
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_SetOptimizationMode (HPDF_Doc  pdf,
+                          HPDF_UINT mode);
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
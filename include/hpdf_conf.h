@@ -80,6 +80,19 @@
  */
 #define HPDF_ALIGN_SIZ              sizeof int;
 
+/*----------------------------------------------------------------------------*/
+/*----- SIMD instruction sets ------------------------------------------------*/
+
+/* the vectorized code paths can be disabled by defining HPDF_NO_SIMD */
+#ifndef HPDF_NO_SIMD
+#if defined(__SSE2__) || defined(_M_X64) || \
+        (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HPDF_HAVE_SSE2
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define HPDF_HAVE_NEON
+#endif
+#endif /* HPDF_NO_SIMD */
+
 
 #endif /* _HPDF_CONF_H */
 
@@ -27,6 +27,9 @@
 /* Define to 1 if you have the <string.h> header file. */
 #cmakedefine LIBHPDF_HAVE_STRING_H
 
+/* Define to 1 if you have the <sys/mman.h> header file. */
+#cmakedefine LIBHPDF_HAVE_SYS_MMAN_H
+
 /* Define to 1 if you have the <sys/stat.h> header file. */
 #cmakedefine LIBHPDF_HAVE_SYS_STAT_H
 
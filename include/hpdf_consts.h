@@ -84,6 +84,17 @@
  */
 #define  HPDF_COMP_MASK            0xFF
 
+/*----------------------------------------------------------------------------*/
+/*----- content stream optimization mode -------------------------------------*/
+
+#define  HPDF_OPTIMIZE_NONE        0x00
+/* skip state operators which would not change the graphics state */
+#define  HPDF_OPTIMIZE_GSTATE      0x01
+/* rewrite each content stream into a shorter operator sequence when it is
+   finished */
+#define  HPDF_OPTIMIZE_PEEPHOLE    0x02
+#define  HPDF_OPTIMIZE_MASK        0xFF
+
 
 /*----------------------------------------------------------------------------*/
 /*----- permission flags (only Revision 2 is supported)-----------------------*/
@@ -54,12 +54,26 @@ typedef struct _HPDF_Doc_Rec {
     HPDF_List         font_mgr;
     HPDF_BYTE         ttfont_tag[6];
 
+    /* TrueType fonts are loaded through the process-wide font cache */
+    HPDF_BOOL         use_font_cache;
+
+    /* the subsets of cached fonts are kept in the font cache */
+    HPDF_BOOL         use_subset_cache;
+
     /* list for loaded fontdefs */
     HPDF_List         fontdef_list;
 
     /* list for loaded encodings */
     HPDF_List         encoder_list;
 
+    /* tables of the registered CID fonts and CMap encoders which are
+     * created on first use */
+    HPDF_List         fontdef_entries;
+    HPDF_List         encoder_entries;
+
+    /* text layouts, which are freed with the document */
+    HPDF_List         text_layouts;
+
     HPDF_Encoder      cur_encoder;
 
     /* default compression mode */
@@ -68,6 +82,9 @@ typedef struct _HPDF_Doc_Rec {
     /* decimal places for text placement accuracy */
     HPDF_UINT         text_placement_accuracy;
 
+    /* default content stream optimization mode */
+    HPDF_UINT         optimization_mode;
+
     /* states if font widths will be written for fonts without font data */
     HPDF_BOOL         write_font_widths;
 
@@ -106,6 +123,20 @@ HPDF_BOOL
 HPDF_Doc_Validate  (HPDF_Doc  pdf);
 
 
+/* registers a table of fonts, which is terminated by an entry whose name
+ * is NULL. the table must stay valid while the document is used. */
+HPDF_STATUS
+HPDF_Doc_RegisterCIDFontDefs  (HPDF_Doc                         pdf,
+                               const HPDF_CIDFontDefEntry_Rec  *entries);
+
+
+/* registers a table of encoders, which is terminated by an entry whose
+ * name is NULL. the table must stay valid while the document is used. */
+HPDF_STATUS
+HPDF_Doc_RegisterCMapEncoders  (HPDF_Doc                          pdf,
+                                const HPDF_CMapEncoderEntry_Rec  *entries);
+
+
 /*----- page handling -------------------------------------------------------*/
 
 HPDF_Pages
@@ -64,6 +64,31 @@ extern "C" {
 /*----------------------------------------------------------------------------*/
 /*----- definition for font encoding -----------------------------------------*/
 
+/* the UTF-8 encoder hands out the codes of the UTF-16 surrogate range, which
+ * never stand for a character on their own, to the supplementary characters
+ * of a font.  HPDF_Encoder_ToUcs4 turns them back into code points.
+ */
+#define HPDF_SUPPLEMENTARY_CODE_FIRST  0xD800
+#define HPDF_SUPPLEMENTARY_CODE_LAST   0xDFFF
+
+#define HPDF_UCS4_MAP_SIZE  (HPDF_SUPPLEMENTARY_CODE_LAST - \
+                             HPDF_SUPPLEMENTARY_CODE_FIRST + 1)
+
+/* the supplementary characters given codes, in the order they were met.
+ * the map is owned by the font the text is decoded for, an encoder only
+ * reads and extends the map it is passed. ucs4 and slots are allocated
+ * when the first character is added, slots is a hash table of the
+ * characters holding their index in ucs4 plus one.
+ */
+typedef struct _HPDF_Ucs4Map_Rec {
+    HPDF_MMgr        mmgr;
+    HPDF_UINT32     *ucs4;
+    HPDF_UINT16     *slots;
+    HPDF_UINT        count;
+} HPDF_Ucs4Map_Rec;
+
+typedef struct _HPDF_Ucs4Map_Rec  *HPDF_Ucs4Map;
+
 #define char_NOTDEF        ".notdef"
 
 typedef enum _HPDF_EncodingType {
@@ -75,11 +100,19 @@ typedef enum _HPDF_EncodingType {
 } HPDF_EncodingType;
 
 
+/* all the state of parsing a text is kept here and not in the encoder, so
+ * that an encoder can be used by several parsers at the same time.
+ */
 typedef struct _HPDF_ParseText_Rec {
     const HPDF_BYTE  *text;
     HPDF_UINT        index;
     HPDF_UINT        len;
     HPDF_ByteType    byte_type;
+
+    /* position in a character of a variable number of bytes, as used by
+     * the UTF-8 encoder */
+    HPDF_BYTE        current_byte;
+    HPDF_BYTE        end_byte;
 } HPDF_ParseText_Rec;
 
 
@@ -93,12 +126,35 @@ typedef HPDF_UNICODE
 (*HPDF_Encoder_ToUnicode_Func)  (HPDF_Encoder   encoder,
                                  HPDF_UINT16    code);
 
-typedef char *
+typedef HPDF_UINT32
+(*HPDF_Encoder_ToUcs4_Func)  (HPDF_Encoder   encoder,
+                              HPDF_Ucs4Map   map,
+                              HPDF_UNICODE   unicode);
+
+/* encodes text into buf, which has room for buf_len bytes, and returns the
+ * number of bytes of text which were encoded. encoded_length is set to the
+ * number of bytes written to buf. supplementary characters take their codes
+ * from map.
+ */
+typedef HPDF_UINT
 (*HPDF_Encoder_EncodeText_Func)  (HPDF_Encoder  encoder,
+				  HPDF_Ucs4Map  map,
 				  const char   *text,
 				  HPDF_UINT     len,
+				  HPDF_BYTE    *buf,
+				  HPDF_UINT     buf_len,
 				  HPDF_UINT    *encoded_length);
 
+typedef HPDF_UINT
+(*HPDF_Encoder_DecodeText_Func)  (HPDF_Encoder        encoder,
+                                  HPDF_Ucs4Map        map,
+                                  const HPDF_BYTE    *text,
+                                  HPDF_UINT           len,
+                                  HPDF_UNICODE       *unicodes,
+                                  HPDF_UINT          *offsets,
+                                  HPDF_UINT           max_chars,
+                                  HPDF_UINT          *num_chars);
+
 typedef HPDF_STATUS
 (*HPDF_Encoder_Write_Func)  (HPDF_Encoder  encoder,
                              HPDF_Stream   out);
@@ -122,6 +178,8 @@ typedef struct  _HPDF_Encoder_Rec {
     HPDF_Encoder_ByteType_Func      byte_type_fn;
     HPDF_Encoder_ToUnicode_Func     to_unicode_fn;
     HPDF_Encoder_EncodeText_Func    encode_text_fn;
+    HPDF_Encoder_ToUcs4_Func        to_ucs4_fn;
+    HPDF_Encoder_DecodeText_Func    decode_text_fn;
     HPDF_Encoder_Write_Func         write_fn;
     HPDF_Encoder_Free_Func          free_fn;
     HPDF_Encoder_Init_Func          init_fn;
@@ -161,9 +219,66 @@ HPDF_Encoder_ToUnicode  (HPDF_Encoder     encoder,
                          HPDF_UINT16      code);
 
 
+/* the code point of a code given to a supplementary character in map,
+ * which may be NULL.
+ */
+HPDF_UINT32
+HPDF_Encoder_ToUcs4  (HPDF_Encoder     encoder,
+                      HPDF_Ucs4Map     map,
+                      HPDF_UNICODE     unicode);
+
+/* Decodes text to the unicode values the encoder gives its characters,
+ * at most max_chars of them, in one pass. The offset of the first byte of
+ * each character is stored in offsets unless it is NULL. Bytes which are
+ * not part of a character are skipped. Returns the number of bytes
+ * decoded, which always ends at a character boundary. Supplementary
+ * characters take their codes from map, without a map they are decoded to
+ * their UTF-16 surrogate pairs.
+ */
+HPDF_UINT
+HPDF_Encoder_DecodeText  (HPDF_Encoder        encoder,
+                          HPDF_Ucs4Map        map,
+                          const HPDF_BYTE    *text,
+                          HPDF_UINT           len,
+                          HPDF_UNICODE       *unicodes,
+                          HPDF_UINT          *offsets,
+                          HPDF_UINT           max_chars,
+                          HPDF_UINT          *num_chars);
+
+
+
 void
 HPDF_Encoder_Free  (HPDF_Encoder  encoder);
 
+/*-- HPDF_Ucs4Map ---------------------------------------*/
+
+void
+HPDF_Ucs4Map_Init  (HPDF_Ucs4Map   map,
+                    HPDF_MMgr      mmgr);
+
+
+void
+HPDF_Ucs4Map_Free  (HPDF_Ucs4Map   map);
+
+
+/* returns the code of a supplementary character, which is given the next
+ * free code when it is met the first time. characters out of range are
+ * given the code of a space. so are characters met when no code is left,
+ * or when the map cannot be allocated, which raises
+ * HPDF_TOO_MANY_SUPPLEMENTARY_CHARS or HPDF_FAILD_TO_ALLOC_MEM.
+ */
+HPDF_UNICODE
+HPDF_Ucs4Map_GetCode  (HPDF_Ucs4Map   map,
+                       HPDF_UINT32    ucs4);
+
+
+/* the code point of a code, which is the code itself unless it was given
+ * to a supplementary character.
+ */
+HPDF_UINT32
+HPDF_Ucs4Map_GetUcs4  (HPDF_Ucs4Map   map,
+                       HPDF_UNICODE   code);
+
 /*-- HPDF_BasicEncoder ----------------------------------*/
 
 
@@ -216,11 +331,33 @@ typedef struct _HPDF_UnicodeMap_Rec {
     HPDF_UINT16  unicode;
 } HPDF_UnicodeMap_Rec;
 
-typedef struct _HPDF_CMapEncoderAttr_Rec  *HPDF_CMapEncoderAttr;
+/* the code to unicode and code to cid tables of a CMap encoder. they are
+ * built by the first encoder of the name which is initialized, and then
+ * shared by the encoders of that name in all documents. shared tables are
+ * never changed, and stay in memory until HPDF_FreeFontCache is called
+ * while no encoder uses them.
+ */
+typedef struct _HPDF_CMapTables_Rec  *HPDF_CMapTables;
 
-typedef struct  _HPDF_CMapEncoderAttr_Rec {
+typedef struct _HPDF_CMapTables_Rec {
+      HPDF_CMapTables                  next;
+      char                             name[HPDF_LIMIT_MAX_NAME_LEN + 1];
+      HPDF_UINT                        ref_count;
       HPDF_UNICODE                     unicode_map[256][256];
       HPDF_UINT16                      cid_map[256][256];
+} HPDF_CMapTables_Rec;
+
+typedef struct _HPDF_CMapEncoderAttr_Rec  *HPDF_CMapEncoderAttr;
+
+typedef struct  _HPDF_CMapEncoderAttr_Rec {
+      const HPDF_UNICODE             (*unicode_map)[256];
+      const HPDF_UINT16              (*cid_map)[256];
+      HPDF_CMapTables                  tables;
+      HPDF_BOOL                        tables_shared;
+
+      /* data of an encoder which replaces functions of the CMap encoder */
+      void                            *ext_attr;
+
       HPDF_UINT16                      jww_line_head[HPDF_MAX_JWW_NUM];
       HPDF_List                        cmap_range;
       HPDF_List                        notdef_range;
@@ -236,6 +373,14 @@ typedef struct  _HPDF_CMapEncoderAttr_Rec {
 } HPDF_CMapEncoderAttr_Rec;
 
 
+/* an encoder of a family which HPDF_UseXXEncodings registers. the encoder
+ * is created when a document first asks for its name. */
+typedef struct _HPDF_CMapEncoderEntry_Rec {
+      const char                      *name;
+      HPDF_Encoder_Init_Func           init_fn;
+} HPDF_CMapEncoderEntry_Rec;
+
+
 HPDF_Encoder
 HPDF_CMapEncoder_New  (HPDF_MMgr                mmgr,
                        char                    *name,
@@ -246,6 +391,16 @@ HPDF_STATUS
 HPDF_CMapEncoder_InitAttr  (HPDF_Encoder  encoder);
 
 
+/* shares the tables once the encoder is initialized */
+void
+HPDF_CMapEncoder_ShareTables  (HPDF_Encoder  encoder);
+
+
+/* frees the shared tables which no encoder uses */
+void
+HPDF_CMapEncoder_FreeTables  (void);
+
+
 void
 HPDF_CMapEncoder_Free  (HPDF_Encoder   encoder);
 
@@ -146,6 +146,7 @@ extern "C" {
 #define HPDF_NAME_CANNOT_GET_NAMES                0x1084
 #define HPDF_INVALID_ICC_COMPONENT_NUM            0x1085
 #define HPDF_PAGE_INVALID_OPERATOR_STACK          0x1086
+#define HPDF_TOO_MANY_SUPPLEMENTARY_CHARS         0x1087
 
 /*---------------------------------------------------------------------------*/
 
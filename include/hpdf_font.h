@@ -61,6 +61,30 @@ typedef HPDF_UINT
                               HPDF_REAL        *real_width);
 
 
+/* one character of a measured text. a character of more than one byte of
+ * a CID-keyed font has one unit for each of its bytes, the units of the
+ * trailing bytes have no HPDF_TEXT_UNIT_START flag and no width.
+ */
+typedef struct _HPDF_TextUnit {
+    HPDF_UINT   offset;
+    HPDF_INT    width;
+    HPDF_UINT   flags;
+} HPDF_TextUnit;
+
+#define HPDF_TEXT_UNIT_START        0x01
+#define HPDF_TEXT_UNIT_SPACE        0x02
+
+
+/* fills one unit for each character of the text and returns the number of
+ * units, which is not more than len.
+ */
+typedef HPDF_UINT
+(*HPDF_Font_CharWidths_Func)  (HPDF_Font         font,
+                               const HPDF_BYTE  *text,
+                               HPDF_UINT         len,
+                               HPDF_TextUnit    *units);
+
+
 typedef struct _HPDF_FontAttr_Rec  *HPDF_FontAttr;
 
 typedef struct _HPDF_FontAttr_Rec {
@@ -68,6 +92,7 @@ typedef struct _HPDF_FontAttr_Rec {
     HPDF_WritingMode            writing_mode;
     HPDF_Font_TextWidths_Func   text_width_fn;
     HPDF_Font_MeasureText_Func  measure_text_fn;
+    HPDF_Font_CharWidths_Func   char_widths_fn;
     HPDF_FontDef                fontdef;
     HPDF_Encoder                encoder;
 
@@ -78,10 +103,35 @@ typedef struct _HPDF_FontAttr_Rec {
     HPDF_INT16*                 widths;
     HPDF_BYTE*                  used;
 
+    /* the widths of a Type0 font based on a TrueType font are cached by
+     * unicode in pages of 256 entries, which are allocated when one of
+     * their characters is measured first. unknown widths are -1.
+     */
+    HPDF_INT16**                unicode_widths;
+
     HPDF_Xref                   xref;
     HPDF_Font                   descendant_font;
     HPDF_Dict                   map_stream;
     HPDF_Dict                   cmap_stream;
+
+    /* the codes a Type0 font with the UTF-8 encoder gave supplementary
+     * characters, and the number of them already added to the font.
+     */
+    HPDF_Ucs4Map_Rec            ucs4_map;
+    HPDF_UINT                   ucs4_count;
+
+    /* the CIDToGIDMap holds the glyph numbers of the compact subset */
+    HPDF_BOOL                   subset_gids;
+
+    /* the font which shows the glyph ids given to HPDF_Page_ShowGlyphs with
+     * a Type0 font based on a TrueType font. in that font, glyph_texts holds
+     * the text of the glyphs by their ids, the number of UTF-16 units
+     * followed by the units. no units stand for the character which the
+     * font maps to the glyph, NULL for no text.
+     */
+    HPDF_Font                   glyph_font;
+    HPDF_UNICODE**              glyph_texts;
+    HPDF_UINT                   num_glyphs;
 } HPDF_FontAttr_Rec;
 
 
@@ -104,9 +154,121 @@ HPDF_Type0Font_New  (HPDF_MMgr        mmgr,
                      HPDF_Xref        xref);
 
 
+/* marks the glyphs of the supplementary characters used with a Type0 font
+ * of a TrueType font. it must be called before the font data is saved.
+ */
+HPDF_STATUS
+HPDF_Type0Font_AddSupplementaryChars  (HPDF_Font   font);
+
+
+/* returns the font which shows glyph ids for a Type0 font of a TrueType
+ * font. its CIDs are the glyph ids, it is created on the first call.
+ */
+HPDF_Font
+HPDF_Type0Font_GetGlyphFont  (HPDF_Font   font);
+
+
+/* marks glyphs of a glyph font as used. the first glyph of a cluster takes
+ * the text from its cluster up to the next one for the ToUnicode cmap,
+ * decoded by the encoder of the font the same way as HPDF_Page_ShowText.
+ * without text and clusters, the glyphs take the characters which the font
+ * maps to them.
+ */
+HPDF_STATUS
+HPDF_Type0Font_UseGlyphs  (HPDF_Font           glyph_font,
+                           const HPDF_UINT16  *glyphs,
+                           HPDF_UINT           count,
+                           const char         *text,
+                           const HPDF_UINT    *clusters);
+
+
 HPDF_BOOL
 HPDF_Font_Validate  (HPDF_Font font);
 
+
+/* sums the widths of single byte text from a table of 256 widths, and
+ * counts the white space characters of the text in numspace. when used is
+ * not NULL, all_used is set to whether used is non-zero for every byte.
+ */
+HPDF_UINT
+HPDF_Font_SumWidths  (const HPDF_INT16  *widths,
+                      const HPDF_BYTE   *used,
+                      const HPDF_BYTE   *text,
+                      HPDF_UINT          len,
+                      HPDF_UINT         *numspace,
+                      HPDF_BOOL         *all_used);
+
+
+/*----------------------------------------------------------------------------*/
+/*----- HPDF_TextLayout ------------------------------------------------------*/
+
+/* a text measured once with a font. the units are used to break the text
+ * into lines of any width and at any font size, until the text is laid out
+ * with another font. units[num_units] only holds the length of the text.
+ */
+typedef struct _HPDF_TextLayout_Rec  *HPDF_TextLayout;
+
+typedef struct _HPDF_TextLayout_Rec {
+    HPDF_MMgr        mmgr;
+    HPDF_Error       error;
+
+    /* the list of the document which owns the layout, if any */
+    HPDF_List        owner;
+
+    const char      *text;
+    HPDF_UINT        len;
+
+    /* the text before pos has been laid out */
+    HPDF_UINT        pos;
+
+    HPDF_Font        font;
+    HPDF_TextUnit   *units;
+    HPDF_UINT        num_units;
+} HPDF_TextLayout_Rec;
+
+
+/* units must have room for len + 1 units */
+void
+HPDF_TextLayout_Init  (HPDF_TextLayout   layout,
+                       HPDF_MMgr         mmgr,
+                       const char       *text,
+                       HPDF_UINT         len,
+                       HPDF_TextUnit    *units);
+
+
+/* measures the text with the font unless it already was */
+HPDF_STATUS
+HPDF_TextLayout_Measure  (HPDF_TextLayout   layout,
+                          HPDF_Font         font);
+
+
+/* returns the index of the first unit at or after the byte offset */
+HPDF_UINT
+HPDF_TextLayout_FindUnit  (HPDF_TextLayout   layout,
+                           HPDF_UINT         offset);
+
+
+/* breaks the line starting at the unit first the same way as
+ * HPDF_Font_MeasureText would break the rest of the text, and returns the
+ * unit the next line starts at.
+ */
+HPDF_UINT
+HPDF_TextLayout_MeasureLine  (HPDF_TextLayout   layout,
+                              HPDF_UINT         first,
+                              HPDF_REAL         width,
+                              HPDF_REAL         font_size,
+                              HPDF_REAL         char_space,
+                              HPDF_REAL         word_space,
+                              HPDF_BOOL         wordwrap,
+                              HPDF_REAL        *real_width);
+
+
+/* the same as HPDF_Font_TextWidth of the units from first to last */
+HPDF_TextWidth
+HPDF_TextLayout_TextWidth  (HPDF_TextLayout   layout,
+                            HPDF_UINT         first,
+                            HPDF_UINT         last);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -218,6 +218,16 @@ typedef struct _HPDF_TTF_OffsetTbl {
 } HPDF_TTF_OffsetTbl;
 
 
+/* a run of consecutive character codes mapped to consecutive glyphs, as
+ * found in a format 12 cmap subtable.
+ */
+typedef struct _HPDF_TTF_CmapGroup {
+        HPDF_UINT32   start_code;
+        HPDF_UINT32   end_code;
+        HPDF_UINT32   start_glyph_id;
+} HPDF_TTF_CmapGroup;
+
+
 typedef struct _HPDF_TTF_CmapRange {
         HPDF_UINT16   format;
         HPDF_UINT16   length;
@@ -233,6 +243,9 @@ typedef struct _HPDF_TTF_CmapRange {
         HPDF_UINT16  *id_range_offset;
         HPDF_UINT16  *glyph_id_array;
         HPDF_UINT     glyph_id_array_count;
+        /* format 12 groups, sorted by start_code */
+        HPDF_UINT     num_groups;
+        HPDF_TTF_CmapGroup  *groups;
 } HPDF_TTF_CmapRange;
 
 
@@ -316,7 +329,34 @@ typedef struct _HPDF_TTFontDefAttr_Rec {
     HPDF_BOOL                embedding;
     HPDF_BOOL                is_cidfont;
 
+    /* the glyphs of the subset are numbered densely when the font is only
+     * used by Type0 fonts. gid_map gives the new number of each glyph, 0
+     * for the glyphs left out. it is created when the font data is saved.
+     */
+    HPDF_BOOL                compact_subset;
+    HPDF_BOOL                has_simple_font;
+    HPDF_UINT16             *gid_map;
+    HPDF_UINT16              num_subset_glyphs;
+
     HPDF_Stream              stream;
+
+    /* the font data saved ahead of the write by
+     * HPDF_TTFontDef_PrepareFontData, and the filters which the saved font
+     * data has been encoded with already.
+     */
+    struct _HPDF_TTFontSaveJob_Rec  *save_job;
+    HPDF_UINT                encoded_filter;
+
+    /* when the font definition was taken from the font cache, the tables
+     * belong to the cache entry and are shared with other documents. only
+     * glyph_tbl.flgs and stream belong to the font definition then.
+     */
+    struct _HPDF_TTFontCacheEntry_Rec  *cache_entry;
+
+    /* the finished subsets are kept in the cache entry for other documents
+     * which use the same glyphs.
+     */
+    HPDF_BOOL                cache_subsets;
 } HPDF_TTFontDefAttr_Rec;
 
 
@@ -338,14 +378,30 @@ HPDF_TTFontDef_Load2  (HPDF_MMgr     mmgr,
                        HPDF_BOOL     embedding);
 
 
+/* Loads a font definition through the process-wide font cache. The file
+ * is parsed only the first time a document asks for it, later documents
+ * share the parsed tables. index is the font in a TrueType collection or
+ * -1 for a TrueType file.
+ */
+HPDF_FontDef
+HPDF_TTFontDef_LoadCached  (HPDF_MMgr     mmgr,
+                            const char   *file_name,
+                            HPDF_INT      index,
+                            HPDF_BOOL     embedding);
+
+
+void
+HPDF_TTFontDef_FreeCache  (void);
+
+
 HPDF_UINT16
 HPDF_TTFontDef_GetGlyphid  (HPDF_FontDef   fontdef,
-                            HPDF_UINT16    unicode);
+                            HPDF_UINT32    unicode);
 
 
 HPDF_INT16
 HPDF_TTFontDef_GetCharWidth  (HPDF_FontDef   fontdef,
-                              HPDF_UINT16    unicode);
+                              HPDF_UINT32    unicode);
 
 
 HPDF_INT16
@@ -353,11 +409,38 @@ HPDF_TTFontDef_GetGidWidth  (HPDF_FontDef   fontdef,
                              HPDF_UINT16    gid);
 
 
+/* marks the glyph as used and returns its width */
+HPDF_INT16
+HPDF_TTFontDef_UseGlyph  (HPDF_FontDef   fontdef,
+                          HPDF_UINT16    gid);
+
+
 HPDF_STATUS
 HPDF_TTFontDef_SaveFontData  (HPDF_FontDef   fontdef,
                               HPDF_Stream    stream);
 
 
+/* saves the font data for the FontFile2 stream of a font with the given
+ * filters. the data may be encoded with the filters already, encoded_filter
+ * of the attributes tells which ones.
+ */
+HPDF_STATUS
+HPDF_TTFontDef_SaveFontFile  (HPDF_FontDef   fontdef,
+                              HPDF_Stream    stream,
+                              HPDF_UINT      filter);
+
+
+/* saves the font data of several font definitions on worker threads, and
+ * encodes it with the filters given for each of them. the data is kept
+ * until HPDF_TTFontDef_SaveFontFile is called for the font definition.
+ */
+HPDF_STATUS
+HPDF_TTFontDef_PrepareFontData  (HPDF_MMgr         mmgr,
+                                 HPDF_FontDef     *fontdefs,
+                                 const HPDF_UINT  *filters,
+                                 HPDF_UINT         count);
+
+
 HPDF_Box
 HPDF_TTFontDef_GetCharBBox  (HPDF_FontDef   fontdef,
                              HPDF_UINT16    unicode);
@@ -372,6 +455,12 @@ void
 HPDF_TTFontDef_EmbedAllGlyphs  (HPDF_FontDef  fontdef);
 
 
+/* returns the number of the glyph in the saved subset */
+HPDF_UINT16
+HPDF_TTFontDef_GetSubsetGid  (HPDF_FontDef   fontdef,
+                              HPDF_UINT16    gid);
+
+
 /*----------------------------------------------------------------------------*/
 /*----- HPDF_CIDFontDef  -----------------------------------------------------*/
 
@@ -381,8 +470,23 @@ typedef struct _HPDF_CIDFontDefAttrRec {
     HPDF_List     widths;
     HPDF_INT16    DW;
     HPDF_INT16    DW2[2];
+
+    /* the widths indexed by CID, entries without a width are set to
+     * HPDF_CID_WIDTH_NONE */
+    HPDF_INT16   *width_table;
+    HPDF_UINT     width_table_len;
 } HPDF_CIDFontDefAttr_Rec;
 
+#define HPDF_CID_WIDTH_NONE   (-32767 - 1)
+
+
+/* a font of a family which HPDF_UseXXFonts registers. the fontdef is
+ * created when a document first asks for its name. */
+typedef struct _HPDF_CIDFontDefEntry_Rec {
+    const char              *name;
+    HPDF_FontDef_InitFunc    init_fn;
+} HPDF_CIDFontDefEntry_Rec;
+
 
 HPDF_FontDef
 HPDF_CIDFontDef_New  (HPDF_MMgr               mmgr,
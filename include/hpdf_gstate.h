@@ -30,6 +30,27 @@ extern "C" {
 
 typedef struct _HPDF_GState_Rec  *HPDF_GState;
 
+/* flags of HPDF_GState_Rec.known. a parameter whose flag is set is known
+ * to be in effect in the content stream with the value held in the
+ * gstate, so setting the same value again may be skipped.
+ */
+#define HPDF_GSTATE_LINE_WIDTH      0x0001
+#define HPDF_GSTATE_LINE_CAP        0x0002
+#define HPDF_GSTATE_LINE_JOIN       0x0004
+#define HPDF_GSTATE_MITER_LIMIT     0x0008
+#define HPDF_GSTATE_DASH            0x0010
+#define HPDF_GSTATE_FLATNESS        0x0020
+#define HPDF_GSTATE_CHAR_SPACE      0x0040
+#define HPDF_GSTATE_WORD_SPACE      0x0080
+#define HPDF_GSTATE_H_SCALING       0x0100
+#define HPDF_GSTATE_TEXT_LEADING    0x0200
+#define HPDF_GSTATE_RENDERING_MODE  0x0400
+#define HPDF_GSTATE_TEXT_RISE       0x0800
+#define HPDF_GSTATE_FILL_COLOR      0x1000
+#define HPDF_GSTATE_STROKE_COLOR    0x2000
+#define HPDF_GSTATE_FONT            0x4000
+#define HPDF_GSTATE_ALL             0x7FFF
+
 typedef struct _HPDF_GState_Rec {
     HPDF_TransMatrix        trans_matrix;
     HPDF_REAL               line_width;
@@ -61,6 +82,7 @@ typedef struct _HPDF_GState_Rec {
 
     HPDF_GState             prev;
     HPDF_UINT               depth;
+    HPDF_UINT               known;
 } HPDF_GState_Rec;
 
 /*----------------------------------------------------------------------------*/
@@ -75,6 +97,10 @@ HPDF_GState
 HPDF_GState_Free  (HPDF_MMgr    mmgr,
                    HPDF_GState  gstate);
 
+
+void
+HPDF_GState_Invalidate  (HPDF_GState  gstate);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
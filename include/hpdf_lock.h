@@ -0,0 +1,56 @@
+/*
+ * << Haru Free PDF Library >> -- hpdf_lock.h
+ *
+ * URL: http://libharu.org
+ *
+ * Permission to use, copy, modify, distribute and sell this software
+ * and its documentation for any purpose is hereby granted without fee,
+ * provided that the above copyright notice appear in all copies and
+ * that both that copyright notice and this permission notice appear
+ * in supporting documentation.
+ * It is provided "as is" without express or implied warranty.
+ *
+ */
+
+#ifndef _HPDF_LOCK_H
+#define _HPDF_LOCK_H
+
+/* a statically initialized lock for the state shared by all documents.
+ * waiting threads block instead of spinning, and the lock is not
+ * recursive.
+ *
+ *   static HPDF_Lock lock = HPDF_LOCK_INIT;
+ *
+ *   HPDF_Lock_Acquire (&lock);
+ *   ...
+ *   HPDF_Lock_Release (&lock);
+ */
+
+#if defined(_WIN32)
+
+/* slim reader/writer locks need Windows Vista */
+#if !defined(_WIN32_WINNT)
+#define _WIN32_WINNT 0x0600
+#endif
+
+#include <windows.h>
+
+typedef SRWLOCK  HPDF_Lock;
+
+#define HPDF_LOCK_INIT            SRWLOCK_INIT
+#define HPDF_Lock_Acquire(lock)   AcquireSRWLockExclusive (lock)
+#define HPDF_Lock_Release(lock)   ReleaseSRWLockExclusive (lock)
+
+#else
+
+#include <pthread.h>
+
+typedef pthread_mutex_t  HPDF_Lock;
+
+#define HPDF_LOCK_INIT            PTHREAD_MUTEX_INITIALIZER
+#define HPDF_Lock_Acquire(lock)   pthread_mutex_lock (lock)
+#define HPDF_Lock_Release(lock)   pthread_mutex_unlock (lock)
+
+#endif
+
+#endif /* _HPDF_LOCK_H */
@@ -437,6 +437,7 @@ typedef struct _HPDF_Dict_Rec {
     HPDF_Dict_FreeFunc         free_fn;
     HPDF_Stream                stream;
     HPDF_UINT                  filter;
+    HPDF_UINT                  encoded_filter;
     HPDF_Dict                  filterParams;
     void                       *attr;
 } HPDF_Dict_Rec;
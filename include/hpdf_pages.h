@@ -66,6 +66,8 @@ typedef struct _HPDF_PageAttr_Rec {
     HPDF_Xref          xref;
     HPDF_UINT          compression_mode;
     HPDF_UINT          text_placement_accuracy;
+    HPDF_UINT          optimization_mode;
+    HPDF_UINT          optimized_bytes;
     HPDF_UINT          text_stack;
     HPDF_UINT          marked_content_stack;
     HPDF_UINT          marked_content_id;
@@ -132,6 +134,11 @@ HPDF_Page_SetTextPlacementAccuracy  (HPDF_Page    page,
                                      HPDF_UINT decimal_places);
 
 
+void
+HPDF_Page_SetOptimizationMode  (HPDF_Page    page,
+                                HPDF_UINT    mode);
+
+
 HPDF_STATUS
 HPDF_Page_CheckState  (HPDF_Page  page,
                        HPDF_UINT  mode);
@@ -34,7 +34,8 @@ typedef enum _HPDF_StreamType {
     HPDF_STREAM_UNKNOWN = 0,
     HPDF_STREAM_CALLBACK,
     HPDF_STREAM_FILE,
-    HPDF_STREAM_MEMORY
+    HPDF_STREAM_MEMORY,
+    HPDF_STREAM_BUFFER
 } HPDF_StreamType;
 
 #define HPDF_STREAM_FILTER_NONE          0x0000
@@ -96,6 +97,21 @@ typedef struct _HPDF_MemStreamAttr_Rec {
 } HPDF_MemStreamAttr_Rec;
 
 
+/* read-only stream over one contiguous block of memory. the block is a
+ * buffer owned by the caller, a mapping of a file or a file read into
+ * memory at once, so that readers may take the bytes from buf directly.
+ */
+typedef struct _HPDF_BufferReaderAttr_Rec  *HPDF_BufferReaderAttr;
+
+typedef struct _HPDF_BufferReaderAttr_Rec {
+    const HPDF_BYTE  *buf;
+    HPDF_UINT        size;
+    HPDF_UINT        pos;
+    HPDF_BYTE        *own_buf;
+    HPDF_BOOL        mapped;
+} HPDF_BufferReaderAttr_Rec;
+
+
 typedef struct _HPDF_Stream_Rec {
     HPDF_UINT32               sig_bytes;
     HPDF_StreamType           type;
@@ -154,6 +170,20 @@ HPDF_FileReader_New  (HPDF_MMgr   mmgr,
                       const char  *fname);
 
 
+/* the buffer is not copied, it must stay valid until the stream is freed */
+HPDF_Stream
+HPDF_BufferReader_New  (HPDF_MMgr         mmgr,
+                        const HPDF_BYTE  *buf,
+                        HPDF_UINT         size);
+
+
+/* maps the file into memory, or reads it at once where the platform has
+ * no mmap. */
+HPDF_Stream
+HPDF_MappedFileReader_New  (HPDF_MMgr    mmgr,
+                            const char  *fname);
+
+
 HPDF_Stream
 HPDF_FileWriter_New  (HPDF_MMgr        mmgr,
                       const char  *fname);
@@ -206,6 +206,19 @@ typedef struct _HPDF_TextWidth {
 } HPDF_TextWidth;
 
 
+/*---------------------------------------------------------------------------*/
+/*------ text run struct ----------------------------------------------------*/
+
+/* a text shown by HPDF_Page_ShowTextRuns. the run is moved by offset along
+ * the writing direction before it is shown, in thousandths of the font
+ * size.
+ */
+typedef struct _HPDF_TextRun {
+    const char  *text;
+    HPDF_REAL    offset;
+} HPDF_TextRun;
+
+
 /*---------------------------------------------------------------------------*/
 /*------ dash mode ----------------------------------------------------------*/
 
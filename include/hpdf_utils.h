@@ -27,6 +27,7 @@ extern "C" {
 
 /* can be used for rounding to 0-5 decimal places */
 static const int HPDF_DECIMAL_ROUND_COEFFICIENT[] = {1, 10, 100, 1000, 10000, 100000};
+#define HPDF_MAX_DECIMAL_PLACES  5
 
 HPDF_INT
 HPDF_AToI  (const char*  s);
@@ -259,8 +259,9 @@ HPDF_Dict_Write  (HPDF_Dict     dict,
         if (e)
             HPDF_Encrypt_Reset (e);
 
+        /* the data may have been encoded with some of the filters already */
         if ((ret = HPDF_Stream_WriteToStream (dict->stream, stream,
-                        dict->filter, e)) != HPDF_OK)
+                        dict->filter & ~dict->encoded_filter, e)) != HPDF_OK)
             return ret;
 
         HPDF_Number_SetValue (length, stream->size - strptr);
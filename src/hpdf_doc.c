@@ -48,6 +48,10 @@ static HPDF_STATUS
 PrepareTrailer  (HPDF_Doc   pdf);
 
 
+static HPDF_STATUS
+PrepareFontData  (HPDF_Doc   pdf);
+
+
 static void
 FreeEncoderList (HPDF_Doc  pdf);
 
@@ -60,6 +64,34 @@ static void
 CleanupFontDefList (HPDF_Doc  pdf);
 
 
+static void
+FreeTextLayouts (HPDF_Doc  pdf);
+
+
+static void
+CleanupTextLayouts (HPDF_Doc  pdf);
+
+
+static HPDF_STATUS
+AddEntries  (HPDF_Doc     pdf,
+             HPDF_List   *list,
+             const void  *entries);
+
+
+static HPDF_FontDef
+NewEntryFontDef  (HPDF_Doc     pdf,
+                  const char  *font_name);
+
+
+static HPDF_Encoder
+NewEntryEncoder  (HPDF_Doc     pdf,
+                  const char  *encoding_name);
+
+
+static HPDF_Encoder
+InitEncoder  (HPDF_Encoder  encoder);
+
+
 static HPDF_Dict
 GetInfo  (HPDF_Doc  pdf);
 
@@ -93,6 +125,12 @@ LoadTTFontFromStream2 (HPDF_Doc         pdf,
                        const char      *file_name);
 
 
+static const char*
+AddTTFontDef  (HPDF_Doc       pdf,
+               HPDF_FontDef   def,
+               HPDF_BOOL      embedding);
+
+
 /*---------------------------------------------------------------------------*/
 
 HPDF_EXPORT(const char *)
@@ -179,6 +217,7 @@ HPDF_NewEx  (HPDF_Error_Handler    user_error_fn,
     pdf->compression_mode = HPDF_COMP_NONE;
 
     pdf->text_placement_accuracy = HPDF_DEF_TEXT_PLACEMENT_ACCURACY;
+    pdf->optimization_mode = HPDF_OPTIMIZE_NONE;
     pdf->write_font_widths = HPDF_TRUE;
 
     /* copy the data of temporary-error object to the one which is
@@ -301,6 +340,9 @@ HPDF_FreeDoc  (HPDF_Doc  pdf)
         if (pdf->fontdef_list)
             CleanupFontDefList (pdf);
 
+        if (pdf->text_layouts)
+            CleanupTextLayouts (pdf);
+
         HPDF_MemSet(pdf->ttfont_tag, 0, 6);
 
         pdf->pdf_version = HPDF_VER_13;
@@ -347,8 +389,22 @@ HPDF_FreeDocAll  (HPDF_Doc  pdf)
         if (pdf->encoder_list)
             FreeEncoderList (pdf);
 
+        if (pdf->fontdef_entries) {
+            HPDF_List_Free (pdf->fontdef_entries);
+            pdf->fontdef_entries = NULL;
+        }
+
+        if (pdf->encoder_entries) {
+            HPDF_List_Free (pdf->encoder_entries);
+            pdf->encoder_entries = NULL;
+        }
+
+        if (pdf->text_layouts)
+            FreeTextLayouts (pdf);
+
         pdf->compression_mode = HPDF_COMP_NONE;
         pdf->text_placement_accuracy = HPDF_DEF_TEXT_PLACEMENT_ACCURACY;
+        pdf->optimization_mode = HPDF_OPTIMIZE_NONE;
         pdf->write_font_widths = HPDF_TRUE;
 
         HPDF_Error_Reset (&pdf->error);
@@ -612,6 +668,74 @@ HPDF_Doc_PrepareEncryption  (HPDF_Doc   pdf)
 }
 
 
+/* the data of the embedded TrueType fonts is subset, and deflated when the
+ * font is compressed, on worker threads before the objects are written.
+ * the font which comes first in the cross-reference table writes the data
+ * of its font definition.
+ */
+static HPDF_STATUS
+PrepareFontData  (HPDF_Doc   pdf)
+{
+    HPDF_FontDef *fontdefs;
+    HPDF_UINT *filters;
+    HPDF_UINT count = 0;
+    HPDF_UINT i;
+    HPDF_STATUS ret = HPDF_OK;
+
+    if (pdf->font_mgr->count < 2)
+        return HPDF_OK;
+
+    fontdefs = HPDF_GetMem (pdf->mmgr,
+            sizeof(HPDF_FontDef) * pdf->font_mgr->count);
+    if (!fontdefs)
+        return pdf->error.error_no;
+
+    filters = HPDF_GetMem (pdf->mmgr,
+            sizeof(HPDF_UINT) * pdf->font_mgr->count);
+    if (!filters) {
+        HPDF_FreeMem (pdf->mmgr, fontdefs);
+        return pdf->error.error_no;
+    }
+
+    for (i = 0; i < pdf->font_mgr->count; i++) {
+        HPDF_Font font = (HPDF_Font)HPDF_List_ItemAt (pdf->font_mgr, i);
+        HPDF_FontAttr attr = (HPDF_FontAttr)font->attr;
+        HPDF_FontDef fontdef = attr->fontdef;
+        HPDF_UINT j;
+
+        if (fontdef->type != HPDF_FONTDEF_TYPE_TRUETYPE ||
+                fontdef->descriptor ||
+                !((HPDF_TTFontDefAttr)fontdef->attr)->embedding)
+            continue;
+
+        /* every font of the font definition marks its glyphs first */
+        if (attr->type == HPDF_FONT_TYPE0_TT &&
+                (ret = HPDF_Type0Font_AddSupplementaryChars (font)) !=
+                HPDF_OK)
+            break;
+
+        for (j = 0; j < count; j++)
+            if (fontdefs[j] == fontdef)
+                break;
+
+        if (j == count) {
+            fontdefs[count] = fontdef;
+            filters[count] = font->filter;
+            count++;
+        }
+    }
+
+    if (ret == HPDF_OK && count > 1)
+        ret = HPDF_TTFontDef_PrepareFontData (pdf->mmgr, fontdefs, filters,
+                count);
+
+    HPDF_FreeMem (pdf->mmgr, filters);
+    HPDF_FreeMem (pdf->mmgr, fontdefs);
+
+    return ret;
+}
+
+
 static HPDF_STATUS
 InternalSaveToStream  (HPDF_Doc      pdf,
                        HPDF_Stream   stream)
@@ -625,6 +749,9 @@ InternalSaveToStream  (HPDF_Doc      pdf,
     if ((ret = PrepareTrailer (pdf)) != HPDF_OK)
         return ret;
 
+    if ((ret = PrepareFontData (pdf)) != HPDF_OK)
+        return ret;
+
     /* prepare encription */
     if (pdf->encrypt_on) {
         HPDF_Encrypt e= HPDF_EncryptDict_GetAttr (pdf->encrypt_dict);
@@ -910,6 +1037,7 @@ HPDF_AddPage  (HPDF_Doc  pdf)
         HPDF_Page_SetFilter (page, HPDF_STREAM_FILTER_FLATE_DECODE);
 
     HPDF_Page_SetTextPlacementAccuracy (page, pdf->text_placement_accuracy);
+    HPDF_Page_SetOptimizationMode (page, pdf->optimization_mode);
 
     pdf->cur_page_num++;
 
@@ -993,6 +1121,7 @@ HPDF_InsertPage  (HPDF_Doc    pdf,
         HPDF_Page_SetFilter (page, HPDF_STREAM_FILTER_FLATE_DECODE);
 
     HPDF_Page_SetTextPlacementAccuracy (page, pdf->text_placement_accuracy);
+    HPDF_Page_SetOptimizationMode (page, pdf->optimization_mode);
 
     return page;
 }
@@ -1054,12 +1183,13 @@ HPDF_Doc_FindFontDef  (HPDF_Doc          pdf,
                        const char  *font_name)
 {
     HPDF_List list = pdf->fontdef_list;
+    HPDF_FontDef def;
     HPDF_UINT i;
 
     HPDF_PTRACE ((" HPDF_Doc_FindFontDef\n"));
 
     for (i = 0; i < list->count; i++) {
-        HPDF_FontDef def = (HPDF_FontDef)HPDF_List_ItemAt (list, i);
+        def = (HPDF_FontDef)HPDF_List_ItemAt (list, i);
 
         if (HPDF_StrCmp (font_name, def->base_font) == 0) {
             if (def->type == HPDF_FONTDEF_TYPE_UNINITIALIZED) {
@@ -1072,6 +1202,81 @@ HPDF_Doc_FindFontDef  (HPDF_Doc          pdf,
         }
     }
 
+    /* the fonts of registered families are created on first use */
+    def = NewEntryFontDef (pdf, font_name);
+    if (def && (!def->init_fn || def->init_fn (def) != HPDF_OK))
+        return NULL;
+
+    return def;
+}
+
+
+static HPDF_STATUS
+AddEntries  (HPDF_Doc     pdf,
+             HPDF_List   *list,
+             const void  *entries)
+{
+    HPDF_STATUS ret;
+
+    if (!*list) {
+        *list = HPDF_List_New (pdf->mmgr, HPDF_DEF_ITEMS_PER_BLOCK);
+        if (!*list)
+            return pdf->error.error_no;
+    }
+
+    if (HPDF_List_Find (*list, (void *)entries) >= 0)
+        return HPDF_SetError (&pdf->error, HPDF_DUPLICATE_REGISTRATION, 0);
+
+    if ((ret = HPDF_List_Add (*list, (void *)entries)) != HPDF_OK)
+        return HPDF_SetError (&pdf->error, ret, 0);
+
+    return HPDF_OK;
+}
+
+
+HPDF_STATUS
+HPDF_Doc_RegisterCIDFontDefs  (HPDF_Doc                         pdf,
+                               const HPDF_CIDFontDefEntry_Rec  *entries)
+{
+    HPDF_PTRACE ((" HPDF_Doc_RegisterCIDFontDefs\n"));
+
+    return AddEntries (pdf, &pdf->fontdef_entries, entries);
+}
+
+
+static HPDF_FontDef
+NewEntryFontDef  (HPDF_Doc     pdf,
+                  const char  *font_name)
+{
+    HPDF_List list = pdf->fontdef_entries;
+    HPDF_UINT i;
+
+    if (!list)
+        return NULL;
+
+    for (i = 0; i < list->count; i++) {
+        const HPDF_CIDFontDefEntry_Rec *entry = HPDF_List_ItemAt (list, i);
+
+        for (; entry->name; entry++) {
+            HPDF_FontDef def;
+
+            if (HPDF_StrCmp (font_name, entry->name) != 0)
+                continue;
+
+            def = HPDF_CIDFontDef_New (pdf->mmgr, (char *)entry->name,
+                    entry->init_fn);
+            if (!def)
+                return NULL;
+
+            if (HPDF_List_Add (pdf->fontdef_list, def) != HPDF_OK) {
+                HPDF_FontDef_Free (def);
+                return NULL;
+            }
+
+            return def;
+        }
+    }
+
     return NULL;
 }
 
@@ -1136,6 +1341,23 @@ HPDF_GetFontDef  (HPDF_Doc          pdf,
 /*----- encoder handling ----------------------------------------------------*/
 
 
+static HPDF_Encoder
+InitEncoder  (HPDF_Encoder  encoder)
+{
+    if (!encoder || encoder->type != HPDF_ENCODER_TYPE_UNINITIALIZED)
+        return encoder;
+
+    if (!encoder->init_fn || encoder->init_fn (encoder) != HPDF_OK)
+        return NULL;
+
+    /* the tables of CMap encoders are shared by documents */
+    if (encoder->type == HPDF_ENCODER_TYPE_DOUBLE_BYTE)
+        HPDF_CMapEncoder_ShareTables (encoder);
+
+    return encoder;
+}
+
+
 HPDF_Encoder
 HPDF_Doc_FindEncoder  (HPDF_Doc         pdf,
                        const char  *encoding_name)
@@ -1151,10 +1373,55 @@ HPDF_Doc_FindEncoder  (HPDF_Doc         pdf,
         if (HPDF_StrCmp (encoding_name, encoder->name) == 0) {
 
             /* if encoder is uninitialize, call init_fn() */
-            if (encoder->type == HPDF_ENCODER_TYPE_UNINITIALIZED) {
-                if (!encoder->init_fn ||
-                    encoder->init_fn (encoder) != HPDF_OK)
-                    return NULL;
+            if (encoder->type == HPDF_ENCODER_TYPE_UNINITIALIZED)
+                return InitEncoder (encoder);
+
+            return encoder;
+        }
+    }
+
+    /* the encoders of registered families are created on first use */
+    return InitEncoder (NewEntryEncoder (pdf, encoding_name));
+}
+
+
+HPDF_STATUS
+HPDF_Doc_RegisterCMapEncoders  (HPDF_Doc                          pdf,
+                                const HPDF_CMapEncoderEntry_Rec  *entries)
+{
+    HPDF_PTRACE ((" HPDF_Doc_RegisterCMapEncoders\n"));
+
+    return AddEntries (pdf, &pdf->encoder_entries, entries);
+}
+
+
+static HPDF_Encoder
+NewEntryEncoder  (HPDF_Doc     pdf,
+                  const char  *encoding_name)
+{
+    HPDF_List list = pdf->encoder_entries;
+    HPDF_UINT i;
+
+    if (!list)
+        return NULL;
+
+    for (i = 0; i < list->count; i++) {
+        const HPDF_CMapEncoderEntry_Rec *entry = HPDF_List_ItemAt (list, i);
+
+        for (; entry->name; entry++) {
+            HPDF_Encoder encoder;
+
+            if (HPDF_StrCmp (encoding_name, entry->name) != 0)
+                continue;
+
+            encoder = HPDF_CMapEncoder_New (pdf->mmgr, (char *)entry->name,
+                    entry->init_fn);
+            if (!encoder)
+                return NULL;
+
+            if (HPDF_List_Add (pdf->encoder_list, encoder) != HPDF_OK) {
+                HPDF_Encoder_Free (encoder);
+                return NULL;
             }
 
             return encoder;
@@ -1640,6 +1907,95 @@ LoadType1FontFromStream2  (HPDF_Doc      pdf,
     return NULL;
 }
 
+/* adds a TrueType font definition to the document, unless the document has
+ * one of the same name already, and gives it a tag name when it is
+ * embedded.
+ */
+static const char*
+AddTTFontDef  (HPDF_Doc       pdf,
+               HPDF_FontDef   def,
+               HPDF_BOOL      embedding)
+{
+    HPDF_PTRACE ((" AddTTFontDef\n"));
+
+    if (def) {
+        HPDF_FontDef  tmpdef = HPDF_Doc_FindFontDef (pdf, def->base_font);
+        if (tmpdef) {
+            HPDF_FontDef_Free (def);
+            return tmpdef->base_font;
+        }
+
+        if (HPDF_List_Add (pdf->fontdef_list, def) != HPDF_OK) {
+            HPDF_FontDef_Free (def);
+            return NULL;
+        }
+
+        if (pdf->use_subset_cache)
+            ((HPDF_TTFontDefAttr)def->attr)->cache_subsets = HPDF_TRUE;
+    } else
+        return NULL;
+
+    if (embedding) {
+        if (pdf->ttfont_tag[0] == 0) {
+            HPDF_MemCpy (pdf->ttfont_tag, (HPDF_BYTE *)"HPDFAA", 6);
+        } else {
+            HPDF_INT i;
+
+            for (i = 5; i >= 0; i--) {
+                pdf->ttfont_tag[i] += 1;
+                if (pdf->ttfont_tag[i] > 'Z')
+                    pdf->ttfont_tag[i] = 'A';
+                else
+                    break;
+            }
+        }
+
+        HPDF_TTFontDef_SetTagName (def, (char *)pdf->ttfont_tag);
+    }
+
+    return def->base_font;
+}
+
+
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_UseFontCache  (HPDF_Doc   pdf)
+{
+    HPDF_PTRACE ((" HPDF_UseFontCache\n"));
+
+    if (!HPDF_HasDoc (pdf))
+        return HPDF_INVALID_DOCUMENT;
+
+    pdf->use_font_cache = HPDF_TRUE;
+
+    return HPDF_OK;
+}
+
+
+HPDF_EXPORT(void)
+HPDF_FreeFontCache  (void)
+{
+    HPDF_PTRACE ((" HPDF_FreeFontCache\n"));
+
+    HPDF_TTFontDef_FreeCache ();
+    HPDF_CMapEncoder_FreeTables ();
+}
+
+
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_UseSubsetCache  (HPDF_Doc   pdf)
+{
+    HPDF_PTRACE ((" HPDF_UseSubsetCache\n"));
+
+    if (!HPDF_HasDoc (pdf))
+        return HPDF_INVALID_DOCUMENT;
+
+    pdf->use_font_cache = HPDF_TRUE;
+    pdf->use_subset_cache = HPDF_TRUE;
+
+    return HPDF_OK;
+}
+
+
 HPDF_EXPORT(HPDF_FontDef)
 HPDF_GetTTFontDefFromFile (HPDF_Doc      pdf,
                            const char   *file_name,
@@ -1651,7 +2007,7 @@ HPDF_GetTTFontDefFromFile (HPDF_Doc      pdf,
 	HPDF_PTRACE ((" HPDF_GetTTFontDefFromFile\n"));
 
 	/* create file stream */
-	font_data = HPDF_FileReader_New (pdf->mmgr, file_name);
+	font_data = HPDF_MappedFileReader_New (pdf->mmgr, file_name);
 
 	if (HPDF_Stream_Validate (font_data)) {
 		def = HPDF_TTFontDef_Load (pdf->mmgr, font_data, embedding);
@@ -1676,13 +2032,18 @@ HPDF_LoadTTFontFromFile (HPDF_Doc         pdf,
     if (!HPDF_HasDoc (pdf))
         return NULL;
 
-    /* create file stream */
-    font_data = HPDF_FileReader_New (pdf->mmgr, file_name);
+    if (pdf->use_font_cache) {
+        ret = AddTTFontDef (pdf, HPDF_TTFontDef_LoadCached (pdf->mmgr,
+                    file_name, -1, embedding), embedding);
+    } else {
+        /* create file stream */
+        font_data = HPDF_MappedFileReader_New (pdf->mmgr, file_name);
 
-    if (HPDF_Stream_Validate (font_data)) {
-        ret = LoadTTFontFromStream (pdf, font_data, embedding, file_name);
-    } else
-        ret = NULL;
+        if (HPDF_Stream_Validate (font_data)) {
+            ret = LoadTTFontFromStream (pdf, font_data, embedding, file_name);
+        } else
+            ret = NULL;
+    }
 
     if (!ret)
         HPDF_CheckError (&pdf->error);
@@ -1703,39 +2064,8 @@ LoadTTFontFromStream (HPDF_Doc         pdf,
     HPDF_UNUSED (file_name);
 
     def = HPDF_TTFontDef_Load (pdf->mmgr, font_data, embedding);
-    if (def) {
-        HPDF_FontDef  tmpdef = HPDF_Doc_FindFontDef (pdf, def->base_font);
-        if (tmpdef) {
-            HPDF_FontDef_Free (def);
-            return tmpdef->base_font;
-        }
-
-        if (HPDF_List_Add (pdf->fontdef_list, def) != HPDF_OK) {
-            HPDF_FontDef_Free (def);
-            return NULL;
-        }
-    } else
-        return NULL;
 
-    if (embedding) {
-        if (pdf->ttfont_tag[0] == 0) {
-            HPDF_MemCpy (pdf->ttfont_tag, (HPDF_BYTE *)"HPDFAA", 6);
-        } else {
-            HPDF_INT i;
-
-            for (i = 5; i >= 0; i--) {
-                pdf->ttfont_tag[i] += 1;
-                if (pdf->ttfont_tag[i] > 'Z')
-                    pdf->ttfont_tag[i] = 'A';
-                else
-                    break;
-            }
-        }
-
-        HPDF_TTFontDef_SetTagName (def, (char *)pdf->ttfont_tag);
-    }
-
-    return def->base_font;
+    return AddTTFontDef (pdf, def, embedding);
 }
 
 
@@ -1753,13 +2083,19 @@ HPDF_LoadTTFontFromFile2 (HPDF_Doc         pdf,
     if (!HPDF_HasDoc (pdf))
         return NULL;
 
-    /* create file stream */
-    font_data = HPDF_FileReader_New (pdf->mmgr, file_name);
+    if (pdf->use_font_cache) {
+        ret = AddTTFontDef (pdf, HPDF_TTFontDef_LoadCached (pdf->mmgr,
+                    file_name, (HPDF_INT)index, embedding), embedding);
+    } else {
+        /* create file stream */
+        font_data = HPDF_MappedFileReader_New (pdf->mmgr, file_name);
 
-    if (HPDF_Stream_Validate (font_data)) {
-        ret = LoadTTFontFromStream2 (pdf, font_data, index, embedding, file_name);
-    } else
-        ret = NULL;
+        if (HPDF_Stream_Validate (font_data)) {
+            ret = LoadTTFontFromStream2 (pdf, font_data, index, embedding,
+                    file_name);
+        } else
+            ret = NULL;
+    }
 
     if (!ret)
         HPDF_CheckError (&pdf->error);
@@ -1781,39 +2117,76 @@ LoadTTFontFromStream2 (HPDF_Doc         pdf,
     HPDF_UNUSED (file_name);
 
     def = HPDF_TTFontDef_Load2 (pdf->mmgr, font_data, index, embedding);
-    if (def) {
-        HPDF_FontDef  tmpdef = HPDF_Doc_FindFontDef (pdf, def->base_font);
-        if (tmpdef) {
-            HPDF_FontDef_Free (def);
-            return tmpdef->base_font;
-        }
 
-        if (HPDF_List_Add (pdf->fontdef_list, def) != HPDF_OK) {
-            HPDF_FontDef_Free (def);
-            return NULL;
-        }
-    } else
+    return AddTTFontDef (pdf, def, embedding);
+}
+
+
+HPDF_EXPORT(const char*)
+HPDF_LoadTTFontFromMem (HPDF_Doc          pdf,
+                        const HPDF_BYTE  *buffer,
+                        HPDF_UINT         size,
+                        HPDF_BOOL         embedding)
+{
+    HPDF_Stream font_data;
+    const char *ret;
+
+    HPDF_PTRACE ((" HPDF_LoadTTFontFromMem\n"));
+
+    if (!HPDF_HasDoc (pdf))
         return NULL;
 
-    if (embedding) {
-        if (pdf->ttfont_tag[0] == 0) {
-            HPDF_MemCpy (pdf->ttfont_tag, (HPDF_BYTE *)"HPDFAA", 6);
-        } else {
-            HPDF_INT i;
+    if (!buffer || size == 0) {
+        HPDF_RaiseError (&pdf->error, HPDF_INVALID_PARAMETER, 0);
+        return NULL;
+    }
 
-            for (i = 5; i >= 0; i--) {
-                pdf->ttfont_tag[i] += 1;
-                if (pdf->ttfont_tag[i] > 'Z')
-                    pdf->ttfont_tag[i] = 'A';
-                else
-                    break;
-            }
-        }
+    /* the stream borrows the buffer */
+    font_data = HPDF_BufferReader_New (pdf->mmgr, buffer, size);
 
-        HPDF_TTFontDef_SetTagName (def, (char *)pdf->ttfont_tag);
+    if (HPDF_Stream_Validate (font_data)) {
+        ret = LoadTTFontFromStream (pdf, font_data, embedding, NULL);
+    } else
+        ret = NULL;
+
+    if (!ret)
+        HPDF_CheckError (&pdf->error);
+
+    return ret;
+}
+
+
+HPDF_EXPORT(const char*)
+HPDF_LoadTTFontFromMem2 (HPDF_Doc          pdf,
+                         const HPDF_BYTE  *buffer,
+                         HPDF_UINT         size,
+                         HPDF_UINT         index,
+                         HPDF_BOOL         embedding)
+{
+    HPDF_Stream font_data;
+    const char *ret;
+
+    HPDF_PTRACE ((" HPDF_LoadTTFontFromMem2\n"));
+
+    if (!HPDF_HasDoc (pdf))
+        return NULL;
+
+    if (!buffer || size == 0) {
+        HPDF_RaiseError (&pdf->error, HPDF_INVALID_PARAMETER, 0);
+        return NULL;
     }
 
-    return def->base_font;
+    font_data = HPDF_BufferReader_New (pdf->mmgr, buffer, size);
+
+    if (HPDF_Stream_Validate (font_data)) {
+        ret = LoadTTFontFromStream2 (pdf, font_data, index, embedding, NULL);
+    } else
+        ret = NULL;
+
+    if (!ret)
+        HPDF_CheckError (&pdf->error);
+
+    return ret;
 }
 
 
@@ -2334,6 +2707,99 @@ HPDF_CreateExtGState  (HPDF_Doc  pdf)
 }
 
 
+static void
+FreeTextLayouts  (HPDF_Doc  pdf)
+{
+    HPDF_List list = pdf->text_layouts;
+    HPDF_UINT i;
+
+    HPDF_PTRACE ((" FreeTextLayouts\n"));
+
+    for (i = 0; i < list->count; i++)
+        HPDF_FreeMem (pdf->mmgr, HPDF_List_ItemAt (list, i));
+
+    HPDF_List_Free (list);
+
+    pdf->text_layouts = NULL;
+}
+
+
+/* the fonts of the document are freed, so the layouts are measured again
+ * with the next font even if it is allocated at the same address.
+ */
+static void
+CleanupTextLayouts  (HPDF_Doc  pdf)
+{
+    HPDF_List list = pdf->text_layouts;
+    HPDF_UINT i;
+
+    HPDF_PTRACE ((" CleanupTextLayouts\n"));
+
+    for (i = 0; i < list->count; i++) {
+        HPDF_TextLayout layout = (HPDF_TextLayout)HPDF_List_ItemAt (list, i);
+
+        layout->font = NULL;
+    }
+}
+
+
+HPDF_EXPORT(HPDF_TextLayout)
+HPDF_CreateTextLayout  (HPDF_Doc     pdf,
+                        const char  *text)
+{
+    HPDF_TextLayout layout;
+    HPDF_TextUnit *units;
+    char *buf;
+    HPDF_UINT len;
+
+    HPDF_PTRACE ((" HPDF_CreateTextLayout\n"));
+
+    if (!HPDF_HasDoc (pdf))
+        return NULL;
+
+    len = HPDF_StrLen (text, HPDF_LIMIT_MAX_STRING_LEN + 1);
+    if (len > HPDF_LIMIT_MAX_STRING_LEN) {
+        HPDF_RaiseError (&pdf->error, HPDF_STRING_OUT_OF_RANGE, 0);
+        return NULL;
+    }
+
+    /* the units and a copy of the text follow the layout */
+    layout = HPDF_GetMem (pdf->mmgr, sizeof(HPDF_TextLayout_Rec) +
+            sizeof(HPDF_TextUnit) * (len + 1) + len + 1);
+    if (!layout) {
+        HPDF_CheckError (&pdf->error);
+        return NULL;
+    }
+
+    units = (HPDF_TextUnit *)(layout + 1);
+    buf = (char *)(units + len + 1);
+    HPDF_MemCpy ((HPDF_BYTE *)buf, (const HPDF_BYTE *)text, len);
+    buf[len] = 0;
+
+    HPDF_TextLayout_Init (layout, pdf->mmgr, buf, len, units);
+
+    if (!pdf->text_layouts) {
+        pdf->text_layouts = HPDF_List_New (pdf->mmgr,
+                HPDF_DEF_ITEMS_PER_BLOCK);
+        if (!pdf->text_layouts) {
+            HPDF_FreeMem (pdf->mmgr, layout);
+            HPDF_CheckError (&pdf->error);
+            return NULL;
+        }
+    }
+
+    if (HPDF_List_Add (pdf->text_layouts, layout) != HPDF_OK) {
+        HPDF_FreeMem (pdf->mmgr, layout);
+        HPDF_CheckError (&pdf->error);
+        return NULL;
+    }
+
+    layout->owner = pdf->text_layouts;
+
+    return layout;
+}
+
+
 HPDF_EXPORT(HPDF_STATUS)
 HPDF_SetCompressionMode  (HPDF_Doc    pdf,
                           HPDF_UINT   mode)
@@ -2599,6 +3065,21 @@ HPDF_SetTextPlacementAccuracy (HPDF_Doc  pdf,
     return HPDF_OK;
 }
 
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_SetOptimizationMode (HPDF_Doc  pdf,
+                          HPDF_UINT mode)
+{
+    if (!HPDF_HasDoc (pdf))
+        return HPDF_INVALID_DOCUMENT;
+
+    if (mode != (mode & HPDF_OPTIMIZE_MASK))
+        return HPDF_RaiseError (&pdf->error, HPDF_INVALID_PARAMETER, 0);
+
+    pdf->optimization_mode = mode;
+
+    return HPDF_OK;
+}
+
 HPDF_EXPORT(HPDF_STATUS)
 HPDF_SetWriteFontWidths (HPDF_Doc  pdf,
                          HPDF_BOOL write_font_widths)
@@ -19,6 +19,7 @@
 #include "hpdf_utils.h"
 #include "hpdf_encoder.h"
 #include "hpdf.h"
+#include "hpdf_lock.h"
 
 typedef struct _HPDF_UnicodeGryphPair {
     HPDF_UNICODE     unicode;
@@ -5501,6 +5502,68 @@ HPDF_Encoder_ToUnicode  (HPDF_Encoder     encoder,
 }
 
 
+HPDF_UINT32
+HPDF_Encoder_ToUcs4  (HPDF_Encoder     encoder,
+                      HPDF_Ucs4Map     map,
+                      HPDF_UNICODE     unicode)
+{
+    if (encoder->to_ucs4_fn)
+        return encoder->to_ucs4_fn (encoder, map, unicode);
+
+    return unicode;
+}
+
+
+HPDF_UINT
+HPDF_Encoder_DecodeText  (HPDF_Encoder        encoder,
+                          HPDF_Ucs4Map        map,
+                          const HPDF_BYTE    *text,
+                          HPDF_UINT           len,
+                          HPDF_UNICODE       *unicodes,
+                          HPDF_UINT          *offsets,
+                          HPDF_UINT           max_chars,
+                          HPDF_UINT          *num_chars)
+{
+    HPDF_ParseText_Rec parse_state;
+    HPDF_UINT n = 0;
+    HPDF_UINT i;
+
+    HPDF_PTRACE ((" HPDF_Encoder_DecodeText\n"));
+
+    if (encoder->decode_text_fn)
+        return encoder->decode_text_fn (encoder, map, text, len, unicodes,
+                offsets, max_chars, num_chars);
+
+    /* the generic way, byte by byte */
+    HPDF_Encoder_SetParseText (encoder, &parse_state, text, len);
+
+    for (i = 0; i < len; i++) {
+        HPDF_ByteType btype = HPDF_Encoder_ByteType (encoder, &parse_state);
+        HPDF_UINT16 code = text[i];
+
+        if (btype == HPDF_BYTE_TYPE_TRIAL)
+            continue;
+
+        if (n == max_chars)
+            break;
+
+        if (btype == HPDF_BYTE_TYPE_LEAD && i + 1 < len)
+            code = (HPDF_UINT16)((code << 8) + text[i + 1]);
+        else if (btype == HPDF_BYTE_TYPE_LEAD)
+            code <<= 8;
+
+        unicodes[n] = HPDF_Encoder_ToUnicode (encoder, code);
+        if (offsets)
+            offsets[n] = i;
+        n++;
+    }
+
+    *num_chars = n;
+
+    return i;
+}
+
+
 void
 HPDF_BasicEncoder_CopyMap  (HPDF_Encoder        encoder,
                             const HPDF_UNICODE  *map)
@@ -5562,6 +5625,97 @@ HPDF_Encoder_Free  (HPDF_Encoder  encoder)
 }
 
 
+/*----- HPDF_Ucs4Map --------------------------------------------------------*/
+
+/* twice as many slots as codes keep the chains of the hash table short */
+#define HPDF_UCS4_MAP_SLOTS  (HPDF_UCS4_MAP_SIZE * 2)
+
+#define HPDF_UCS4_MAP_HASH(ucs4) \
+    ((HPDF_UINT)(((ucs4) * 2654435761U) >> 20) & (HPDF_UCS4_MAP_SLOTS - 1))
+
+void
+HPDF_Ucs4Map_Init  (HPDF_Ucs4Map   map,
+                    HPDF_MMgr      mmgr)
+{
+    HPDF_MemSet (map, 0, sizeof(HPDF_Ucs4Map_Rec));
+    map->mmgr = mmgr;
+}
+
+
+void
+HPDF_Ucs4Map_Free  (HPDF_Ucs4Map   map)
+{
+    if (map->ucs4)
+        HPDF_FreeMem (map->mmgr, map->ucs4);
+
+    map->ucs4 = NULL;
+    map->slots = NULL;
+    map->count = 0;
+}
+
+
+HPDF_UNICODE
+HPDF_Ucs4Map_GetCode  (HPDF_Ucs4Map   map,
+                       HPDF_UINT32    ucs4)
+{
+    HPDF_UINT slot;
+
+    if (ucs4 > 0x10FFFF)
+        return 32;
+
+    if (!map->ucs4) {
+        /* the slots follow the code points */
+        map->ucs4 = HPDF_GetMem (map->mmgr,
+                sizeof(HPDF_UINT32) * HPDF_UCS4_MAP_SIZE +
+                sizeof(HPDF_UINT16) * HPDF_UCS4_MAP_SLOTS);
+        if (!map->ucs4) {
+            HPDF_CheckError (map->mmgr->error);
+            return 32;
+        }
+
+        map->slots = (HPDF_UINT16 *)(map->ucs4 + HPDF_UCS4_MAP_SIZE);
+        HPDF_MemSet (map->slots, 0,
+                sizeof(HPDF_UINT16) * HPDF_UCS4_MAP_SLOTS);
+    }
+
+    slot = HPDF_UCS4_MAP_HASH (ucs4);
+    while (map->slots[slot]) {
+        HPDF_UINT i = map->slots[slot] - 1;
+
+        if (map->ucs4[i] == ucs4)
+            return (HPDF_UNICODE)(HPDF_SUPPLEMENTARY_CODE_FIRST + i);
+
+        slot = (slot + 1) & (HPDF_UCS4_MAP_SLOTS - 1);
+    }
+
+    if (map->count == HPDF_UCS4_MAP_SIZE) {
+        /* raised once for the characters of a text, not for each of them */
+        if (HPDF_Error_GetCode (map->mmgr->error) !=
+                HPDF_TOO_MANY_SUPPLEMENTARY_CHARS)
+            HPDF_RaiseError (map->mmgr->error,
+                    HPDF_TOO_MANY_SUPPLEMENTARY_CHARS, 0);
+        return 32;
+    }
+
+    map->ucs4[map->count] = ucs4;
+    map->slots[slot] = (HPDF_UINT16)(map->count + 1);
+
+    return (HPDF_UNICODE)(HPDF_SUPPLEMENTARY_CODE_FIRST + map->count++);
+}
+
+
+HPDF_UINT32
+HPDF_Ucs4Map_GetUcs4  (HPDF_Ucs4Map   map,
+                       HPDF_UNICODE   code)
+{
+    if (map && code >= HPDF_SUPPLEMENTARY_CODE_FIRST &&
+            code < HPDF_SUPPLEMENTARY_CODE_FIRST + map->count)
+        return map->ucs4[code - HPDF_SUPPLEMENTARY_CODE_FIRST];
+
+    return code;
+}
+
+
 const char*
 HPDF_UnicodeToGryphName  (HPDF_UNICODE  unicode)
 {
@@ -5739,10 +5893,109 @@ HPDF_CMapEncoder_New  (HPDF_MMgr                mmgr,
 }
 
 
+/*----- shared tables of CMap encoders --------------------------------------*/
+
+static HPDF_CMapTables shared_tables = NULL;
+
+/* the lock guards the list of shared tables and their reference counts */
+static HPDF_Lock tables_lock = HPDF_LOCK_INIT;
+#define HPDF_TABLES_LOCK()    HPDF_Lock_Acquire (&tables_lock)
+#define HPDF_TABLES_UNLOCK()  HPDF_Lock_Release (&tables_lock)
+
+
+/* returns the shared tables of the name with a new reference, or NULL.
+ * the caller holds the lock. */
+static HPDF_CMapTables
+FindSharedTables  (const char  *name)
+{
+    HPDF_CMapTables tables = shared_tables;
+
+    while (tables) {
+        if (HPDF_StrCmp (tables->name, name) == 0) {
+            tables->ref_count++;
+            return tables;
+        }
+
+        tables = tables->next;
+    }
+
+    return NULL;
+}
+
+
+static void
+SetTables  (HPDF_CMapEncoderAttr  attr,
+            HPDF_CMapTables       tables,
+            HPDF_BOOL             shared)
+{
+    attr->tables = tables;
+    attr->tables_shared = shared;
+    attr->unicode_map = (const HPDF_UNICODE (*)[256])tables->unicode_map;
+    attr->cid_map = (const HPDF_UINT16 (*)[256])tables->cid_map;
+}
+
+
+void
+HPDF_CMapEncoder_ShareTables  (HPDF_Encoder  encoder)
+{
+    HPDF_CMapEncoderAttr attr = (HPDF_CMapEncoderAttr)encoder->attr;
+    HPDF_CMapTables tables;
+
+    HPDF_PTRACE ((" HPDF_CMapEncoder_ShareTables\n"));
+
+    if (!attr || !attr->tables || attr->tables_shared)
+        return;
+
+    HPDF_TABLES_LOCK ();
+
+    /* another document may have shared the tables since this encoder
+     * was initialized */
+    tables = FindSharedTables (encoder->name);
+    if (!tables) {
+        tables = attr->tables;
+        tables->ref_count = 1;
+        tables->next = shared_tables;
+        shared_tables = tables;
+    }
+
+    HPDF_TABLES_UNLOCK ();
+
+    if (tables != attr->tables)
+        HPDF_FREE (attr->tables);
+
+    SetTables (attr, tables, HPDF_TRUE);
+}
+
+
+void
+HPDF_CMapEncoder_FreeTables  (void)
+{
+    HPDF_CMapTables *ptables;
+
+    HPDF_PTRACE ((" HPDF_CMapEncoder_FreeTables\n"));
+
+    HPDF_TABLES_LOCK ();
+
+    ptables = &shared_tables;
+    while (*ptables) {
+        HPDF_CMapTables tables = *ptables;
+
+        if (tables->ref_count == 0) {
+            *ptables = tables->next;
+            HPDF_FREE (tables);
+        } else
+            ptables = &tables->next;
+    }
+
+    HPDF_TABLES_UNLOCK ();
+}
+
+
 HPDF_STATUS
 HPDF_CMapEncoder_InitAttr  (HPDF_Encoder  encoder)
 {
     HPDF_CMapEncoderAttr encoder_attr;
+    HPDF_CMapTables tables;
     HPDF_UINT i;
     HPDF_UINT j;
 
@@ -5762,11 +6015,33 @@ HPDF_CMapEncoder_InitAttr  (HPDF_Encoder  encoder)
 
     encoder_attr->writing_mode = HPDF_WMODE_HORIZONTAL;
 
-    for (i = 0; i <= 255; i++) {
-        for (j = 0; j <= 255; j++) {
-            /* undefined charactors are replaced to square */
-            encoder_attr->unicode_map[i][j] = 0x25A1;
+    HPDF_TABLES_LOCK ();
+    tables = FindSharedTables (encoder->name);
+    HPDF_TABLES_UNLOCK ();
+
+    if (tables) {
+        SetTables (encoder_attr, tables, HPDF_TRUE);
+    } else {
+        /* the first encoder of the name builds the tables, which are
+         * shared once it is initialized */
+        tables = HPDF_MALLOC (sizeof(HPDF_CMapTables_Rec));
+        if (!tables)
+            return HPDF_SetError (encoder->error, HPDF_FAILD_TO_ALLOC_MEM, 0);
+
+        tables->next = NULL;
+        tables->ref_count = 0;
+        HPDF_StrCpy (tables->name, encoder->name,
+                tables->name + HPDF_LIMIT_MAX_NAME_LEN);
+        HPDF_MemSet (tables->cid_map, 0, sizeof(tables->cid_map));
+
+        for (i = 0; i <= 255; i++) {
+            for (j = 0; j <= 255; j++) {
+                /* undefined charactors are replaced to square */
+                tables->unicode_map[i][j] = 0x25A1;
+            }
         }
+
+        SetTables (encoder_attr, tables, HPDF_FALSE);
     }
 
     /* create cmap range */
@@ -5854,6 +6129,16 @@ HPDF_CMapEncoder_Free  (HPDF_Encoder  encoder)
         HPDF_List_Free (attr->code_space_range);
     }
 
+    if (attr && attr->tables) {
+        if (attr->tables_shared) {
+            /* shared tables stay until HPDF_CMapEncoder_FreeTables */
+            HPDF_TABLES_LOCK ();
+            attr->tables->ref_count--;
+            HPDF_TABLES_UNLOCK ();
+        } else
+            HPDF_FREE (attr->tables);
+    }
+
     HPDF_FreeMem (encoder->mmgr, encoder->attr);
     encoder->attr = NULL;
 }
@@ -5884,6 +6169,8 @@ HPDF_Encoder_SetParseText  (HPDF_Encoder        encoder,
     state->index = 0;
     state->len = len;
     state->byte_type = HPDF_BYTE_TYPE_SINGLE;
+    state->current_byte = 0;
+    state->end_byte = 0;
 }
 
 
@@ -5943,9 +6230,11 @@ HPDF_CMapEncoder_AddCMap  (HPDF_Encoder             encoder,
 	HPDF_STATUS ret;
 
 	/*
-	 * Only if we have the default to_unicode_fn
+	 * Only if we have the default to_unicode_fn, and the tables are
+	 * not shared, in which case they have been filled already
 	 */
-	if (encoder->to_unicode_fn == HPDF_CMapEncoder_ToUnicode) {
+	if (encoder->to_unicode_fn == HPDF_CMapEncoder_ToUnicode &&
+		!attr->tables_shared) {
 	    HPDF_UINT16 code = range->from;
 	    HPDF_UINT16 cid = range->cid;
 
@@ -5953,7 +6242,7 @@ HPDF_CMapEncoder_AddCMap  (HPDF_Encoder             encoder,
 		HPDF_BYTE l = code;
 		HPDF_BYTE h = code >> 8;
 
-		attr->cid_map[l][h] = cid;
+		attr->tables->cid_map[l][h] = cid;
 		code++;
 		cid++;
 	    }
@@ -6037,11 +6326,11 @@ HPDF_CMapEncoder_SetUnicodeArray  (HPDF_Encoder                 encoder,
 
     HPDF_PTRACE ((" HPDF_CMapEncoder_SetUnicodeArray\n"));
 
-    if (array != NULL)
+    if (array != NULL && !attr->tables_shared)
         while (array->unicode != 0xffff) {
             HPDF_BYTE l = (HPDF_BYTE)array->code;
             HPDF_BYTE h = (HPDF_BYTE)(array->code >> 8);
-            attr->unicode_map[l][h] = array->unicode;
+            attr->tables->unicode_map[l][h] = array->unicode;
             array++;
         }
 }
@@ -36322,45 +36322,29 @@ GB_EUC_V_Init  (HPDF_Encoder  encoder)
 
 /*--------------------------------------------------------------------------*/
 
-HPDF_EXPORT(HPDF_STATUS)
-HPDF_UseCNSEncodings   (HPDF_Doc   pdf)
-{
-    HPDF_Encoder encoder;
-    HPDF_STATUS ret;
-
-    if (!HPDF_HasDoc (pdf))
-        return HPDF_INVALID_DOCUMENT;
-
+static const HPDF_CMapEncoderEntry_Rec CNS_ENCODERS[] = {
     /* Microsoft Code Page 936 (lfCharSet 0x86) GBK encoding */
-    encoder = HPDF_CMapEncoder_New (pdf->mmgr,  "GBK-EUC-H",
-                GBK_EUC_H_Init);
-
-    if ((ret = HPDF_Doc_RegisterEncoder (pdf, encoder)) != HPDF_OK)
-        return ret;
+    {"GBK-EUC-H", GBK_EUC_H_Init},
 
     /* Microsoft Code Page 936 (lfCharSet 0x86) GBK encoding
      * (vertical writing) */
-    encoder = HPDF_CMapEncoder_New (pdf->mmgr,  "GBK-EUC-V",
-                GBK_EUC_V_Init);
-
-    if ((ret = HPDF_Doc_RegisterEncoder (pdf, encoder)) != HPDF_OK)
-        return ret;
+    {"GBK-EUC-V", GBK_EUC_V_Init},
 
     /* EUC-CN encoding */
-    encoder = HPDF_CMapEncoder_New (pdf->mmgr,  "GB-EUC-H",
-                GB_EUC_H_Init);
-
-    if ((ret = HPDF_Doc_RegisterEncoder (pdf, encoder)) != HPDF_OK)
-        return ret;
+    {"GB-EUC-H",  GB_EUC_H_Init},
 
     /* EUC-CN encoding (vertical writing) */
-    encoder = HPDF_CMapEncoder_New (pdf->mmgr,  "GB-EUC-V",
-                GB_EUC_V_Init);
+    {"GB-EUC-V",  GB_EUC_V_Init},
+    {NULL, NULL}
+};
 
-    if ((ret = HPDF_Doc_RegisterEncoder (pdf, encoder)) != HPDF_OK)
-        return ret;
 
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_UseCNSEncodings   (HPDF_Doc   pdf)
+{
+    if (!HPDF_HasDoc (pdf))
+        return HPDF_INVALID_DOCUMENT;
 
-    return HPDF_OK;
+    return HPDF_Doc_RegisterCMapEncoders (pdf, CNS_ENCODERS);
 }
 
@@ -15281,32 +15281,25 @@ ETen_B5_V_Init  (HPDF_Encoder  encoder)
 
 /*--------------------------------------------------------------------------*/
 
-HPDF_EXPORT(HPDF_STATUS)
-HPDF_UseCNTEncodings   (HPDF_Doc   pdf)
-{
-    HPDF_Encoder encoder;
-    HPDF_STATUS ret;
-
-    if (!HPDF_HasDoc (pdf))
-        return HPDF_INVALID_DOCUMENT;
-
+static const HPDF_CMapEncoderEntry_Rec CNT_ENCODERS[] = {
     /* Microsoft Code Page 950 (lfCharSet 0x88) Big Five character set with
      * ETen extensions
      */
-    encoder = HPDF_CMapEncoder_New (pdf->mmgr,  "ETen-B5-H",
-                ETen_B5_H_Init);
-
-    if ((ret = HPDF_Doc_RegisterEncoder (pdf, encoder)) != HPDF_OK)
-        return ret;
+    {"ETen-B5-H", ETen_B5_H_Init},
 
     /* Microsoft Code Page 950 (lfCharSet 0x88) Big Five character set with
      * ETen extensions (vertical writing) */
-    encoder = HPDF_CMapEncoder_New (pdf->mmgr,  "ETen-B5-V",
-                ETen_B5_V_Init);
+    {"ETen-B5-V", ETen_B5_V_Init},
+    {NULL, NULL}
+};
 
-    if ((ret = HPDF_Doc_RegisterEncoder (pdf, encoder)) != HPDF_OK)
-        return ret;
 
-    return HPDF_OK;
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_UseCNTEncodings   (HPDF_Doc   pdf)
+{
+    if (!HPDF_HasDoc (pdf))
+        return HPDF_INVALID_DOCUMENT;
+
+    return HPDF_Doc_RegisterCMapEncoders (pdf, CNT_ENCODERS);
 }
 
@@ -16082,51 +16082,31 @@ EUC_V_Init  (HPDF_Encoder  encoder)
 
 /*--------------------------------------------------------------------------*/
 
-HPDF_EXPORT(HPDF_STATUS)
-HPDF_UseJPEncodings   (HPDF_Doc   pdf)
-{
-    HPDF_Encoder encoder;
-    HPDF_STATUS ret;
-
-    if (!HPDF_Doc_Validate (pdf))
-        return HPDF_INVALID_DOCUMENT;
-
+static const HPDF_CMapEncoderEntry_Rec JP_ENCODERS[] = {
     /* Microsoft Code Page 932, JIS X 0208 character */
-    encoder = HPDF_CMapEncoder_New (pdf->mmgr,  "90ms-RKSJ-H",
-                MS_RKSJ_H_Init);
-
-    if ((ret = HPDF_Doc_RegisterEncoder (pdf, encoder)) != HPDF_OK)
-        return ret;
+    {"90ms-RKSJ-H",  MS_RKSJ_H_Init},
 
     /* Microsoft Code Page 932, JIS X 0208 character (vertical writing) */
-    encoder = HPDF_CMapEncoder_New (pdf->mmgr,  "90ms-RKSJ-V",
-                MS_RKSJ_V_Init);
-
-    if ((ret = HPDF_Doc_RegisterEncoder (pdf, encoder)) != HPDF_OK)
-        return ret;
+    {"90ms-RKSJ-V",  MS_RKSJ_V_Init},
 
     /* Microsoft Code Page 932, JIS X 0208 character (proportional) */
-    encoder = HPDF_CMapEncoder_New (pdf->mmgr,  "90msp-RKSJ-H",
-                MSP_RKSJ_H_Init);
-
-    if ((ret = HPDF_Doc_RegisterEncoder (pdf, encoder)) != HPDF_OK)
-        return ret;
+    {"90msp-RKSJ-H", MSP_RKSJ_H_Init},
 
     /* JIS X 0208 character set, EUC-JP encoding */
-    encoder = HPDF_CMapEncoder_New (pdf->mmgr,  "EUC-H",
-                EUC_H_Init);
-
-    if ((ret = HPDF_Doc_RegisterEncoder (pdf, encoder)) != HPDF_OK)
-        return ret;
+    {"EUC-H",        EUC_H_Init},
 
     /* JIS X 0208 character set, EUC-JP encoding (vertical writing) */
-    encoder = HPDF_CMapEncoder_New (pdf->mmgr,  "EUC-V",
-                EUC_V_Init);
+    {"EUC-V",        EUC_V_Init},
+    {NULL, NULL}
+};
 
-    if ((ret = HPDF_Doc_RegisterEncoder (pdf, encoder)) != HPDF_OK)
-        return ret;
 
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_UseJPEncodings   (HPDF_Doc   pdf)
+{
+    if (!HPDF_Doc_Validate (pdf))
+        return HPDF_INVALID_DOCUMENT;
 
-    return HPDF_OK;
+    return HPDF_Doc_RegisterCMapEncoders (pdf, JP_ENCODERS);
 }
 
@@ -27929,57 +27929,37 @@ KSC_EUC_V_Init  (HPDF_Encoder  encoder)
 
 /*--------------------------------------------------------------------------*/
 
-HPDF_EXPORT(HPDF_STATUS)
-HPDF_UseKREncodings   (HPDF_Doc   pdf)
-{
-    HPDF_Encoder encoder;
-    HPDF_STATUS ret;
-
-    if (!HPDF_HasDoc (pdf))
-        return HPDF_INVALID_DOCUMENT;
-
+static const HPDF_CMapEncoderEntry_Rec KR_ENCODERS[] = {
     /* Microsoft Code Page 949 (lfCharSet 0x81), KS X 1001:1992 character
      * set plus 8822 additional hangul, Unified Hangul Code (UHC) encoding
      * (proportional)
      */
-    encoder = HPDF_CMapEncoder_New (pdf->mmgr,  "KSCms-UHC-H",
-                KSCms_UHC_H_Init);
-
-    if ((ret = HPDF_Doc_RegisterEncoder (pdf, encoder)) != HPDF_OK)
-        return ret;
+    {"KSCms-UHC-H",    KSCms_UHC_H_Init},
 
     /* Microsoft Code Page 949 (lfCharSet 0x81), KS X 1001:1992 character
      * set plus 8822 additional hangul, Unified Hangul Code (UHC) encoding
      * (fixed width)
      */
-    encoder = HPDF_CMapEncoder_New (pdf->mmgr,  "KSCms-UHC-HW-H",
-                KSCms_UHC_HW_H_Init);
-
-    if ((ret = HPDF_Doc_RegisterEncoder (pdf, encoder)) != HPDF_OK)
-        return ret;
+    {"KSCms-UHC-HW-H", KSCms_UHC_HW_H_Init},
 
     /* vertical writing virsion of KSCms-UHC-HW-H */
-    encoder = HPDF_CMapEncoder_New (pdf->mmgr,  "KSCms-UHC-HW-V",
-                KSCms_UHC_HW_V_Init);
-
-    if ((ret = HPDF_Doc_RegisterEncoder (pdf, encoder)) != HPDF_OK)
-        return ret;
+    {"KSCms-UHC-HW-V", KSCms_UHC_HW_V_Init},
 
     /*  KS X 1001:1992 character set, EUC-KR encoding */
-    encoder = HPDF_CMapEncoder_New (pdf->mmgr,  "KSC-EUC-H",
-                KSC_EUC_H_Init);
-
-    if ((ret = HPDF_Doc_RegisterEncoder (pdf, encoder)) != HPDF_OK)
-        return ret;
+    {"KSC-EUC-H",      KSC_EUC_H_Init},
 
     /* KS X 1001:1992 character set, EUC-KR encoding (vertical writing)*/
-    encoder = HPDF_CMapEncoder_New (pdf->mmgr,  "KSC-EUC-V",
-                KSC_EUC_V_Init);
+    {"KSC-EUC-V",      KSC_EUC_V_Init},
+    {NULL, NULL}
+};
 
-    if ((ret = HPDF_Doc_RegisterEncoder (pdf, encoder)) != HPDF_OK)
-        return ret;
 
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_UseKREncodings   (HPDF_Doc   pdf)
+{
+    if (!HPDF_HasDoc (pdf))
+        return HPDF_INVALID_DOCUMENT;
 
-    return HPDF_OK;
+    return HPDF_Doc_RegisterCMapEncoders (pdf, KR_ENCODERS);
 }
 
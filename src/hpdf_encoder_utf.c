@@ -22,12 +22,11 @@
 #include "hpdf_encoder.h"
 #include "hpdf.h"
 
-typedef struct _UTF8_EncoderAttr_Rec  *UTF8_EncoderAttr;
-typedef struct  _UTF8_EncoderAttr_Rec {
-      HPDF_BYTE           current_byte;
-      HPDF_BYTE           end_byte;
-      HPDF_BYTE           utf8_bytes[8];
-} UTF8_EncoderAttr_Rec;
+#if defined(HPDF_HAVE_SSE2)
+#include <emmintrin.h>
+#elif defined(HPDF_HAVE_NEON)
+#include <arm_neon.h>
+#endif
 
 static const HPDF_CidRange_Rec UTF8_NOTDEF_RANGE = {0x0000, 0x001F, 1};
 static const HPDF_CidRange_Rec UTF8_SPACE_RANGE =  {0x0000, 0xFFFF, 0};
@@ -44,10 +43,28 @@ static HPDF_UNICODE
 UTF8_Encoder_ToUnicode_Func  (HPDF_Encoder   encoder,
                               HPDF_UINT16    code);
 
-static char *
+static HPDF_UINT32
+UTF8_Encoder_ToUcs4_Func  (HPDF_Encoder   encoder,
+                           HPDF_Ucs4Map   map,
+                           HPDF_UNICODE   unicode);
+
+static HPDF_UINT
+UTF8_Encoder_DecodeText_Func  (HPDF_Encoder        encoder,
+                               HPDF_Ucs4Map        map,
+                               const HPDF_BYTE    *text,
+                               HPDF_UINT           len,
+                               HPDF_UNICODE       *unicodes,
+                               HPDF_UINT          *offsets,
+                               HPDF_UINT           max_chars,
+                               HPDF_UINT          *num_chars);
+
+static HPDF_UINT
 UTF8_Encoder_EncodeText_Func  (HPDF_Encoder        encoder,
+			       HPDF_Ucs4Map        map,
 			       const char         *text,
 			       HPDF_UINT           len,
+			       HPDF_BYTE          *buf,
+			       HPDF_UINT           buf_len,
 			       HPDF_UINT          *length);
 
 static HPDF_STATUS
@@ -68,140 +85,243 @@ UTF8_Encoder_ByteType_Func  (HPDF_Encoder        encoder,
     // Not logical ! (look at function HPDF_String_Write in hpdf_string.c)
 
     // When HPDF_BYTE_TYPE_SINGLE is returned, the current byte is the
-    //   CODE argument in call ToUnicode_Func
-    // When HPDF_BYTE_TYPE_LEAD is returned, the current byte (msb) and the
-    //   next byte (lsb) is the CODE arguement in call ToUnicodeFunc
+    //   last one of a character
     // When HPDF_BYTE_TYPE_TRIAL is returned, the current byte is ignored
+    // The unicode values of the characters are given by DecodeText_Func
 
-    HPDF_CMapEncoderAttr  encoder_attr;
     HPDF_BYTE             byte;
-    UTF8_EncoderAttr      utf8_attr;
 
-    encoder_attr = (HPDF_CMapEncoderAttr) encoder->attr;
-    utf8_attr = (UTF8_EncoderAttr) ((void *)encoder_attr->cid_map[0]);
-
-    if (state->index == 0) {
-	//First byte, initialize.
-	HPDF_PTRACE ((" UTF8_Encoder_ByteType_Func - Initialize: (%u) %s\n",
-		      state->len, state->text));
-
-	utf8_attr->current_byte = 0;
-    }
+    HPDF_UNUSED (encoder);
 
     byte = state->text[state->index];
     state->index++;
 
     HPDF_PTRACE ((" UTF8_Encoder_ByteType_Func - Byte: %hx\n", byte));
 
-    if (utf8_attr->current_byte == 0) {
-	utf8_attr->utf8_bytes[0] = byte;
-	utf8_attr->current_byte = 1;
+    if (state->current_byte == 0) {
+	state->current_byte = 1;
 
 	if (!(byte & 0x80)) {
-	    utf8_attr->current_byte = 0;
-	    utf8_attr->end_byte = 0;
+	    state->current_byte = 0;
+	    state->end_byte = 0;
 	    return HPDF_BYTE_TYPE_SINGLE;
 	}
 
 	if ((byte & 0xf8) == 0xf0)
-	    utf8_attr->end_byte = 3;
+	    state->end_byte = 3;
 	else if ((byte & 0xf0) == 0xe0)
-	    utf8_attr->end_byte = 2;
+	    state->end_byte = 2;
 	else if ((byte & 0xe0) == 0xc0)
-	    utf8_attr->end_byte = 1;
+	    state->end_byte = 1;
 	else
-	    utf8_attr->current_byte = 0; //ERROR, skip this byte
+	    state->current_byte = 0; //ERROR, skip this byte
     } else {
-	utf8_attr->utf8_bytes[utf8_attr->current_byte] = byte;
-	if (utf8_attr->current_byte == utf8_attr->end_byte) {
-	    utf8_attr->current_byte = 0;
+	if (state->current_byte == state->end_byte) {
+	    state->current_byte = 0;
 	    return HPDF_BYTE_TYPE_SINGLE;
 	}
 
-	utf8_attr->current_byte++;
+	state->current_byte++;
     }
 
     return HPDF_BYTE_TYPE_TRIAL;
 }
 
-/*
- * This function is taken from hpdf_encoder_utf8.c, originally submitted
- * to libharu by 'Mirco'
- */
 static HPDF_UNICODE
 UTF8_Encoder_ToUnicode_Func  (HPDF_Encoder   encoder,
                               HPDF_UINT16    code)
 {
-    // Supposed to convert CODE to unicode.
-    // This function is allways called after ByteType_Func.
-    // ByteType_Func recognizes the utf-8 bytes belonging to one character.
-
-    HPDF_CMapEncoderAttr encoder_attr;
-    UTF8_EncoderAttr     utf8_attr;
-    unsigned int         val;
-
-    encoder_attr = (HPDF_CMapEncoderAttr) encoder->attr;
-    utf8_attr = (UTF8_EncoderAttr) ((void *)encoder_attr->cid_map[0]);
-
-    switch (utf8_attr->end_byte) {
-    case 3:
-	val = (unsigned int) ((utf8_attr->utf8_bytes[0] & 0x7) << 18) +
-	    (unsigned int) ((utf8_attr->utf8_bytes[1]) << 12)       +
-	    (unsigned int) ((utf8_attr->utf8_bytes[2] & 0x3f) << 6) +
-	    (unsigned int) ((utf8_attr->utf8_bytes[3] & 0x3f));
-	break;
-    case 2:
-	val = (unsigned int) ((utf8_attr->utf8_bytes[0] & 0xf) << 12) +
-	    (unsigned int) ((utf8_attr->utf8_bytes[1] & 0x3f) << 6) +
-	    (unsigned int) ((utf8_attr->utf8_bytes[2] & 0x3f));
-	break;
-    case 1:
-	val = (unsigned int) ((utf8_attr->utf8_bytes[0] & 0x1f) << 6) +
-	    (unsigned int) ((utf8_attr->utf8_bytes[1] & 0x3f));
-	break;
-    case 0:
-	val = (unsigned int)  utf8_attr->utf8_bytes[0];
-	break;
-    default:
-	val = 32; // Unknown character
+    // The codes of the UTF-8 encoder are the UCS-2 values of the
+    // characters written to the content stream. Codes from the surrogate
+    // range stand for supplementary characters only in the font which gave
+    // them, HPDF_Encoder_ToUcs4 maps them back with the map of the font.
+
+    HPDF_UNUSED (encoder);
+
+    if (code >= HPDF_SUPPLEMENTARY_CODE_FIRST &&
+            code <= HPDF_SUPPLEMENTARY_CODE_LAST)
+        return 32;
+
+    return code;
+}
+
+static HPDF_UINT32
+UTF8_Encoder_ToUcs4_Func  (HPDF_Encoder   encoder,
+                           HPDF_Ucs4Map   map,
+                           HPDF_UNICODE   unicode)
+{
+    HPDF_UNUSED (encoder);
+
+    return HPDF_Ucs4Map_GetUcs4 (map, unicode);
+}
+
+/*
+ * Decodes a whole string with the same rules as ByteType_Func and
+ * ToUnicode_Func, without going through them for every byte. Runs of
+ * ASCII characters are widened 16 bytes at a time where SSE2 or NEON is
+ * available. Only map is changed, the encoder is left as it is.
+ */
+static HPDF_UINT
+UTF8_Encoder_DecodeText_Func  (HPDF_Encoder        encoder,
+                               HPDF_Ucs4Map        map,
+                               const HPDF_BYTE    *text,
+                               HPDF_UINT           len,
+                               HPDF_UNICODE       *unicodes,
+                               HPDF_UINT          *offsets,
+                               HPDF_UINT           max_chars,
+                               HPDF_UINT          *num_chars)
+{
+    HPDF_UINT i = 0;
+    HPDF_UINT n = 0;
+
+    HPDF_UNUSED (encoder);
+
+    while (i < len && n < max_chars) {
+        HPDF_BYTE byte;
+        HPDF_UINT end_byte;
+        HPDF_UINT32 val;
+
+#if defined(HPDF_HAVE_SSE2) || defined(HPDF_HAVE_NEON)
+        while (len - i >= 16 && max_chars - n >= 16) {
+#if defined(HPDF_HAVE_SSE2)
+            __m128i v = _mm_loadu_si128 ((const __m128i *)(text + i));
+            __m128i zero = _mm_setzero_si128 ();
+
+            if (_mm_movemask_epi8 (v))
+                break;
+
+            _mm_storeu_si128 ((__m128i *)(unicodes + n),
+                    _mm_unpacklo_epi8 (v, zero));
+            _mm_storeu_si128 ((__m128i *)(unicodes + n + 8),
+                    _mm_unpackhi_epi8 (v, zero));
+#else
+            uint8x16_t v = vld1q_u8 (text + i);
+
+            if (vmaxvq_u8 (v) & 0x80)
+                break;
+
+            vst1q_u16 (unicodes + n, vmovl_u8 (vget_low_u8 (v)));
+            vst1q_u16 (unicodes + n + 8, vmovl_u8 (vget_high_u8 (v)));
+#endif
+            if (offsets) {
+                HPDF_UINT j;
+
+                for (j = 0; j < 16; j++)
+                    offsets[n + j] = i + j;
+            }
+
+            i += 16;
+            n += 16;
+        }
+
+        if (i == len || n == max_chars)
+            break;
+#endif
+
+        byte = text[i];
+
+        if (!(byte & 0x80)) {
+            if (offsets)
+                offsets[n] = i;
+            unicodes[n++] = byte;
+            i++;
+            continue;
+        }
+
+        if ((byte & 0xf8) == 0xf0)
+            end_byte = 3;
+        else if ((byte & 0xf0) == 0xe0)
+            end_byte = 2;
+        else if ((byte & 0xe0) == 0xc0)
+            end_byte = 1;
+        else {
+            i++; //ERROR, skip this byte
+            continue;
+        }
+
+        if (len - i <= end_byte) {
+            i = len; //Incomplete character at the end
+            break;
+        }
+
+        switch (end_byte) {
+        case 3:
+            val = (HPDF_UINT32) ((byte & 0x7) << 18) +
+                (HPDF_UINT32) ((text[i + 1] & 0x3f) << 12) +
+                (HPDF_UINT32) ((text[i + 2] & 0x3f) << 6) +
+                (HPDF_UINT32) ((text[i + 3] & 0x3f));
+            break;
+        case 2:
+            val = (HPDF_UINT32) ((byte & 0xf) << 12) +
+                (HPDF_UINT32) ((text[i + 1] & 0x3f) << 6) +
+                (HPDF_UINT32) ((text[i + 2] & 0x3f));
+            break;
+        default:
+            val = (HPDF_UINT32) ((byte & 0x1f) << 6) +
+                (HPDF_UINT32) ((text[i + 1] & 0x3f));
+        }
+
+        if (val >= HPDF_SUPPLEMENTARY_CODE_FIRST &&
+                val <= HPDF_SUPPLEMENTARY_CODE_LAST) {
+            val = 32; //Lone surrogate
+        } else if (val > 0x10FFFF) {
+            val = 32; //Out of range
+        } else if (val > 0xFFFF && map) {
+            // Supplementary characters get a code from the surrogate range
+            // of the map, HPDF_Encoder_ToUcs4 maps it back to the character.
+            val = HPDF_Ucs4Map_GetCode (map, val);
+        } else if (val > 0xFFFF) {
+            // Without a map, the character is decoded to its surrogate pair
+            if (max_chars - n < 2)
+                break;
+
+            val -= 0x10000;
+            if (offsets)
+                offsets[n] = i;
+            unicodes[n++] = (HPDF_UNICODE)(0xD800 + (val >> 10));
+            val = 0xDC00 + (val & 0x3FF);
+        }
+
+        if (offsets)
+            offsets[n] = i;
+        unicodes[n++] = (HPDF_UNICODE)val;
+        i += end_byte + 1;
     }
 
-    if (val > 65535) //Convert everything outside UCS-2 to space
-        val = 32;
+    *num_chars = n;
 
-    return val;
+    return i;
 }
 
-static char *
+static HPDF_UINT
 UTF8_Encoder_EncodeText_Func  (HPDF_Encoder        encoder,
+			       HPDF_Ucs4Map        map,
 			       const char         *text,
 			       HPDF_UINT           len,
+			       HPDF_BYTE          *buf,
+			       HPDF_UINT           buf_len,
 			       HPDF_UINT          *length)
 {
-    char *result = malloc(len * 2);
-    char *c = result;
-    HPDF_ParseText_Rec  parse_state;
+    HPDF_UNICODE unicodes[HPDF_TEXT_DEFAULT_LEN];
+    HPDF_UINT max_chars = buf_len / 2;
+    HPDF_UINT num_chars;
     HPDF_UINT i;
+    HPDF_UINT j;
 
-    HPDF_Encoder_SetParseText (encoder, &parse_state,
-			       (const HPDF_BYTE *)text, len);
+    if (max_chars > HPDF_TEXT_DEFAULT_LEN)
+        max_chars = HPDF_TEXT_DEFAULT_LEN;
 
-    for (i = 0; i < len; i++) {
-	HPDF_UNICODE tmp_unicode;
-	HPDF_ByteType btype = HPDF_Encoder_ByteType (encoder, &parse_state);
+    i = UTF8_Encoder_DecodeText_Func (encoder, map, (const HPDF_BYTE *)text,
+            len, unicodes, NULL, max_chars, &num_chars);
 
-	if (btype != HPDF_BYTE_TYPE_TRIAL) {
-	    tmp_unicode = HPDF_Encoder_ToUnicode (encoder, 0);
-
-	    HPDF_UInt16Swap (&tmp_unicode);
-	    HPDF_MemCpy ((HPDF_BYTE *)c, (const HPDF_BYTE*)&tmp_unicode, 2);
-	    c += 2;
-        }
+    for (j = 0; j < num_chars; j++) {
+	*buf++ = (HPDF_BYTE)(unicodes[j] >> 8);
+	*buf++ = (HPDF_BYTE)unicodes[j];
     }
 
-    *length = c - result;
+    *length = num_chars * 2;
 
-    return result;
+    return i;
 }
 
 static HPDF_STATUS
@@ -219,6 +339,8 @@ UTF8_Init  (HPDF_Encoder  encoder)
     encoder->byte_type_fn = UTF8_Encoder_ByteType_Func;
     encoder->to_unicode_fn = UTF8_Encoder_ToUnicode_Func;
     encoder->encode_text_fn = UTF8_Encoder_EncodeText_Func;
+    encoder->to_ucs4_fn = UTF8_Encoder_ToUcs4_Func;
+    encoder->decode_text_fn = UTF8_Encoder_DecodeText_Func;
 
     attr = (HPDF_CMapEncoderAttr)encoder->attr;
 
@@ -257,20 +379,17 @@ UTF8_Init  (HPDF_Encoder  encoder)
 
 /*--------------------------------------------------------------------------*/
 
+static const HPDF_CMapEncoderEntry_Rec UTF_ENCODERS[] = {
+    {"UTF-8", UTF8_Init},
+    {NULL, NULL}
+};
+
+
 HPDF_EXPORT(HPDF_STATUS)
 HPDF_UseUTFEncodings   (HPDF_Doc   pdf)
 {
-    HPDF_Encoder encoder;
-    HPDF_STATUS ret;
-
     if (!HPDF_HasDoc (pdf))
         return HPDF_INVALID_DOCUMENT;
 
-    encoder = HPDF_CMapEncoder_New (pdf->mmgr,  "UTF-8",
-                UTF8_Init);
-
-    if ((ret = HPDF_Doc_RegisterEncoder (pdf, encoder)) != HPDF_OK)
-        return ret;
-
-    return HPDF_OK;
+    return HPDF_Doc_RegisterCMapEncoders (pdf, UTF_ENCODERS);
 }
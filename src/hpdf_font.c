@@ -19,6 +19,12 @@
 #include "hpdf_utils.h"
 #include "hpdf.h"
 
+#if defined(HPDF_HAVE_SSE2)
+#include <emmintrin.h>
+#elif defined(HPDF_HAVE_NEON)
+#include <arm_neon.h>
+#endif
+
 
 HPDF_EXPORT(HPDF_TextWidth)
 HPDF_Font_TextWidth  (HPDF_Font        font,
@@ -237,6 +243,28 @@ HPDF_Font_EmbedAllGlyphs  (HPDF_Font  font)
     return HPDF_OK;
 }
 
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_Font_UseCompactSubset  (HPDF_Font  font)
+{
+    HPDF_FontAttr attr;
+    HPDF_FontDef fontdef;
+
+    HPDF_PTRACE((" HPDF_Font_UseCompactSubset\n"));
+
+    if (!HPDF_Font_Validate(font)) {
+        return HPDF_INVALID_FONT;
+    }
+
+    attr = (HPDF_FontAttr)font->attr;
+    fontdef = attr->fontdef;
+
+    if (fontdef->type == HPDF_FONTDEF_TYPE_TRUETYPE) {
+        ((HPDF_TTFontDefAttr)fontdef->attr)->compact_subset = HPDF_TRUE;
+    }
+
+    return HPDF_OK;
+}
+
 HPDF_BOOL
 HPDF_Font_Validate  (HPDF_Font font)
 {
@@ -250,3 +278,332 @@ HPDF_Font_Validate  (HPDF_Font font)
 }
 
 
+
+
+/*
+ * The white space characters of 16 bytes at a time are counted in byte
+ * lanes where SSE2 or NEON is available, and added up every 255 blocks
+ * before the lanes overflow. The widths are looked up in four independent
+ * sums, as there is no gather of 16 bit values.
+ */
+HPDF_UINT
+HPDF_Font_SumWidths  (const HPDF_INT16  *widths,
+                      const HPDF_BYTE   *used,
+                      const HPDF_BYTE   *text,
+                      HPDF_UINT          len,
+                      HPDF_UINT         *numspace,
+                      HPDF_BOOL         *all_used)
+{
+    HPDF_BYTE u0 = 1;
+    HPDF_BYTE u1 = 1;
+    HPDF_UINT w0 = 0;
+    HPDF_UINT w1 = 0;
+    HPDF_UINT w2 = 0;
+    HPDF_UINT w3 = 0;
+    HPDF_UINT spaces = 0;
+    HPDF_UINT i = 0;
+
+#if defined(HPDF_HAVE_SSE2) || defined(HPDF_HAVE_NEON)
+    while (len - i >= 16) {
+        HPDF_UINT blocks = (len - i) / 16;
+#if defined(HPDF_HAVE_SSE2)
+        __m128i count = _mm_setzero_si128 ();
+#else
+        uint8x16_t count = vdupq_n_u8 (0);
+#endif
+
+        if (blocks > 255)
+            blocks = 255;
+
+        while (blocks--) {
+            const HPDF_BYTE *p = text + i;
+            HPDF_UINT j;
+#if defined(HPDF_HAVE_SSE2)
+            __m128i v = _mm_loadu_si128 ((const __m128i *)p);
+            __m128i ws = _mm_or_si128 (
+                    _mm_or_si128 (
+                        _mm_cmpeq_epi8 (v, _mm_setzero_si128 ()),
+                        _mm_cmpeq_epi8 (v, _mm_set1_epi8 (0x09))),
+                    _mm_or_si128 (
+                        _mm_cmpeq_epi8 (v, _mm_set1_epi8 (0x0A)),
+                        _mm_cmpeq_epi8 (v, _mm_set1_epi8 (0x0C))));
+
+            ws = _mm_or_si128 (ws, _mm_or_si128 (
+                        _mm_cmpeq_epi8 (v, _mm_set1_epi8 (0x0D)),
+                        _mm_cmpeq_epi8 (v, _mm_set1_epi8 (0x20))));
+
+            /* the lanes of matching bytes are -1 */
+            count = _mm_sub_epi8 (count, ws);
+#else
+            uint8x16_t v = vld1q_u8 (p);
+            uint8x16_t ws = vorrq_u8 (
+                    vorrq_u8 (vceqq_u8 (v, vdupq_n_u8 (0x00)),
+                              vceqq_u8 (v, vdupq_n_u8 (0x09))),
+                    vorrq_u8 (vceqq_u8 (v, vdupq_n_u8 (0x0A)),
+                              vceqq_u8 (v, vdupq_n_u8 (0x0C))));
+
+            ws = vorrq_u8 (ws, vorrq_u8 (vceqq_u8 (v, vdupq_n_u8 (0x0D)),
+                                         vceqq_u8 (v, vdupq_n_u8 (0x20))));
+
+            /* the lanes of matching bytes are 0xFF */
+            count = vsubq_u8 (count, ws);
+#endif
+
+            for (j = 0; j < 16; j += 4) {
+                w0 += widths[p[j]];
+                w1 += widths[p[j + 1]];
+                w2 += widths[p[j + 2]];
+                w3 += widths[p[j + 3]];
+            }
+
+            if (used)
+                for (j = 0; j < 16; j += 4) {
+                    u0 &= used[p[j]] & used[p[j + 1]];
+                    u1 &= used[p[j + 2]] & used[p[j + 3]];
+                }
+
+            i += 16;
+        }
+
+#if defined(HPDF_HAVE_SSE2)
+        count = _mm_sad_epu8 (count, _mm_setzero_si128 ());
+        spaces += (HPDF_UINT)_mm_cvtsi128_si32 (count) +
+                (HPDF_UINT)_mm_extract_epi16 (count, 4);
+#else
+        spaces += vaddlvq_u8 (count);
+#endif
+    }
+#endif
+
+    for (; i < len; i++) {
+        HPDF_BYTE b = text[i];
+
+        w0 += widths[b];
+        if (HPDF_IS_WHITE_SPACE(b))
+            spaces++;
+        if (used)
+            u0 &= used[b];
+    }
+
+    *numspace = spaces;
+    if (all_used)
+        *all_used = (u0 & u1) != 0;
+
+    return w0 + w1 + w2 + w3;
+}
+
+
+/*----------------------------------------------------------------------------*/
+/*----- HPDF_TextLayout ------------------------------------------------------*/
+
+void
+HPDF_TextLayout_Init  (HPDF_TextLayout   layout,
+                       HPDF_MMgr         mmgr,
+                       const char       *text,
+                       HPDF_UINT         len,
+                       HPDF_TextUnit    *units)
+{
+    HPDF_MemSet (layout, 0, sizeof(HPDF_TextLayout_Rec));
+
+    layout->mmgr = mmgr;
+    layout->error = mmgr->error;
+    layout->text = text;
+    layout->len = len;
+    layout->units = units;
+}
+
+
+HPDF_STATUS
+HPDF_TextLayout_Measure  (HPDF_TextLayout   layout,
+                          HPDF_Font         font)
+{
+    HPDF_FontAttr attr;
+
+    HPDF_PTRACE ((" HPDF_TextLayout_Measure\n"));
+
+    if (layout->font == font)
+        return HPDF_OK;
+
+    if (!HPDF_Font_Validate (font))
+        return HPDF_RaiseError (layout->error, HPDF_INVALID_FONT, 0);
+
+    attr = (HPDF_FontAttr)font->attr;
+
+    if (!attr->char_widths_fn)
+        return HPDF_RaiseError (layout->error, HPDF_INVALID_OBJECT, 0);
+
+    layout->font = NULL;
+    layout->num_units = attr->char_widths_fn (font,
+            (const HPDF_BYTE *)layout->text, layout->len, layout->units);
+
+    if (HPDF_Error_GetCode (layout->error) != HPDF_OK)
+        return HPDF_CheckError (layout->error);
+
+    layout->units[layout->num_units].offset = layout->len;
+    layout->units[layout->num_units].width = 0;
+    layout->units[layout->num_units].flags = 0;
+    layout->font = font;
+
+    return HPDF_OK;
+}
+
+
+HPDF_UINT
+HPDF_TextLayout_FindUnit  (HPDF_TextLayout   layout,
+                           HPDF_UINT         offset)
+{
+    HPDF_UINT low = 0;
+    HPDF_UINT high = layout->num_units;
+
+    while (low < high) {
+        HPDF_UINT mid = low + (high - low) / 2;
+
+        if (layout->units[mid].offset < offset)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return low;
+}
+
+
+/* the arithmetic follows the measure_text_fn of each type of font, so that
+ * the lines break at exactly the same characters. the widths of Type1 fonts
+ * and Type0 fonts are summed in single precision, which is emulated by
+ * rounding the sum after each step.
+ */
+HPDF_UINT
+HPDF_TextLayout_MeasureLine  (HPDF_TextLayout   layout,
+                              HPDF_UINT         first,
+                              HPDF_REAL         width,
+                              HPDF_REAL         font_size,
+                              HPDF_REAL         char_space,
+                              HPDF_REAL         word_space,
+                              HPDF_BOOL         wordwrap,
+                              HPDF_REAL        *real_width)
+{
+    HPDF_FontAttr attr = (HPDF_FontAttr)layout->font->attr;
+    const HPDF_BYTE *text = (const HPDF_BYTE *)layout->text;
+    HPDF_UINT start = layout->units[first].offset;
+    HPDF_BOOL single_byte = (attr->type == HPDF_FONT_TYPE1 ||
+            attr->type == HPDF_FONT_TRUETYPE);
+    HPDF_BOOL single_real = (attr->type != HPDF_FONT_TRUETYPE);
+    HPDF_UINT tmp_next = first;
+    HPDF_DOUBLE w = 0;
+    HPDF_UINT n;
+
+    HPDF_PTRACE ((" HPDF_TextLayout_MeasureLine\n"));
+
+    for (n = first; n < layout->num_units; n++) {
+        const HPDF_TextUnit *unit = layout->units + n;
+        HPDF_UINT i = unit->offset - start;
+        HPDF_BYTE b = text[unit->offset];
+
+        if (unit->flags & HPDF_TEXT_UNIT_SPACE) {
+            tmp_next = n + 1;
+            if (real_width)
+                *real_width = (HPDF_REAL)w;
+
+            w += word_space;
+            if (single_real)
+                w = (HPDF_REAL)w;
+        } else if (!wordwrap && (unit->flags & HPDF_TEXT_UNIT_START)) {
+            tmp_next = n;
+            if (real_width)
+                *real_width = (HPDF_REAL)w;
+        }
+
+        if (!single_byte && i > 0 && (unit->flags & HPDF_TEXT_UNIT_START)) {
+            w = (HPDF_REAL)(w + char_space);
+        }
+
+        if (attr->type == HPDF_FONT_TYPE1)
+            w = (HPDF_REAL)(w + (HPDF_REAL)(unit->width * font_size / 1000));
+        else if (attr->type == HPDF_FONT_TRUETYPE)
+            w += (HPDF_DOUBLE)unit->width * font_size / 1000;
+        else
+            w = (HPDF_REAL)(w + (HPDF_REAL)((HPDF_DOUBLE)unit->width *
+                    font_size / 1000));
+
+        /* 2006.08.04 break when it encountered  line feed */
+        if (w > width || b == 0x0A)
+            return tmp_next;
+
+        if (single_byte && i > 0) {
+            w += char_space;
+            if (single_real)
+                w = (HPDF_REAL)w;
+        }
+    }
+
+    /* all of text can be put in the specified width */
+    if (real_width)
+        *real_width = (HPDF_REAL)w;
+
+    return layout->num_units;
+}
+
+
+HPDF_TextWidth
+HPDF_TextLayout_TextWidth  (HPDF_TextLayout   layout,
+                            HPDF_UINT         first,
+                            HPDF_UINT         last)
+{
+    HPDF_TextWidth tw = {0, 0, 0, 0};
+    HPDF_UINT n;
+
+    for (n = first; n < last; n++) {
+        const HPDF_TextUnit *unit = layout->units + n;
+
+        tw.width += unit->width;
+        if (unit->flags & HPDF_TEXT_UNIT_START)
+            tw.numchars++;
+        if (unit->flags & HPDF_TEXT_UNIT_SPACE)
+            tw.numspace++;
+    }
+
+    return tw;
+}
+
+
+HPDF_EXPORT(void)
+HPDF_TextLayout_Free  (HPDF_TextLayout  layout)
+{
+    HPDF_PTRACE ((" HPDF_TextLayout_Free\n"));
+
+    if (layout) {
+        if (layout->owner)
+            HPDF_List_Remove (layout->owner, layout);
+
+        HPDF_FreeMem (layout->mmgr, layout);
+    }
+}
+
+
+HPDF_EXPORT(HPDF_UINT)
+HPDF_TextLayout_GetPos  (HPDF_TextLayout  layout)
+{
+    if (!layout)
+        return 0;
+
+    return layout->pos;
+}
+
+
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_TextLayout_SetPos  (HPDF_TextLayout  layout,
+                         HPDF_UINT        pos)
+{
+    HPDF_PTRACE ((" HPDF_TextLayout_SetPos\n"));
+
+    if (!layout)
+        return HPDF_INVALID_PARAMETER;
+
+    if (pos > layout->len)
+        return HPDF_RaiseError (layout->error, HPDF_INVALID_PARAMETER, 0);
+
+    layout->pos = pos;
+
+    return HPDF_OK;
+}
@@ -19,6 +19,9 @@
 #include "hpdf_utils.h"
 #include "hpdf_font.h"
 
+/* the longest text of a glyph in the ToUnicode cmap of a glyph font */
+#define HPDF_GLYPH_TEXT_MAX_LEN  64
+
 static HPDF_Font
 CIDFontType0_New (HPDF_Font parent,
                   HPDF_Xref xref);
@@ -47,6 +50,13 @@ MeasureText  (HPDF_Font         font,
               HPDF_REAL        *real_width);
 
 
+static HPDF_UINT
+CharWidths  (HPDF_Font          font,
+             const HPDF_BYTE   *text,
+             HPDF_UINT          len,
+             HPDF_TextUnit     *units);
+
+
 static char*
 UINT16ToHex  (char        *s,
               HPDF_UINT16  val,
@@ -61,9 +71,24 @@ CidRangeToHex (char        *s,
 
 static HPDF_Dict
 CreateCMap  (HPDF_Encoder   encoder,
+             HPDF_Ucs4Map   map,
              HPDF_Xref      xref,
              HPDF_BOOL      utf_entity_h_to_unicode);
 
+static HPDF_STATUS
+WriteCMapData  (HPDF_Encoder   encoder,
+                HPDF_Ucs4Map   map,
+                HPDF_Stream    stream,
+                HPDF_BOOL      utf_entity_h_to_unicode);
+
+static char*
+UCS4ToUTF16Hex  (char         *s,
+                 HPDF_UINT32   ucs4,
+                 char         *eptr);
+
+static HPDF_STATUS
+ApplySubsetGids  (HPDF_Dict   obj);
+
 
 static void
 OnFree_Func  (HPDF_Dict  obj);
@@ -73,6 +98,48 @@ static HPDF_STATUS
 CIDFontType2_BeforeWrite_Func  (HPDF_Dict   obj);
 
 
+static HPDF_STATUS
+GlyphFont_BeforeWrite_Func  (HPDF_Dict   obj);
+
+
+static HPDF_STATUS
+WriteGlyphCMapData  (HPDF_Font     font,
+                     HPDF_Stream   stream);
+
+
+static HPDF_INT16
+GetUnicodeWidth  (HPDF_Font      font,
+                  HPDF_UNICODE   unicode);
+
+
+static HPDF_TextWidth
+UnicodeTextWidth  (HPDF_Font         font,
+                   const HPDF_BYTE  *text,
+                   HPDF_UINT         len,
+                   HPDF_INT          dw2);
+
+
+static HPDF_UINT
+UnicodeMeasureText  (HPDF_Font          font,
+                     const HPDF_BYTE   *text,
+                     HPDF_UINT          len,
+                     HPDF_REAL          width,
+                     HPDF_REAL          font_size,
+                     HPDF_REAL          char_space,
+                     HPDF_REAL          word_space,
+                     HPDF_BOOL          wordwrap,
+                     HPDF_REAL         *real_width,
+                     HPDF_INT           dw2);
+
+
+static HPDF_UINT
+UnicodeCharWidths  (HPDF_Font          font,
+                    const HPDF_BYTE   *text,
+                    HPDF_UINT          len,
+                    HPDF_TextUnit     *units,
+                    HPDF_INT           dw2);
+
+
 /*--------------------------------------------------------------------------*/
 
 HPDF_Font
@@ -121,10 +188,12 @@ HPDF_Type0Font_New  (HPDF_MMgr        mmgr,
     encoder_attr = (HPDF_CMapEncoderAttr)encoder->attr;
 
     HPDF_MemSet (attr, 0, sizeof(HPDF_FontAttr_Rec));
+    HPDF_Ucs4Map_Init (&attr->ucs4_map, mmgr);
 
     attr->writing_mode = encoder_attr->writing_mode;
     attr->text_width_fn = TextWidth;
     attr->measure_text_fn = MeasureText;
+    attr->char_widths_fn = CharWidths;
     attr->fontdef = fontdef;
     attr->encoder = encoder;
     attr->xref = xref;
@@ -150,14 +219,15 @@ HPDF_Type0Font_New  (HPDF_MMgr        mmgr,
 	 */
         if (HPDF_StrCmp(encoder_attr->ordering, "Identity-H") == 0) {
 	    ret += HPDF_Dict_AddName (font, "Encoding", "Identity-H");
-	    attr->cmap_stream = CreateCMap (encoder, xref, HPDF_TRUE);
+	    attr->cmap_stream = CreateCMap (encoder, &attr->ucs4_map, xref,
+	            HPDF_TRUE);
 
 	    if (attr->cmap_stream) {
 	        ret += HPDF_Dict_Add (font, "ToUnicode", attr->cmap_stream);
 	    } else
 	        return NULL;
 	} else {
-            attr->cmap_stream = CreateCMap (encoder, xref, HPDF_FALSE);
+            attr->cmap_stream = CreateCMap (encoder, NULL, xref, HPDF_FALSE);
 
 	    if (attr->cmap_stream) {
 	        ret += HPDF_Dict_Add (font, "Encoding", attr->cmap_stream);
@@ -201,8 +271,31 @@ OnFree_Func  (HPDF_Dict  obj)
 
     HPDF_PTRACE ((" HPDF_Type0Font_OnFree\n"));
 
-    if (attr)
+    if (attr) {
+        if (attr->unicode_widths) {
+            HPDF_UINT i;
+
+            for (i = 0; i < 256; i++)
+                if (attr->unicode_widths[i])
+                    HPDF_FreeMem (obj->mmgr, attr->unicode_widths[i]);
+
+            HPDF_FreeMem (obj->mmgr, attr->unicode_widths);
+        }
+
+        if (attr->glyph_texts) {
+            HPDF_UINT i;
+
+            for (i = 0; i < attr->num_glyphs; i++)
+                if (attr->glyph_texts[i])
+                    HPDF_FreeMem (obj->mmgr, attr->glyph_texts[i]);
+
+            HPDF_FreeMem (obj->mmgr, attr->glyph_texts);
+        }
+
+        HPDF_Ucs4Map_Free (&attr->ucs4_map);
+
         HPDF_FreeMem (obj->mmgr, attr);
+    }
 }
 
 static HPDF_Font
@@ -435,6 +528,12 @@ CIDFontType2_New (HPDF_Font parent, HPDF_Xref xref)
         for (i = 0; i < max; i++, ptmp_map++) {
             HPDF_INT w = HPDF_TTFontDef_GetGidWidth (fontdef, *ptmp_map);
 
+            /* the widths of the codes given to supplementary characters
+             * are added by HPDF_Type0Font_AddSupplementaryChars */
+            if (encoder->to_ucs4_fn && i >= HPDF_SUPPLEMENTARY_CODE_FIRST &&
+                    i <= HPDF_SUPPLEMENTARY_CODE_LAST)
+                w = dw;
+
             if (w != dw) {
                 if (!tmp_array) {
                     if (HPDF_Array_AddNumber (array, i) != HPDF_OK)
@@ -514,6 +613,15 @@ CIDFontType2_BeforeWrite_Func  (HPDF_Dict obj)
 
     HPDF_PTRACE ((" CIDFontType2_BeforeWrite_Func\n"));
 
+    /* the font data may have been saved by another font already */
+    if ((ret = ApplySubsetGids (obj)) != HPDF_OK)
+        return ret;
+
+    /* this must be done before the font data is saved, it marks the
+     * glyphs of the supplementary characters as used */
+    if ((ret = HPDF_Type0Font_AddSupplementaryChars (obj)) != HPDF_OK)
+        return ret;
+
     if (font_attr->map_stream)
         font_attr->map_stream->filter = obj->filter;
 
@@ -534,8 +642,8 @@ CIDFontType2_BeforeWrite_Func  (HPDF_Dict obj)
             if (!font_data)
                 return HPDF_Error_GetCode (obj->error);
 
-            if (HPDF_TTFontDef_SaveFontData (font_attr->fontdef,
-                font_data->stream) != HPDF_OK)
+            if (HPDF_TTFontDef_SaveFontFile (font_attr->fontdef,
+                font_data->stream, obj->filter) != HPDF_OK)
                 return HPDF_Error_GetCode (obj->error);
 
             ret += HPDF_Dict_Add (descriptor, "FontFile2", font_data);
@@ -545,6 +653,7 @@ CIDFontType2_BeforeWrite_Func  (HPDF_Dict obj)
             ret += HPDF_Dict_AddNumber (font_data, "Length3", 0);
 
             font_data->filter = obj->filter;
+            font_data->encoded_filter = def_attr->encoded_filter;
 
             if (ret != HPDF_OK)
                 return HPDF_Error_GetCode (obj->error);
@@ -572,6 +681,9 @@ CIDFontType2_BeforeWrite_Func  (HPDF_Dict obj)
         font_attr->fontdef->descriptor = descriptor;
     }
 
+    if ((ret = ApplySubsetGids (obj)) != HPDF_OK)
+        return ret;
+
     if ((ret = HPDF_Dict_AddName (obj, "BaseFont",
                 def_attr->base_font)) != HPDF_OK)
         return ret;
@@ -585,6 +697,758 @@ CIDFontType2_BeforeWrite_Func  (HPDF_Dict obj)
 }
 
 
+/* When the font data was saved as a compact subset, the entries of the
+ * CIDToGIDMap are changed once to the numbers of the subset.
+ */
+static HPDF_STATUS
+ApplySubsetGids  (HPDF_Dict   obj)
+{
+    HPDF_FontAttr font_attr = (HPDF_FontAttr)obj->attr;
+    HPDF_FontDef fontdef = font_attr->fontdef;
+    HPDF_TTFontDefAttr def_attr = (HPDF_TTFontDefAttr)fontdef->attr;
+    HPDF_Stream stream;
+    HPDF_UINT count;
+    HPDF_UINT i;
+
+    if (font_attr->subset_gids || !def_attr->gid_map ||
+            !font_attr->map_stream)
+        return HPDF_OK;
+
+    stream = font_attr->map_stream->stream;
+    count = HPDF_MemStream_GetBufCount (stream);
+
+    /* the size of the buffers is even, so no entry spans two of them */
+    for (i = 0; i < count; i++) {
+        HPDF_UINT len;
+        HPDF_BYTE *buf = HPDF_MemStream_GetBufPtr (stream, i, &len);
+        HPDF_UINT j;
+
+        if (!buf)
+            return HPDF_Error_GetCode (obj->error);
+
+        for (j = 0; j + 1 < len; j += 2) {
+            HPDF_UINT16 gid = HPDF_TTFontDef_GetSubsetGid (fontdef,
+                    (HPDF_UINT16)(buf[j] << 8 | buf[j + 1]));
+
+            buf[j] = (HPDF_BYTE)(gid >> 8);
+            buf[j + 1] = (HPDF_BYTE)gid;
+        }
+    }
+
+    font_attr->subset_gids = HPDF_TRUE;
+
+    return HPDF_OK;
+}
+
+
+/* The UTF-8 encoder gives supplementary characters codes from the surrogate
+ * range as they occur in the text, so their glyphs, widths and unicode
+ * values are only known when the font is written.
+ */
+HPDF_STATUS
+HPDF_Type0Font_AddSupplementaryChars  (HPDF_Font   obj)
+{
+    HPDF_FontAttr font_attr = (HPDF_FontAttr)obj->attr;
+    HPDF_Encoder encoder = font_attr->encoder;
+    HPDF_FontDef fontdef = font_attr->fontdef;
+    HPDF_Array widths;
+    HPDF_UINT count = font_attr->ucs4_map.count;
+    HPDF_UINT i;
+
+    if (!encoder->to_ucs4_fn || count == font_attr->ucs4_count)
+        return HPDF_OK;
+
+    widths = HPDF_Dict_GetItem (font_attr->descendant_font, "W",
+            HPDF_OCLASS_ARRAY);
+    if (!widths)
+        return HPDF_Error_GetCode (obj->error);
+
+    for (i = font_attr->ucs4_count; i < count; i++) {
+        HPDF_UINT16 code = (HPDF_UINT16)(HPDF_SUPPLEMENTARY_CODE_FIRST + i);
+        HPDF_UINT32 ucs4 = HPDF_Encoder_ToUcs4 (encoder, &font_attr->ucs4_map,
+                code);
+        HPDF_UINT16 gid = HPDF_TTFontDef_GetGlyphid (fontdef, ucs4);
+        HPDF_INT w = HPDF_TTFontDef_GetCharWidth (fontdef, ucs4);
+
+        if (font_attr->subset_gids)
+            gid = HPDF_TTFontDef_GetSubsetGid (fontdef, gid);
+
+        if (w != fontdef->missing_width) {
+            HPDF_Array tmp_array = HPDF_Array_New (obj->mmgr);
+
+            if (!tmp_array)
+                return HPDF_Error_GetCode (obj->error);
+
+            if (HPDF_Array_AddNumber (widths, code) != HPDF_OK ||
+                    HPDF_Array_Add (widths, tmp_array) != HPDF_OK ||
+                    HPDF_Array_AddNumber (tmp_array, w) != HPDF_OK)
+                return HPDF_Error_GetCode (obj->error);
+        }
+
+        /* patch the entry of the code in the CIDToGIDMap */
+        if (font_attr->map_stream) {
+            HPDF_Stream stream = font_attr->map_stream->stream;
+            HPDF_MemStreamAttr stream_attr =
+                    (HPDF_MemStreamAttr)stream->attr;
+            HPDF_UINT pos = (HPDF_UINT)code * 2;
+            HPDF_UINT len;
+            HPDF_BYTE *buf = HPDF_MemStream_GetBufPtr (stream,
+                    pos / stream_attr->buf_siz, &len);
+
+            pos %= stream_attr->buf_siz;
+            if (!buf || pos + 2 > len)
+                return HPDF_SetError (obj->error, HPDF_INVALID_FONTDEF_DATA,
+                        0);
+
+            buf[pos] = (HPDF_BYTE)(gid >> 8);
+            buf[pos + 1] = (HPDF_BYTE)gid;
+        }
+    }
+
+    font_attr->ucs4_count = count;
+
+    /* the ToUnicode cmap is written again with the new characters */
+    if (font_attr->cmap_stream) {
+        HPDF_MemStream_FreeData (font_attr->cmap_stream->stream);
+        return WriteCMapData (encoder, &font_attr->ucs4_map,
+                font_attr->cmap_stream->stream, HPDF_TRUE);
+    }
+
+    return HPDF_OK;
+}
+
+
+/* The glyph font of a Type0 font based on a TrueType font shows the glyph
+ * ids given to HPDF_Page_ShowGlyphs with the predefined "Identity-H" cmap.
+ * Its widths, CIDToGIDMap and ToUnicode cmap are made from the glyphs used
+ * when it is written.
+ */
+HPDF_Font
+HPDF_Type0Font_GetGlyphFont  (HPDF_Font   font)
+{
+    HPDF_FontAttr attr = (HPDF_FontAttr)font->attr;
+    HPDF_FontDef fontdef = attr->fontdef;
+    HPDF_TTFontDefAttr def_attr = (HPDF_TTFontDefAttr)fontdef->attr;
+    HPDF_Font glyph_font;
+    HPDF_FontAttr glyph_attr;
+    HPDF_Dict descendant;
+    HPDF_Dict cid_system_info;
+    HPDF_Array descendant_fonts;
+    HPDF_STATUS ret = 0;
+
+    HPDF_PTRACE ((" HPDF_Type0Font_GetGlyphFont\n"));
+
+    if (attr->glyph_font)
+        return attr->glyph_font;
+
+    glyph_font = HPDF_Dict_New (font->mmgr);
+    if (!glyph_font)
+        return NULL;
+
+    glyph_attr = HPDF_GetMem (font->mmgr, sizeof(HPDF_FontAttr_Rec));
+    if (!glyph_attr) {
+        HPDF_Dict_Free (glyph_font);
+        return NULL;
+    }
+
+    HPDF_MemSet (glyph_attr, 0, sizeof(HPDF_FontAttr_Rec));
+
+    glyph_font->header.obj_class |= HPDF_OSUBCLASS_FONT;
+    glyph_font->free_fn = OnFree_Func;
+    glyph_font->before_write_fn = GlyphFont_BeforeWrite_Func;
+    glyph_font->attr = glyph_attr;
+    glyph_font->filter = font->filter;
+
+    glyph_attr->type = HPDF_FONT_TYPE0_TT;
+    glyph_attr->writing_mode = HPDF_WMODE_HORIZONTAL;
+    glyph_attr->text_width_fn = TextWidth;
+    glyph_attr->measure_text_fn = MeasureText;
+    glyph_attr->char_widths_fn = CharWidths;
+    glyph_attr->fontdef = fontdef;
+    glyph_attr->encoder = attr->encoder;
+    glyph_attr->xref = attr->xref;
+
+    glyph_attr->glyph_texts = HPDF_GetMem (font->mmgr,
+            sizeof(HPDF_UNICODE *) * def_attr->num_glyphs);
+    if (!glyph_attr->glyph_texts) {
+        HPDF_Dict_Free (glyph_font);
+        return NULL;
+    }
+
+    HPDF_MemSet (glyph_attr->glyph_texts, 0,
+            sizeof(HPDF_UNICODE *) * def_attr->num_glyphs);
+    glyph_attr->num_glyphs = def_attr->num_glyphs;
+
+    if (HPDF_Xref_Add (attr->xref, glyph_font) != HPDF_OK)
+        return NULL;
+
+    ret += HPDF_Dict_AddName (glyph_font, "Type", "Font");
+    ret += HPDF_Dict_AddName (glyph_font, "BaseFont", fontdef->base_font);
+    ret += HPDF_Dict_AddName (glyph_font, "Subtype", "Type0");
+    ret += HPDF_Dict_AddName (glyph_font, "Encoding", "Identity-H");
+    if (ret != HPDF_OK)
+        return NULL;
+
+    glyph_attr->cmap_stream = HPDF_DictStream_New (font->mmgr, attr->xref);
+    if (!glyph_attr->cmap_stream ||
+            HPDF_Dict_Add (glyph_font, "ToUnicode", glyph_attr->cmap_stream)
+            != HPDF_OK)
+        return NULL;
+
+    descendant_fonts = HPDF_Array_New (font->mmgr);
+    if (!descendant_fonts ||
+            HPDF_Dict_Add (glyph_font, "DescendantFonts", descendant_fonts)
+            != HPDF_OK)
+        return NULL;
+
+    descendant = HPDF_Dict_New (font->mmgr);
+    if (!descendant || HPDF_Xref_Add (attr->xref, descendant) != HPDF_OK ||
+            HPDF_Array_Add (descendant_fonts, descendant) != HPDF_OK)
+        return NULL;
+
+    glyph_attr->descendant_font = descendant;
+
+    ret += HPDF_Dict_AddName (descendant, "Type", "Font");
+    ret += HPDF_Dict_AddName (descendant, "Subtype", "CIDFontType2");
+    ret += HPDF_Dict_AddNumber (descendant, "DW", fontdef->missing_width);
+    if (ret != HPDF_OK)
+        return NULL;
+
+    cid_system_info = HPDF_Dict_New (font->mmgr);
+    if (!cid_system_info ||
+            HPDF_Dict_Add (descendant, "CIDSystemInfo", cid_system_info)
+            != HPDF_OK)
+        return NULL;
+
+    ret += HPDF_Dict_Add (cid_system_info, "Registry",
+            HPDF_String_New (font->mmgr, "Adobe", NULL));
+    ret += HPDF_Dict_Add (cid_system_info, "Ordering",
+            HPDF_String_New (font->mmgr, "Identity", NULL));
+    ret += HPDF_Dict_AddNumber (cid_system_info, "Supplement", 0);
+    if (ret != HPDF_OK)
+        return NULL;
+
+    /* the glyph ids need a map only for the glyph numbers of a compact
+     * subset, which are known when the font data is saved */
+    if (def_attr->embedding) {
+        glyph_attr->map_stream = HPDF_DictStream_New (font->mmgr,
+                attr->xref);
+        if (!glyph_attr->map_stream ||
+                HPDF_Dict_Add (descendant, "CIDToGIDMap",
+                glyph_attr->map_stream) != HPDF_OK)
+            return NULL;
+    } else if (HPDF_Dict_AddName (descendant, "CIDToGIDMap", "Identity")
+            != HPDF_OK)
+        return NULL;
+
+    attr->glyph_font = glyph_font;
+
+    return glyph_font;
+}
+
+
+HPDF_STATUS
+HPDF_Type0Font_UseGlyphs  (HPDF_Font           glyph_font,
+                           const HPDF_UINT16  *glyphs,
+                           HPDF_UINT           count,
+                           const char         *text,
+                           const HPDF_UINT    *clusters)
+{
+    HPDF_FontAttr attr = (HPDF_FontAttr)glyph_font->attr;
+    HPDF_UINT text_len = 0;
+    HPDF_UINT i;
+
+    HPDF_PTRACE ((" HPDF_Type0Font_UseGlyphs\n"));
+
+    if (text && clusters)
+        text_len = HPDF_StrLen (text, HPDF_LIMIT_MAX_STRING_LEN);
+
+    for (i = 0; i < count; i++) {
+        HPDF_UINT16 gid = glyphs[i];
+        HPDF_UNICODE units[HPDF_GLYPH_TEXT_MAX_LEN];
+        HPDF_UINT num_units = 0;
+        HPDF_UNICODE *entry;
+
+        if (gid >= attr->num_glyphs)
+            return HPDF_SetError (glyph_font->error, HPDF_INVALID_PARAMETER,
+                    0);
+
+        HPDF_TTFontDef_UseGlyph (attr->fontdef, gid);
+
+        entry = attr->glyph_texts[gid];
+
+        /* without clusters the text of a glyph is looked up when the font
+         * is written. with them, the first glyph of a cluster takes its
+         * text, which ends at the nearest greater cluster on either side,
+         * and the other glyphs of the cluster have no text */
+        if (text_len == 0) {
+            if (entry)
+                continue;
+        } else if ((i == 0 || clusters[i - 1] != clusters[i]) &&
+                clusters[i] < text_len && (!entry || entry[0] == 0)) {
+            HPDF_UINT end = text_len;
+            HPDF_UINT j = i + 1;
+
+            while (j < count && clusters[j] == clusters[i])
+                j++;
+
+            if (j < count && clusters[j] > clusters[i] && clusters[j] < end)
+                end = clusters[j];
+
+            if (i > 0 && clusters[i - 1] > clusters[i] &&
+                    clusters[i - 1] < end)
+                end = clusters[i - 1];
+
+            HPDF_Encoder_DecodeText (attr->encoder, NULL,
+                    (const HPDF_BYTE *)text + clusters[i], end - clusters[i],
+                    units, NULL, HPDF_GLYPH_TEXT_MAX_LEN, &num_units);
+
+            if (num_units == 0)
+                continue;
+
+            if (entry)
+                HPDF_FreeMem (glyph_font->mmgr, entry);
+        } else
+            continue;
+
+        entry = HPDF_GetMem (glyph_font->mmgr,
+                sizeof(HPDF_UNICODE) * (num_units + 1));
+        attr->glyph_texts[gid] = entry;
+        if (!entry)
+            return HPDF_Error_GetCode (glyph_font->error);
+
+        entry[0] = (HPDF_UNICODE)num_units;
+        HPDF_MemCpy ((HPDF_BYTE *)(entry + 1), (HPDF_BYTE *)units,
+                sizeof(HPDF_UNICODE) * num_units);
+    }
+
+    return HPDF_OK;
+}
+
+
+static HPDF_STATUS
+GlyphFont_BeforeWrite_Func  (HPDF_Dict   obj)
+{
+    HPDF_FontAttr font_attr = (HPDF_FontAttr)obj->attr;
+    HPDF_FontDef fontdef = font_attr->fontdef;
+    HPDF_TTFontDefAttr def_attr = (HPDF_TTFontDefAttr)fontdef->attr;
+    HPDF_Array widths;
+    HPDF_Array tmp_array = NULL;
+    HPDF_UINT max = 0;
+    HPDF_UINT i;
+    HPDF_STATUS ret;
+
+    HPDF_PTRACE ((" GlyphFont_BeforeWrite_Func\n"));
+
+    /* the font data is saved by the Type0 font, which comes first */
+    if (!fontdef->descriptor)
+        return HPDF_SetError (obj->error, HPDF_INVALID_FONTDEF_DATA, 0);
+
+    /* the widths and the map cover the glyphs of the font data */
+    for (i = 0; i < font_attr->num_glyphs; i++)
+        if (def_attr->glyph_tbl.flgs[i])
+            max = i + 1;
+
+    /* add 'W' element, it is made again when the document is saved again */
+    widths = HPDF_Array_New (obj->mmgr);
+    if (!widths)
+        return HPDF_Error_GetCode (obj->error);
+
+    if ((ret = HPDF_Dict_Add (font_attr->descendant_font, "W", widths))
+            != HPDF_OK)
+        return ret;
+
+    for (i = 0; i < max; i++) {
+        HPDF_INT w = HPDF_TTFontDef_GetGidWidth (fontdef, (HPDF_UINT16)i);
+
+        if (def_attr->glyph_tbl.flgs[i] && w != fontdef->missing_width) {
+            if (!tmp_array) {
+                if (HPDF_Array_AddNumber (widths, i) != HPDF_OK)
+                    return HPDF_Error_GetCode (obj->error);
+
+                tmp_array = HPDF_Array_New (obj->mmgr);
+                if (!tmp_array)
+                    return HPDF_Error_GetCode (obj->error);
+
+                if (HPDF_Array_Add (widths, tmp_array) != HPDF_OK)
+                    return HPDF_Error_GetCode (obj->error);
+            }
+
+            if (HPDF_Array_AddNumber (tmp_array, w) != HPDF_OK)
+                return HPDF_Error_GetCode (obj->error);
+        } else
+            tmp_array = NULL;
+    }
+
+    /* create "CIDToGIDMap" data, an identity until the glyph numbers of a
+     * compact subset are applied */
+    if (font_attr->map_stream) {
+        HPDF_Stream stream = font_attr->map_stream->stream;
+
+        HPDF_MemStream_FreeData (stream);
+        font_attr->subset_gids = HPDF_FALSE;
+
+        for (i = 0; i < max; i++) {
+            HPDF_BYTE u[2];
+
+            u[0] = (HPDF_BYTE)(i >> 8);
+            u[1] = (HPDF_BYTE)i;
+
+            if ((ret = HPDF_Stream_Write (stream, u, 2)) != HPDF_OK)
+                return ret;
+        }
+
+        font_attr->map_stream->filter = obj->filter;
+
+        if ((ret = ApplySubsetGids (obj)) != HPDF_OK)
+            return ret;
+    }
+
+    HPDF_MemStream_FreeData (font_attr->cmap_stream->stream);
+    if ((ret = WriteGlyphCMapData (obj, font_attr->cmap_stream->stream))
+            != HPDF_OK)
+        return ret;
+
+    font_attr->cmap_stream->filter = obj->filter;
+
+    if ((ret = HPDF_Dict_AddName (obj, "BaseFont",
+                def_attr->base_font)) != HPDF_OK)
+        return ret;
+
+    if ((ret = HPDF_Dict_AddName (font_attr->descendant_font, "BaseFont",
+                def_attr->base_font)) != HPDF_OK)
+        return ret;
+
+    return HPDF_Dict_Add (font_attr->descendant_font, "FontDescriptor",
+                fontdef->descriptor);
+}
+
+
+/* The ToUnicode cmap of a glyph font maps each glyph used to its text, or
+ * to the character which the font maps to the glyph when it has no text.
+ */
+static HPDF_STATUS
+WriteGlyphCMapData  (HPDF_Font     font,
+                     HPDF_Stream   stream)
+{
+    static const char HEX[] = "0123456789ABCDEF";
+    HPDF_FontAttr attr = (HPDF_FontAttr)font->attr;
+    HPDF_UNICODE **texts = attr->glyph_texts;
+    HPDF_UNICODE *unicodes = NULL;
+    HPDF_STATUS ret = HPDF_OK;
+    char buf[HPDF_TMP_BUF_SIZ];
+    char *pbuf;
+    char *eptr = buf + HPDF_TMP_BUF_SIZ - 1;
+    HPDF_UINT count = 0;
+    HPDF_UINT n = 0;
+    HPDF_UINT i;
+
+    /* the characters of the glyphs are looked up once for all of them */
+    for (i = 1; i < attr->num_glyphs; i++)
+        if (texts[i] && texts[i][0] == 0)
+            break;
+
+    if (i < attr->num_glyphs) {
+        HPDF_UINT32 unicode;
+
+        unicodes = HPDF_GetMem (font->mmgr,
+                sizeof(HPDF_UNICODE) * attr->num_glyphs);
+        if (!unicodes)
+            return HPDF_Error_GetCode (font->error);
+
+        HPDF_MemSet (unicodes, 0, sizeof(HPDF_UNICODE) * attr->num_glyphs);
+
+        /* the lowest character of a glyph is kept */
+        for (unicode = 0xFFFF; unicode > 0; unicode--) {
+            HPDF_UINT16 gid = HPDF_TTFontDef_GetGlyphid (attr->fontdef,
+                    unicode);
+
+            if (gid < attr->num_glyphs && (unicode < 0xD800 ||
+                    unicode > 0xDFFF))
+                unicodes[gid] = (HPDF_UNICODE)unicode;
+        }
+    }
+
+    for (i = 1; i < attr->num_glyphs; i++)
+        if (texts[i] && (texts[i][0] > 0 || unicodes[i] != 0))
+            count++;
+
+    ret += HPDF_Stream_WriteStr (stream,
+                "/CIDInit /ProcSet findresource begin\r\n"
+                "12 dict begin\r\n"
+                "begincmap\r\n"
+                "/CIDSystemInfo <<\r\n"
+                "  /Registry (Adobe)\r\n"
+                "  /Ordering (UCS)\r\n"
+                "  /Supplement 0\r\n"
+                ">> def\r\n"
+                "/CMapName /Adobe-Identity-UCS def\r\n"
+                "/CMapType 2 def\r\n"
+                "1 begincodespacerange\r\n"
+                "<0000> <FFFF>\r\n"
+                "endcodespacerange\r\n");
+
+    for (i = 1; i < attr->num_glyphs && ret == HPDF_OK; i++) {
+        HPDF_UNICODE *text = texts[i];
+        HPDF_UINT j;
+
+        if (!text || (text[0] == 0 && unicodes[i] == 0))
+            continue;
+
+        pbuf = buf;
+        if (n % 100 == 0) {
+            pbuf = HPDF_IToA (pbuf, (count - n < 100) ? count - n : 100,
+                    eptr);
+            pbuf = (char *)HPDF_StrCpy (pbuf, " beginbfchar\r\n", eptr);
+        }
+
+        pbuf = UINT16ToHex (pbuf, (HPDF_UINT16)i, eptr, 2);
+        *pbuf++ = ' ';
+
+        if (text[0] == 0)
+            pbuf = UINT16ToHex (pbuf, unicodes[i], eptr, 2);
+        else {
+            *pbuf++ = '<';
+            for (j = 1; j <= text[0]; j++) {
+                *pbuf++ = HEX[text[j] >> 12];
+                *pbuf++ = HEX[(text[j] >> 8) & 0x0F];
+                *pbuf++ = HEX[(text[j] >> 4) & 0x0F];
+                *pbuf++ = HEX[text[j] & 0x0F];
+            }
+            *pbuf++ = '>';
+        }
+
+        pbuf = (char *)HPDF_StrCpy (pbuf, "\r\n", eptr);
+
+        n++;
+        if (n % 100 == 0 || n == count)
+            HPDF_StrCpy (pbuf, "endbfchar\r\n", eptr);
+
+        ret += HPDF_Stream_WriteStr (stream, buf);
+    }
+
+    ret += HPDF_Stream_WriteStr (stream,
+                "endcmap\r\n"
+                "CMapName currentdict /CMap defineresource pop\r\n"
+                "end\r\n"
+                "end\r\n");
+
+    if (unicodes)
+        HPDF_FreeMem (font->mmgr, unicodes);
+
+    if (ret != HPDF_OK)
+        return HPDF_Error_GetCode (font->error);
+
+    return HPDF_OK;
+}
+
+
+static HPDF_INT16
+GetUnicodeWidth  (HPDF_Font      font,
+                  HPDF_UNICODE   unicode)
+{
+    HPDF_FontAttr attr = (HPDF_FontAttr)font->attr;
+    HPDF_INT16 *page;
+    HPDF_INT16 w;
+
+    if (!attr->unicode_widths) {
+        attr->unicode_widths = HPDF_GetMem (font->mmgr,
+                sizeof(HPDF_INT16 *) * 256);
+        if (!attr->unicode_widths)
+            return 0;
+
+        HPDF_MemSet (attr->unicode_widths, 0, sizeof(HPDF_INT16 *) * 256);
+    }
+
+    page = attr->unicode_widths[unicode >> 8];
+    if (!page) {
+        page = HPDF_GetMem (font->mmgr, sizeof(HPDF_INT16) * 256);
+        if (!page)
+            return 0;
+
+        HPDF_MemSet (page, 0xFF, sizeof(HPDF_INT16) * 256);
+        attr->unicode_widths[unicode >> 8] = page;
+    }
+
+    w = page[unicode & 0xFF];
+    if (w < 0) {
+        /* this also marks the glyph as used for the font subset */
+        w = HPDF_TTFontDef_GetCharWidth (attr->fontdef,
+                HPDF_Encoder_ToUcs4 (attr->encoder, &attr->ucs4_map,
+                unicode));
+        page[unicode & 0xFF] = w;
+    }
+
+    return w;
+}
+
+
+/* TextWidth of a font based on a TrueType font. the text is decoded in
+ * blocks with HPDF_Encoder_DecodeText instead of byte by byte.
+ */
+static HPDF_TextWidth
+UnicodeTextWidth  (HPDF_Font         font,
+                   const HPDF_BYTE  *text,
+                   HPDF_UINT         len,
+                   HPDF_INT          dw2)
+{
+    HPDF_TextWidth tw = {0, 0, 0, 0};
+    HPDF_FontAttr attr = (HPDF_FontAttr)font->attr;
+    HPDF_UNICODE unicodes[HPDF_TEXT_DEFAULT_LEN];
+    HPDF_UINT i = 0;
+
+    while (i < len) {
+        HPDF_UINT num_chars;
+        HPDF_UINT j;
+
+        i += HPDF_Encoder_DecodeText (attr->encoder, &attr->ucs4_map,
+                text + i, len - i, unicodes, NULL, HPDF_TEXT_DEFAULT_LEN,
+                &num_chars);
+
+        for (j = 0; j < num_chars; j++) {
+            HPDF_UNICODE unicode = unicodes[j];
+
+            if (attr->writing_mode == HPDF_WMODE_HORIZONTAL)
+                tw.width += GetUnicodeWidth (font, unicode);
+            else
+                tw.width += -dw2;
+
+            if (HPDF_IS_WHITE_SPACE(unicode)) {
+                tw.numwords++;
+                tw.numspace++;
+            }
+        }
+
+        tw.numchars += num_chars;
+    }
+
+    /* 2006.08.19 add. */
+    if (len == 0 || HPDF_IS_WHITE_SPACE(text[len - 1]))
+        ; /* do nothing. */
+    else
+        tw.numwords++;
+
+    return tw;
+}
+
+
+/* MeasureText of a font based on a TrueType font, see UnicodeTextWidth.
+ * the text is only broken at the first byte of a character.
+ */
+static HPDF_UINT
+UnicodeMeasureText  (HPDF_Font          font,
+                     const HPDF_BYTE   *text,
+                     HPDF_UINT          len,
+                     HPDF_REAL          width,
+                     HPDF_REAL          font_size,
+                     HPDF_REAL          char_space,
+                     HPDF_REAL          word_space,
+                     HPDF_BOOL          wordwrap,
+                     HPDF_REAL         *real_width,
+                     HPDF_INT           dw2)
+{
+    HPDF_FontAttr attr = (HPDF_FontAttr)font->attr;
+    HPDF_UNICODE unicodes[HPDF_TEXT_DEFAULT_LEN];
+    HPDF_UINT offsets[HPDF_TEXT_DEFAULT_LEN];
+    HPDF_REAL w = 0;
+    HPDF_UINT tmp_len = 0;
+    HPDF_UINT pos = 0;
+
+    while (pos < len) {
+        HPDF_UINT num_chars;
+        HPDF_UINT j;
+        HPDF_UINT decoded = HPDF_Encoder_DecodeText (attr->encoder,
+                &attr->ucs4_map, text + pos, len - pos, unicodes, offsets,
+                HPDF_TEXT_DEFAULT_LEN, &num_chars);
+
+        for (j = 0; j < num_chars; j++) {
+            HPDF_UINT i = pos + offsets[j];
+            HPDF_BYTE b = text[i];
+            HPDF_INT tmp_w;
+
+            if (HPDF_IS_WHITE_SPACE(b)) {
+                tmp_len = i + 1;
+                if (real_width)
+                    *real_width = w;
+            } else if (!wordwrap) {
+                tmp_len = i;
+                if (real_width)
+                    *real_width = w;
+            }
+
+            if (HPDF_IS_WHITE_SPACE(b))
+                w += word_space;
+
+            if (attr->writing_mode == HPDF_WMODE_HORIZONTAL)
+                tmp_w = GetUnicodeWidth (font, unicodes[j]);
+            else
+                tmp_w = -dw2;
+
+            if (i > 0)
+                w += char_space;
+
+            w += (HPDF_REAL)((HPDF_DOUBLE)tmp_w * font_size / 1000);
+
+            /* 2006.08.04 break when it encountered  line feed */
+            if (w > width || b == 0x0A)
+                return tmp_len;
+        }
+
+        pos += decoded;
+    }
+
+    /* all of text can be put in the specified width */
+    if (real_width)
+        *real_width = w;
+
+    return len;
+}
+
+
+/* CharWidths of a font based on a TrueType font, one unit for each
+ * character as UnicodeMeasureText steps through them.
+ */
+static HPDF_UINT
+UnicodeCharWidths  (HPDF_Font          font,
+                    const HPDF_BYTE   *text,
+                    HPDF_UINT          len,
+                    HPDF_TextUnit     *units,
+                    HPDF_INT           dw2)
+{
+    HPDF_FontAttr attr = (HPDF_FontAttr)font->attr;
+    HPDF_UNICODE unicodes[HPDF_TEXT_DEFAULT_LEN];
+    HPDF_UINT offsets[HPDF_TEXT_DEFAULT_LEN];
+    HPDF_UINT pos = 0;
+    HPDF_UINT n = 0;
+
+    while (pos < len) {
+        HPDF_UINT num_chars;
+        HPDF_UINT j;
+        HPDF_UINT decoded = HPDF_Encoder_DecodeText (attr->encoder,
+                &attr->ucs4_map, text + pos, len - pos, unicodes, offsets,
+                HPDF_TEXT_DEFAULT_LEN, &num_chars);
+
+        for (j = 0; j < num_chars; j++) {
+            HPDF_UINT i = pos + offsets[j];
+
+            units[n].offset = i;
+            if (attr->writing_mode == HPDF_WMODE_HORIZONTAL)
+                units[n].width = GetUnicodeWidth (font, unicodes[j]);
+            else
+                units[n].width = -dw2;
+            units[n].flags = HPDF_TEXT_UNIT_START;
+            if (HPDF_IS_WHITE_SPACE(text[i]))
+                units[n].flags |= HPDF_TEXT_UNIT_SPACE;
+            n++;
+        }
+
+        pos += decoded;
+    }
+
+    return n;
+}
+
+
 static HPDF_TextWidth
 TextWidth  (HPDF_Font         font,
             const HPDF_BYTE  *text,
@@ -605,8 +1469,10 @@ TextWidth  (HPDF_Font         font,
                     (HPDF_CIDFontDefAttr)attr->fontdef->attr;
         dw2 = cid_fontdef_attr->DW2[1];
     } else {
+        /* unicode-based font */
         dw2 = (HPDF_INT)(attr->fontdef->font_bbox.bottom -
                     attr->fontdef->font_bbox.top);
+        return UnicodeTextWidth (font, text, len, dw2);
     }
 
     HPDF_Encoder_SetParseText (encoder, &parse_state, text, len);
@@ -614,7 +1480,6 @@ TextWidth  (HPDF_Font         font,
     while (i < len) {
         HPDF_ByteType btype = (encoder->byte_type_fn)(encoder, &parse_state);
         HPDF_UINT16 cid;
-        HPDF_UNICODE unicode;
         HPDF_UINT16 code;
         HPDF_UINT w = 0;
 
@@ -628,15 +1493,9 @@ TextWidth  (HPDF_Font         font,
 
         if (btype != HPDF_BYTE_TYPE_TRIAL) {
             if (attr->writing_mode == HPDF_WMODE_HORIZONTAL) {
-                if (attr->fontdef->type == HPDF_FONTDEF_TYPE_CID) {
-                    /* cid-based font */
-                    cid = HPDF_CMapEncoder_ToCID (encoder, code);
-                    w = HPDF_CIDFontDef_GetCIDWidth (attr->fontdef, cid);
-                } else {
-                    /* unicode-based font */
-                    unicode = (encoder->to_unicode_fn)(encoder, code);
-                    w = HPDF_TTFontDef_GetCharWidth (attr->fontdef, unicode);
-                }
+                /* cid-based font */
+                cid = HPDF_CMapEncoder_ToCID (encoder, code);
+                w = HPDF_CIDFontDef_GetCIDWidth (attr->fontdef, cid);
             } else {
                 w = -dw2;
             }
@@ -690,8 +1549,11 @@ MeasureText  (HPDF_Font          font,
                 (HPDF_CIDFontDefAttr)attr->fontdef->attr;
         dw2 = cid_fontdef_attr->DW2[1];
     } else {
+        /* unicode-based font */
         dw2 = (HPDF_INT)(attr->fontdef->font_bbox.bottom -
                     attr->fontdef->font_bbox.top);
+        return UnicodeMeasureText (font, text, len, width, font_size,
+                char_space, word_space, wordwrap, real_width, dw2);
     }
 
     HPDF_Encoder_SetParseText (encoder, &parse_state, text, len);
@@ -700,7 +1562,6 @@ MeasureText  (HPDF_Font          font,
         HPDF_BYTE b = *text++;
         HPDF_BYTE b2 = *text;  /* next byte */
         HPDF_ByteType btype = HPDF_Encoder_ByteType (encoder, &parse_state);
-        HPDF_UNICODE unicode;
         HPDF_UINT16 code = b;
         HPDF_UINT16 tmp_w = 0;
 
@@ -744,16 +1605,9 @@ MeasureText  (HPDF_Font          font,
 
         if (btype != HPDF_BYTE_TYPE_TRIAL) {
             if (attr->writing_mode == HPDF_WMODE_HORIZONTAL) {
-                if (attr->fontdef->type == HPDF_FONTDEF_TYPE_CID) {
-                    /* cid-based font */
-                    HPDF_UINT16 cid = HPDF_CMapEncoder_ToCID (encoder, code);
-                    tmp_w = HPDF_CIDFontDef_GetCIDWidth (attr->fontdef, cid);
-                } else {
-                    /* unicode-based font */
-                    unicode = (encoder->to_unicode_fn)(encoder, code);
-                    tmp_w = HPDF_TTFontDef_GetCharWidth (attr->fontdef,
-                            unicode);
-                }
+                /* cid-based font */
+                HPDF_UINT16 cid = HPDF_CMapEncoder_ToCID (encoder, code);
+                tmp_w = HPDF_CIDFontDef_GetCIDWidth (attr->fontdef, cid);
             } else {
                 tmp_w = (HPDF_UINT16)(-dw2);
             }
@@ -782,6 +1636,68 @@ MeasureText  (HPDF_Font          font,
 }
 
 
+static HPDF_UINT
+CharWidths  (HPDF_Font          font,
+             const HPDF_BYTE   *text,
+             HPDF_UINT          len,
+             HPDF_TextUnit     *units)
+{
+    HPDF_FontAttr attr = (HPDF_FontAttr)font->attr;
+    HPDF_Encoder encoder = attr->encoder;
+    HPDF_ParseText_Rec  parse_state;
+    HPDF_UINT i;
+    HPDF_INT dw2;
+
+    HPDF_PTRACE ((" HPDF_Type0Font_CharWidths\n"));
+
+    if (attr->fontdef->type == HPDF_FONTDEF_TYPE_CID) {
+        HPDF_CIDFontDefAttr cid_fontdef_attr =
+                (HPDF_CIDFontDefAttr)attr->fontdef->attr;
+        dw2 = cid_fontdef_attr->DW2[1];
+    } else {
+        /* unicode-based font */
+        dw2 = (HPDF_INT)(attr->fontdef->font_bbox.bottom -
+                    attr->fontdef->font_bbox.top);
+        return UnicodeCharWidths (font, text, len, units, dw2);
+    }
+
+    HPDF_Encoder_SetParseText (encoder, &parse_state, text, len);
+
+    /* one unit for each byte as MeasureText steps through them */
+    for (i = 0; i < len; i++) {
+        HPDF_BYTE b = text[i];
+        HPDF_ByteType btype = HPDF_Encoder_ByteType (encoder, &parse_state);
+        HPDF_UINT16 code = b;
+        HPDF_UINT16 tmp_w = 0;
+
+        if (btype == HPDF_BYTE_TYPE_LEAD) {
+            code <<= 8;
+            code = (HPDF_UINT16)(code + text[i + 1]);
+        }
+
+        units[i].offset = i;
+        units[i].flags = 0;
+
+        if (btype != HPDF_BYTE_TYPE_TRIAL) {
+            if (attr->writing_mode == HPDF_WMODE_HORIZONTAL) {
+                HPDF_UINT16 cid = HPDF_CMapEncoder_ToCID (encoder, code);
+                tmp_w = HPDF_CIDFontDef_GetCIDWidth (attr->fontdef, cid);
+            } else {
+                tmp_w = (HPDF_UINT16)(-dw2);
+            }
+
+            units[i].flags |= HPDF_TEXT_UNIT_START;
+        }
+
+        units[i].width = tmp_w;
+        if (HPDF_IS_WHITE_SPACE(b))
+            units[i].flags |= HPDF_TEXT_UNIT_SPACE;
+    }
+
+    return len;
+}
+
+
 
 static char*
 UINT16ToHex  (char        *s,
@@ -863,19 +1779,44 @@ CidRangeToHex  (char        *s,
     return pbuf;
 }
 
+/* writes a supplementary character as a hex string of its UTF-16BE
+ * surrogate pair.
+ */
+static char*
+UCS4ToUTF16Hex  (char         *s,
+                 HPDF_UINT32   ucs4,
+                 char         *eptr)
+{
+    HPDF_UINT32 pair;
+    HPDF_INT i;
+
+    if (eptr - s < 11)
+        return s;
+
+    ucs4 -= 0x10000;
+    pair = ((0xD800 + (ucs4 >> 10)) << 16) | (0xDC00 + (ucs4 & 0x3FF));
+
+    *s++ = '<';
+    for (i = 28; i >= 0; i -= 4) {
+        char c = (char)((pair >> i) & 0x0f);
+
+        *s++ = (char)(c <= 9 ? c + 0x30 : c + 0x41 - 10);
+    }
+    *s++ = '>';
+    *s = 0;
+
+    return s;
+}
+
 static HPDF_Dict
 CreateCMap  (HPDF_Encoder   encoder,
+             HPDF_Ucs4Map   map,
              HPDF_Xref      xref,
              HPDF_BOOL      utf_entity_h_to_unicode)
 {
     HPDF_STATUS ret = HPDF_OK;
     HPDF_Dict cmap = HPDF_DictStream_New (encoder->mmgr, xref);
     HPDF_CMapEncoderAttr attr = (HPDF_CMapEncoderAttr)encoder->attr;
-    char buf[HPDF_TMP_BUF_SIZ];
-    char *pbuf;
-    char *eptr = buf + HPDF_TMP_BUF_SIZ - 1;
-    HPDF_UINT i;
-    HPDF_UINT phase, odd;
     HPDF_Dict sysinfo;
 
     if (!cmap)
@@ -899,18 +1840,43 @@ CreateCMap  (HPDF_Encoder   encoder,
     ret += HPDF_Dict_AddNumber (cmap, "WMode",
                     (HPDF_UINT32)attr->writing_mode);
 
+    if (ret != HPDF_OK)
+        return NULL;
+
+    if (WriteCMapData (encoder, map, cmap->stream, utf_entity_h_to_unicode) !=
+            HPDF_OK)
+        return NULL;
+
+    return cmap;
+}
+
+
+static HPDF_STATUS
+WriteCMapData  (HPDF_Encoder   encoder,
+                HPDF_Ucs4Map   map,
+                HPDF_Stream    stream,
+                HPDF_BOOL      utf_entity_h_to_unicode)
+{
+    HPDF_STATUS ret = HPDF_OK;
+    HPDF_CMapEncoderAttr attr = (HPDF_CMapEncoderAttr)encoder->attr;
+    char buf[HPDF_TMP_BUF_SIZ];
+    char *pbuf;
+    char *eptr = buf + HPDF_TMP_BUF_SIZ - 1;
+    HPDF_UINT i;
+    HPDF_UINT phase, odd;
+
     /* create cmap data from encoding data */
-    ret += HPDF_Stream_WriteStr (cmap->stream,
+    ret += HPDF_Stream_WriteStr (stream,
                 "%!PS-Adobe-3.0 Resource-CMap\r\n");
-    ret += HPDF_Stream_WriteStr (cmap->stream,
+    ret += HPDF_Stream_WriteStr (stream,
                 "%%DocumentNeededResources: ProcSet (CIDInit)\r\n");
-    ret += HPDF_Stream_WriteStr (cmap->stream,
+    ret += HPDF_Stream_WriteStr (stream,
                 "%%IncludeResource: ProcSet (CIDInit)\r\n");
 
     pbuf = (char *)HPDF_StrCpy (buf, "%%BeginResource: CMap (", eptr);
     pbuf = (char *)HPDF_StrCpy (pbuf, encoder->name, eptr);
     HPDF_StrCpy (pbuf, ")\r\n", eptr);
-    ret += HPDF_Stream_WriteStr (cmap->stream, buf);
+    ret += HPDF_Stream_WriteStr (stream, buf);
 
     pbuf = (char *)HPDF_StrCpy (buf, "%%Title: (", eptr);
     pbuf = (char *)HPDF_StrCpy (pbuf, encoder->name, eptr);
@@ -921,52 +1887,52 @@ CreateCMap  (HPDF_Encoder   encoder,
     *pbuf++ = ' ';
     pbuf = HPDF_IToA (pbuf, attr->suppliment, eptr);
     HPDF_StrCpy (pbuf, ")\r\n", eptr);
-    ret += HPDF_Stream_WriteStr (cmap->stream, buf);
+    ret += HPDF_Stream_WriteStr (stream, buf);
 
-    ret += HPDF_Stream_WriteStr (cmap->stream, "%%Version: 1.0\r\n");
-    ret += HPDF_Stream_WriteStr (cmap->stream, "%%EndComments\r\n");
+    ret += HPDF_Stream_WriteStr (stream, "%%Version: 1.0\r\n");
+    ret += HPDF_Stream_WriteStr (stream, "%%EndComments\r\n");
 
-    ret += HPDF_Stream_WriteStr (cmap->stream,
+    ret += HPDF_Stream_WriteStr (stream,
                 "/CIDInit /ProcSet findresource begin\r\n\r\n");
 
     /* Adobe CMap and CIDFont Files Specification recommends to allocate
      * five more elements to this dictionary than existing elements.
      */
-    ret += HPDF_Stream_WriteStr (cmap->stream, "12 dict begin\r\n\r\n");
+    ret += HPDF_Stream_WriteStr (stream, "12 dict begin\r\n\r\n");
 
-    ret += HPDF_Stream_WriteStr (cmap->stream, "begincmap\r\n\r\n");
-    ret += HPDF_Stream_WriteStr (cmap->stream,
+    ret += HPDF_Stream_WriteStr (stream, "begincmap\r\n\r\n");
+    ret += HPDF_Stream_WriteStr (stream,
                 "/CIDSystemInfo 3 dict dup begin\r\n");
 
     pbuf = (char *)HPDF_StrCpy (buf, "  /Registry (", eptr);
     pbuf = (char *)HPDF_StrCpy (pbuf, attr->registry, eptr);
     HPDF_StrCpy (pbuf, ") def\r\n", eptr);
-    ret += HPDF_Stream_WriteStr (cmap->stream, buf);
+    ret += HPDF_Stream_WriteStr (stream, buf);
 
     pbuf = (char *)HPDF_StrCpy (buf, "  /Ordering (", eptr);
     pbuf = (char *)HPDF_StrCpy (pbuf, attr->ordering, eptr);
     HPDF_StrCpy (pbuf, ") def\r\n", eptr);
-    ret += HPDF_Stream_WriteStr (cmap->stream, buf);
+    ret += HPDF_Stream_WriteStr (stream, buf);
 
     pbuf = (char *)HPDF_StrCpy (buf, "  /Supplement ", eptr);
     pbuf = HPDF_IToA (pbuf, attr->suppliment, eptr);
     pbuf = (char *)HPDF_StrCpy (pbuf, " def\r\n", eptr);
     HPDF_StrCpy (pbuf, "end def\r\n\r\n", eptr);
-    ret += HPDF_Stream_WriteStr (cmap->stream, buf);
+    ret += HPDF_Stream_WriteStr (stream, buf);
 
     pbuf = (char *)HPDF_StrCpy (buf, "/CMapName /", eptr);
     pbuf = (char *)HPDF_StrCpy (pbuf, encoder->name, eptr);
     HPDF_StrCpy (pbuf, " def\r\n", eptr);
-    ret += HPDF_Stream_WriteStr (cmap->stream, buf);
+    ret += HPDF_Stream_WriteStr (stream, buf);
 
-    ret += HPDF_Stream_WriteStr (cmap->stream, "/CMapVersion 1.0 def\r\n");
-    ret += HPDF_Stream_WriteStr (cmap->stream, "/CMapType 1 def\r\n\r\n");
+    ret += HPDF_Stream_WriteStr (stream, "/CMapVersion 1.0 def\r\n");
+    ret += HPDF_Stream_WriteStr (stream, "/CMapType 1 def\r\n\r\n");
 
     if (attr->uid_offset >= 0) {
         pbuf = (char *)HPDF_StrCpy (buf, "/UIDOffset ", eptr);
         pbuf = HPDF_IToA (pbuf, attr->uid_offset, eptr);
         HPDF_StrCpy (pbuf, " def\r\n\r\n", eptr);
-        ret += HPDF_Stream_WriteStr (cmap->stream, buf);
+        ret += HPDF_Stream_WriteStr (stream, buf);
     }
 
     pbuf = (char *)HPDF_StrCpy (buf, "/XUID [", eptr);
@@ -976,17 +1942,17 @@ CreateCMap  (HPDF_Encoder   encoder,
     *pbuf++ = ' ';
     pbuf = HPDF_IToA (pbuf, attr->xuid[2], eptr);
     HPDF_StrCpy (pbuf, "] def\r\n\r\n", eptr);
-    ret += HPDF_Stream_WriteStr (cmap->stream, buf);
+    ret += HPDF_Stream_WriteStr (stream, buf);
 
     pbuf = (char *)HPDF_StrCpy (buf, "/WMode ", eptr);
     pbuf = HPDF_IToA (pbuf, (HPDF_UINT32)attr->writing_mode, eptr);
     HPDF_StrCpy (pbuf, " def\r\n\r\n", eptr);
-    ret += HPDF_Stream_WriteStr (cmap->stream, buf);
+    ret += HPDF_Stream_WriteStr (stream, buf);
 
     /* add code-space-range */
     pbuf = HPDF_IToA (buf, attr->code_space_range->count, eptr);
     HPDF_StrCpy (pbuf, " begincodespacerange\r\n", eptr);
-    ret += HPDF_Stream_WriteStr (cmap->stream, buf);
+    ret += HPDF_Stream_WriteStr (stream, buf);
 
     for (i = 0; i < attr->code_space_range->count; i++) {
         HPDF_CidRange_Rec *range = HPDF_List_ItemAt (attr->code_space_range,
@@ -996,21 +1962,21 @@ CreateCMap  (HPDF_Encoder   encoder,
 
         HPDF_StrCpy (pbuf, "\r\n", eptr);
 
-        ret += HPDF_Stream_WriteStr (cmap->stream, buf);
+        ret += HPDF_Stream_WriteStr (stream, buf);
 
         if (ret != HPDF_OK)
-            return NULL;
+            return HPDF_Error_GetCode (encoder->error);
     }
 
     HPDF_StrCpy (buf, "endcodespacerange\r\n\r\n", eptr);
-    ret += HPDF_Stream_WriteStr (cmap->stream, buf);
+    ret += HPDF_Stream_WriteStr (stream, buf);
     if (ret != HPDF_OK)
-        return NULL;
+        return HPDF_Error_GetCode (encoder->error);
 
     /* add not-def-range */
     pbuf = HPDF_IToA (buf, attr->notdef_range->count, eptr);
     HPDF_StrCpy (pbuf, " beginnotdefrange\r\n", eptr);
-    ret += HPDF_Stream_WriteStr (cmap->stream, buf);
+    ret += HPDF_Stream_WriteStr (stream, buf);
 
     for (i = 0; i < attr->notdef_range->count; i++) {
         HPDF_CidRange_Rec *range = HPDF_List_ItemAt (attr->notdef_range, i);
@@ -1020,16 +1986,16 @@ CreateCMap  (HPDF_Encoder   encoder,
         pbuf = HPDF_IToA (pbuf, range->cid, eptr);
         HPDF_StrCpy (pbuf, "\r\n", eptr);
 
-        ret += HPDF_Stream_WriteStr (cmap->stream, buf);
+        ret += HPDF_Stream_WriteStr (stream, buf);
 
         if (ret != HPDF_OK)
-            return NULL;
+            return HPDF_Error_GetCode (encoder->error);
     }
 
     HPDF_StrCpy (buf, "endnotdefrange\r\n\r\n", eptr);
-    ret += HPDF_Stream_WriteStr (cmap->stream, buf);
+    ret += HPDF_Stream_WriteStr (stream, buf);
     if (ret != HPDF_OK)
-        return NULL;
+        return HPDF_Error_GetCode (encoder->error);
 
     if (utf_entity_h_to_unicode) {
         // A CMap used in the /ToUnicode entry of a font must use the beginbfchar, endbfchar,
@@ -1039,10 +2005,53 @@ CreateCMap  (HPDF_Encoder   encoder,
         // "Identity-H" encoding created with the UTF-8 encoder, the character codes
         // are already UTF-16BE encoded and we can just the following static mapping.
         // Additionally, a /ToUnicode CMap may not contain a cid-range.
+        HPDF_UINT count = map ? map->count : 0;
+
         pbuf = buf;
-        pbuf = (char *)HPDF_StrCpy (pbuf, "1 beginbfrange\r\n", eptr);
-        pbuf = (char *)HPDF_StrCpy (pbuf, "<0000> <FFFF> <0000>\r\n", eptr);
-        pbuf = (char *)HPDF_StrCpy (pbuf, "endbfrange\r\n", eptr);
+        if (count == 0) {
+            pbuf = (char *)HPDF_StrCpy (pbuf, "1 beginbfrange\r\n", eptr);
+            pbuf = (char *)HPDF_StrCpy (pbuf, "<0000> <FFFF> <0000>\r\n",
+                    eptr);
+            pbuf = (char *)HPDF_StrCpy (pbuf, "endbfrange\r\n", eptr);
+        } else {
+            /* the codes given to supplementary characters map to their
+             * surrogate pairs, the rest of the range stays an identity.
+             */
+            pbuf = (char *)HPDF_StrCpy (pbuf, "2 beginbfrange\r\n", eptr);
+            pbuf = (char *)HPDF_StrCpy (pbuf, "<0000> <D7FF> <0000>\r\n",
+                    eptr);
+            pbuf = (char *)HPDF_StrCpy (pbuf, "<E000> <FFFF> <E000>\r\n",
+                    eptr);
+            HPDF_StrCpy (pbuf, "endbfrange\r\n", eptr);
+            ret += HPDF_Stream_WriteStr (stream, buf);
+
+            for (i = 0; i < count; i++) {
+                HPDF_UINT16 code =
+                        (HPDF_UINT16)(HPDF_SUPPLEMENTARY_CODE_FIRST + i);
+
+                pbuf = buf;
+                if (i % 100 == 0) {
+                    pbuf = HPDF_IToA (pbuf, (count - i < 100) ? count - i :
+                            100, eptr);
+                    pbuf = (char *)HPDF_StrCpy (pbuf, " beginbfchar\r\n",
+                            eptr);
+                }
+
+                pbuf = UINT16ToHex (pbuf, code, eptr, 2);
+                *pbuf++ = ' ';
+                pbuf = UCS4ToUTF16Hex (pbuf, HPDF_Encoder_ToUcs4 (encoder,
+                            map, code), eptr);
+                pbuf = (char *)HPDF_StrCpy (pbuf, "\r\n", eptr);
+
+                if ((i + 1) % 100 == 0 || i + 1 == count)
+                    HPDF_StrCpy (pbuf, "endbfchar\r\n", eptr);
+
+                ret += HPDF_Stream_WriteStr (stream, buf);
+            }
+
+            pbuf = buf;
+            *pbuf = 0;
+        }
     } else {
         /* add cid-range */
         phase = attr->cmap_range->count / 100;
@@ -1052,7 +2061,7 @@ CreateCMap  (HPDF_Encoder   encoder,
         else
             pbuf = HPDF_IToA (buf, odd, eptr);
         HPDF_StrCpy (pbuf, " begincidrange\r\n", eptr);
-        ret += HPDF_Stream_WriteStr (cmap->stream, buf);
+        ret += HPDF_Stream_WriteStr (stream, buf);
 
         for (i = 0; i < attr->cmap_range->count; i++) {
             HPDF_CidRange_Rec *range = HPDF_List_ItemAt (attr->cmap_range, i);
@@ -1062,7 +2071,7 @@ CreateCMap  (HPDF_Encoder   encoder,
             pbuf = HPDF_IToA (pbuf, range->cid, eptr);
             HPDF_StrCpy (pbuf, "\r\n", eptr);
 
-            ret += HPDF_Stream_WriteStr (cmap->stream, buf);
+            ret += HPDF_Stream_WriteStr (stream, buf);
 
             if ((i + 1) %100 == 0) {
                 phase--;
@@ -1075,11 +2084,11 @@ CreateCMap  (HPDF_Encoder   encoder,
 
                 HPDF_StrCpy (pbuf, " begincidrange\r\n", eptr);
 
-                ret += HPDF_Stream_WriteStr (cmap->stream, buf);
+                ret += HPDF_Stream_WriteStr (stream, buf);
             }
 
             if (ret != HPDF_OK)
-                return NULL;
+                return HPDF_Error_GetCode (encoder->error);
         }
 
         pbuf = buf;
@@ -1094,11 +2103,11 @@ CreateCMap  (HPDF_Encoder   encoder,
     pbuf = (char *)HPDF_StrCpy (pbuf, "end\r\n\r\n", eptr);
     pbuf = (char *)HPDF_StrCpy (pbuf, "%%EndResource\r\n", eptr);
     HPDF_StrCpy (pbuf, "%%EOF\r\n", eptr);
-    ret += HPDF_Stream_WriteStr (cmap->stream, buf);
+    ret += HPDF_Stream_WriteStr (stream, buf);
 
     if (ret != HPDF_OK)
-        return NULL;
+        return HPDF_Error_GetCode (encoder->error);
 
-    return cmap;
+    return HPDF_OK;
 }
 
@@ -57,6 +57,13 @@ MeasureText  (HPDF_Font          font,
               HPDF_REAL         *real_width);
 
 
+static HPDF_UINT
+CharWidths  (HPDF_Font          font,
+             const HPDF_BYTE   *text,
+             HPDF_UINT          len,
+             HPDF_TextUnit     *units);
+
+
 HPDF_Font
 HPDF_TTFont_New  (HPDF_MMgr        mmgr,
                   HPDF_FontDef     fontdef,
@@ -106,6 +113,7 @@ HPDF_TTFont_New  (HPDF_MMgr        mmgr,
     attr->writing_mode = HPDF_WMODE_HORIZONTAL;
     attr->text_width_fn = TextWidth;
     attr->measure_text_fn = MeasureText;
+    attr->char_widths_fn = CharWidths;
     attr->fontdef = fontdef;
     attr->encoder = encoder;
     attr->xref = xref;
@@ -135,6 +143,10 @@ HPDF_TTFont_New  (HPDF_MMgr        mmgr,
 
     fontdef_attr = (HPDF_TTFontDefAttr)fontdef->attr;
 
+    /* a single byte font finds its glyphs through the cmap of the font, so
+     * the glyphs of the subset can not be numbered again */
+    fontdef_attr->has_simple_font = HPDF_TRUE;
+
     ret += HPDF_Dict_AddName (font, "Type", "Font");
     ret += HPDF_Dict_AddName (font, "BaseFont", fontdef_attr->base_font);
     ret += HPDF_Dict_AddName (font, "Subtype", "TrueType");
@@ -206,8 +218,8 @@ CreateDescriptor  (HPDF_Font  font)
             if (!font_data)
                 return HPDF_Error_GetCode (font->error);
 
-            if (HPDF_TTFontDef_SaveFontData (font_attr->fontdef,
-                font_data->stream) != HPDF_OK)
+            if (HPDF_TTFontDef_SaveFontFile (font_attr->fontdef,
+                font_data->stream, font->filter) != HPDF_OK)
                 return HPDF_Error_GetCode (font->error);
 
             ret += HPDF_Dict_Add (descriptor, "FontFile2", font_data);
@@ -217,6 +229,7 @@ CreateDescriptor  (HPDF_Font  font)
             ret += HPDF_Dict_AddNumber (font_data, "Length3", 0);
 
             font_data->filter = font->filter;
+            font_data->encoded_filter = def_attr->encoded_filter;
         }
 
         if (ret != HPDF_OK)
@@ -261,16 +274,26 @@ TextWidth  (HPDF_Font         font,
     HPDF_PTRACE ((" HPDF_TTFont_TextWidth\n"));
 
     if (attr->widths) {
-        for (i = 0; i < len; i++) {
-            b = text[i];
-            ret.numchars++;
-            ret.width += CharWidth (font, b);
-
-            if (HPDF_IS_WHITE_SPACE(b)) {
-                ret.numspace++;
-                ret.numwords++;
-            }
+        HPDF_BOOL all_used;
+
+        ret.width = HPDF_Font_SumWidths (attr->widths, attr->used, text, len,
+                &ret.numspace, &all_used);
+
+        /* the widths are set when a character is used the first time */
+        if (!all_used) {
+            for (i = 0; i < len; i++)
+                if (attr->used[text[i]] == 0)
+                    CharWidth (font, text[i]);
+
+            ret.width = HPDF_Font_SumWidths (attr->widths, NULL, text, len,
+                    &ret.numspace, NULL);
         }
+
+        ret.numchars = len;
+        ret.numwords = ret.numspace;
+
+        if (len > 0)
+            b = text[len - 1];
     } else
         HPDF_SetError (font->error, HPDF_FONT_INVALID_WIDTHS_TABLE, 0);
 
@@ -335,6 +358,30 @@ MeasureText (HPDF_Font          font,
 }
 
 
+static HPDF_UINT
+CharWidths  (HPDF_Font          font,
+             const HPDF_BYTE   *text,
+             HPDF_UINT          len,
+             HPDF_TextUnit     *units)
+{
+    HPDF_UINT i;
+
+    HPDF_PTRACE ((" HPDF_TTFont_CharWidths\n"));
+
+    for (i = 0; i < len; i++) {
+        HPDF_BYTE b = text[i];
+
+        units[i].offset = i;
+        units[i].width = CharWidth (font, b);
+        units[i].flags = HPDF_TEXT_UNIT_START;
+        if (HPDF_IS_WHITE_SPACE(b))
+            units[i].flags |= HPDF_TEXT_UNIT_SPACE;
+    }
+
+    return len;
+}
+
+
 static HPDF_STATUS
 OnWrite  (HPDF_Dict    obj,
           HPDF_Stream  stream)
@@ -47,6 +47,13 @@ Type1Font_MeasureText  (HPDF_Font          font,
                         HPDF_REAL         *real_width);
 
 
+static HPDF_UINT
+Type1Font_CharWidths  (HPDF_Font          font,
+                       const HPDF_BYTE   *text,
+                       HPDF_UINT          len,
+                       HPDF_TextUnit     *units);
+
+
 static HPDF_STATUS
 Type1Font_CreateDescriptor  (HPDF_MMgr  mmgr,
                              HPDF_Font  font,
@@ -102,6 +109,7 @@ HPDF_Type1Font_New  (HPDF_MMgr        mmgr,
     attr->writing_mode = HPDF_WMODE_HORIZONTAL;
     attr->text_width_fn = Type1Font_TextWidth;
     attr->measure_text_fn = Type1Font_MeasureText;
+    attr->char_widths_fn = Type1Font_CharWidths;
     attr->fontdef = fontdef;
     attr->encoder = encoder;
     attr->xref = xref;
@@ -251,22 +259,18 @@ Type1Font_TextWidth  (HPDF_Font        font,
 {
     HPDF_FontAttr attr = (HPDF_FontAttr)font->attr;
     HPDF_TextWidth ret = {0, 0, 0, 0};
-    HPDF_UINT i;
     HPDF_BYTE b = 0;
 
     HPDF_PTRACE ((" HPDF_Type1Font_TextWidth\n"));
 
     if (attr->widths) {
-        for (i = 0; i < len; i++) {
-            b = text[i];
-            ret.numchars++;
-            ret.width += attr->widths[b];
-
-            if (HPDF_IS_WHITE_SPACE(b)) {
-                ret.numspace++;
-                ret.numwords++;
-            }
-        }
+        ret.width = HPDF_Font_SumWidths (attr->widths, NULL, text, len,
+                &ret.numspace, NULL);
+        ret.numchars = len;
+        ret.numwords = ret.numspace;
+
+        if (len > 0)
+            b = text[len - 1];
     } else
         HPDF_SetError (font->error, HPDF_FONT_INVALID_WIDTHS_TABLE, 0);
 
@@ -333,6 +337,31 @@ Type1Font_MeasureText (HPDF_Font          font,
 }
 
 
+static HPDF_UINT
+Type1Font_CharWidths  (HPDF_Font          font,
+                       const HPDF_BYTE   *text,
+                       HPDF_UINT          len,
+                       HPDF_TextUnit     *units)
+{
+    HPDF_FontAttr attr = (HPDF_FontAttr)font->attr;
+    HPDF_UINT i;
+
+    HPDF_PTRACE ((" HPDF_Type1Font_CharWidths\n"));
+
+    for (i = 0; i < len; i++) {
+        HPDF_BYTE b = text[i];
+
+        units[i].offset = i;
+        units[i].width = attr->widths[b];
+        units[i].flags = HPDF_TEXT_UNIT_START;
+        if (HPDF_IS_WHITE_SPACE(b))
+            units[i].flags |= HPDF_TEXT_UNIT_SPACE;
+    }
+
+    return len;
+}
+
+
 static HPDF_STATUS
 Type1Font_OnWrite  (HPDF_Dict    obj,
           HPDF_Stream  stream)
@@ -48,6 +48,12 @@ HPDF_CIDFontDef_FreeWidth  (HPDF_FontDef  fontdef)
     HPDF_List_Free (attr->widths);
     attr->widths = NULL;
 
+    if (attr->width_table) {
+        HPDF_FreeMem (fontdef->mmgr, attr->width_table);
+        attr->width_table = NULL;
+        attr->width_table_len = 0;
+    }
+
     fontdef->valid = HPDF_FALSE;
 }
 
@@ -110,17 +116,12 @@ HPDF_CIDFontDef_GetCIDWidth  (HPDF_FontDef  fontdef,
                               HPDF_UINT16    cid)
 {
     HPDF_CIDFontDefAttr attr = (HPDF_CIDFontDefAttr)fontdef->attr;
-    HPDF_UINT i;
 
     HPDF_PTRACE ((" HPDF_CIDFontDef_GetCIDWidth\n"));
 
-    for (i = 0; i < attr->widths->count; i++) {
-        HPDF_CID_Width *w = (HPDF_CID_Width *)HPDF_List_ItemAt (attr->widths,
-                i);
-
-        if (w->cid == cid)
-            return w->width;
-    }
+    if (cid < attr->width_table_len &&
+            attr->width_table[cid] != HPDF_CID_WIDTH_NONE)
+        return attr->width_table[cid];
 
     /* Not found in pdf_cid_width array. */
     return attr->DW;
@@ -144,8 +145,38 @@ HPDF_CIDFontDef_AddWidth  (HPDF_FontDef            fontdef,
 {
     HPDF_CIDFontDefAttr attr = (HPDF_CIDFontDefAttr)fontdef->attr;
 
+    const HPDF_CID_Width *pw;
+    HPDF_UINT len = attr->width_table_len;
+
     HPDF_PTRACE ((" HPDF_CIDFontDef_AddWidth\n"));
 
+    /* grow the table of widths indexed by CID to the largest CID */
+    for (pw = widths; pw->cid != 0xFFFF; pw++) {
+        if (pw->cid >= len)
+            len = (HPDF_UINT)pw->cid + 1;
+    }
+
+    if (len > attr->width_table_len) {
+        HPDF_INT16 *table = HPDF_GetMem (fontdef->mmgr,
+                sizeof(HPDF_INT16) * len);
+        HPDF_UINT i;
+
+        if (!table)
+            return fontdef->error->error_no;
+
+        if (attr->width_table) {
+            HPDF_MemCpy ((HPDF_BYTE *)table, (HPDF_BYTE *)attr->width_table,
+                    sizeof(HPDF_INT16) * attr->width_table_len);
+            HPDF_FreeMem (fontdef->mmgr, attr->width_table);
+        }
+
+        for (i = attr->width_table_len; i < len; i++)
+            table[i] = HPDF_CID_WIDTH_NONE;
+
+        attr->width_table = table;
+        attr->width_table_len = len;
+    }
+
     while (widths->cid != 0xFFFF) {
         HPDF_CID_Width *w = HPDF_GetMem (fontdef->mmgr,
                 sizeof (HPDF_CID_Width));
@@ -163,6 +194,10 @@ HPDF_CIDFontDef_AddWidth  (HPDF_FontDef            fontdef,
             return ret;
         }
 
+        /* the first width given for a CID is the one used */
+        if (attr->width_table[w->cid] == HPDF_CID_WIDTH_NONE)
+            attr->width_table[w->cid] = w->width;
+
         widths++;
     }
 
@@ -410,65 +410,28 @@ SimHei_BoldItalic_Init  (HPDF_FontDef   fontdef)
 }
 
 
-HPDF_EXPORT(HPDF_STATUS)
-HPDF_UseCNSFonts   (HPDF_Doc   pdf)
-{
-    HPDF_FontDef fontdef;
-    HPDF_STATUS ret;
-
-    if (!HPDF_HasDoc (pdf))
-        return HPDF_INVALID_DOCUMENT;
-
+static const HPDF_CIDFontDefEntry_Rec CNS_FONTDEFS[] = {
     /* SimSun */
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "SimSun",
-                SimSun_Init);
-
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
-
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "SimSun,Bold",
-                SimSun_Bold_Init);
-
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
-
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "SimSun,Italic",
-                SimSun_Italic_Init);
-
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
-
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "SimSun,BoldItalic",
-                SimSun_BoldItalic_Init);
-
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
+    {"SimSun",            SimSun_Init},
+    {"SimSun,Bold",       SimSun_Bold_Init},
+    {"SimSun,Italic",     SimSun_Italic_Init},
+    {"SimSun,BoldItalic", SimSun_BoldItalic_Init},
 
     /* SimHei */
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "SimHei",
-                SimHei_Init);
-
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
-
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "SimHei,Bold",
-                SimHei_Bold_Init);
-
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
-
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "SimHei,Italic",
-                SimHei_Italic_Init);
-
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
+    {"SimHei",            SimHei_Init},
+    {"SimHei,Bold",       SimHei_Bold_Init},
+    {"SimHei,Italic",     SimHei_Italic_Init},
+    {"SimHei,BoldItalic", SimHei_BoldItalic_Init},
+    {NULL, NULL}
+};
 
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "SimHei,BoldItalic",
-                SimHei_BoldItalic_Init);
 
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_UseCNSFonts   (HPDF_Doc   pdf)
+{
+    if (!HPDF_HasDoc (pdf))
+        return HPDF_INVALID_DOCUMENT;
 
-    return HPDF_OK;
+    return HPDF_Doc_RegisterCIDFontDefs (pdf, CNS_FONTDEFS);
 }
 
@@ -214,40 +214,22 @@ MingLiU_BoldItalic_Init  (HPDF_FontDef   fontdef)
 }
 
 
+static const HPDF_CIDFontDefEntry_Rec CNT_FONTDEFS[] = {
+    /* MingLiU */
+    {"MingLiU",            MingLiU_Init},
+    {"MingLiU,Bold",       MingLiU_Bold_Init},
+    {"MingLiU,Italic",     MingLiU_Italic_Init},
+    {"MingLiU,BoldItalic", MingLiU_BoldItalic_Init},
+    {NULL, NULL}
+};
+
+
 HPDF_EXPORT(HPDF_STATUS)
 HPDF_UseCNTFonts   (HPDF_Doc   pdf)
 {
-    HPDF_FontDef fontdef;
-    HPDF_STATUS ret;
-
     if (!HPDF_HasDoc (pdf))
         return HPDF_INVALID_DOCUMENT;
 
-    /* MingLiU */
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "MingLiU",
-                MingLiU_Init);
-
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
-
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "MingLiU,Bold",
-                MingLiU_Bold_Init);
-
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
-
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "MingLiU,Italic",
-                MingLiU_Italic_Init);
-
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
-
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "MingLiU,BoldItalic",
-                MingLiU_BoldItalic_Init);
-
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
-
-    return HPDF_OK;
+    return HPDF_Doc_RegisterCIDFontDefs (pdf, CNT_FONTDEFS);
 }
 
@@ -1793,115 +1793,40 @@ MS_PMincho_BoldItalic_Init  (HPDF_FontDef   fontdef)
 }
 
 
-HPDF_EXPORT(HPDF_STATUS)
-HPDF_UseJPFonts   (HPDF_Doc   pdf)
-{
-    HPDF_FontDef fontdef;
-    HPDF_STATUS ret;
-
-    if (!HPDF_Doc_Validate (pdf))
-        return HPDF_INVALID_DOCUMENT;
-
+static const HPDF_CIDFontDefEntry_Rec JP_FONTDEFS[] = {
     /* MS-Gothic */
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "MS-Gothic",
-                MS_Gothic_Init);
-
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
-
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "MS-Gothic,Bold",
-                MS_Gothic_Bold_Init);
-
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
-
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "MS-Gothic,Italic",
-                MS_Gothic_Italic_Init);
-
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
-
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "MS-Gothic,BoldItalic",
-                MS_Gothic_BoldItalic_Init);
-
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
+    {"MS-Gothic",             MS_Gothic_Init},
+    {"MS-Gothic,Bold",        MS_Gothic_Bold_Init},
+    {"MS-Gothic,Italic",      MS_Gothic_Italic_Init},
+    {"MS-Gothic,BoldItalic",  MS_Gothic_BoldItalic_Init},
 
     /* MS-PGothic */
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "MS-PGothic",
-                MS_PGothic_Init);
-
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
-
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "MS-PGothic,Bold",
-                MS_PGothic_Bold_Init);
-
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
-
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "MS-PGothic,Italic",
-                MS_PGothic_Italic_Init);
-
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
-
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "MS-PGothic,BoldItalic",
-                MS_PGothic_BoldItalic_Init);
-
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
+    {"MS-PGothic",            MS_PGothic_Init},
+    {"MS-PGothic,Bold",       MS_PGothic_Bold_Init},
+    {"MS-PGothic,Italic",     MS_PGothic_Italic_Init},
+    {"MS-PGothic,BoldItalic", MS_PGothic_BoldItalic_Init},
 
     /* MS-Mincho */
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "MS-Mincho",
-                MS_Mincho_Init);
-
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
-
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "MS-Mincho,Bold",
-                MS_Mincho_Bold_Init);
-
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
-
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "MS-Mincho,Italic",
-                MS_Mincho_Italic_Init);
-
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
-
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "MS-Mincho,BoldItalic",
-                MS_Mincho_BoldItalic_Init);
-
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
+    {"MS-Mincho",             MS_Mincho_Init},
+    {"MS-Mincho,Bold",        MS_Mincho_Bold_Init},
+    {"MS-Mincho,Italic",      MS_Mincho_Italic_Init},
+    {"MS-Mincho,BoldItalic",  MS_Mincho_BoldItalic_Init},
 
     /* MS-PMincho */
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "MS-PMincho",
-                MS_PMincho_Init);
-
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
-
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "MS-PMincho,Bold",
-                MS_PMincho_Bold_Init);
-
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
-
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "MS-PMincho,Italic",
-                MS_PMincho_Italic_Init);
-
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
+    {"MS-PMincho",            MS_PMincho_Init},
+    {"MS-PMincho,Bold",       MS_PMincho_Bold_Init},
+    {"MS-PMincho,Italic",     MS_PMincho_Italic_Init},
+    {"MS-PMincho,BoldItalic", MS_PMincho_BoldItalic_Init},
+    {NULL, NULL}
+};
 
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "MS-PMincho,BoldItalic",
-                MS_PMincho_BoldItalic_Init);
 
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_UseJPFonts   (HPDF_Doc   pdf)
+{
+    if (!HPDF_Doc_Validate (pdf))
+        return HPDF_INVALID_DOCUMENT;
 
-    return HPDF_OK;
+    return HPDF_Doc_RegisterCIDFontDefs (pdf, JP_FONTDEFS);
 }
 
@@ -1461,115 +1461,40 @@ Batang_BoldItalic_Init  (HPDF_FontDef   fontdef)
 }
 
 
-HPDF_EXPORT(HPDF_STATUS)
-HPDF_UseKRFonts   (HPDF_Doc   pdf)
-{
-    HPDF_FontDef fontdef;
-    HPDF_STATUS ret;
-
-    if (!HPDF_HasDoc (pdf))
-        return HPDF_INVALID_DOCUMENT;
-
+static const HPDF_CIDFontDefEntry_Rec KR_FONTDEFS[] = {
     /* DotumChe */
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "DotumChe",
-                DotumChe_Init);
-
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
-
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "DotumChe,Bold",
-                DotumChe_Bold_Init);
-
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
-
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "DotumChe,Italic",
-                DotumChe_Italic_Init);
-
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
-
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "DotumChe,BoldItalic",
-                DotumChe_BoldItalic_Init);
-
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
+    {"DotumChe",             DotumChe_Init},
+    {"DotumChe,Bold",        DotumChe_Bold_Init},
+    {"DotumChe,Italic",      DotumChe_Italic_Init},
+    {"DotumChe,BoldItalic",  DotumChe_BoldItalic_Init},
 
     /* Dotum */
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "Dotum",
-                Dotum_Init);
-
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
-
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "Dotum,Bold",
-                Dotum_Bold_Init);
-
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
-
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "Dotum,Italic",
-                Dotum_Italic_Init);
-
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
-
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "Dotum,BoldItalic",
-                Dotum_BoldItalic_Init);
-
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
+    {"Dotum",                Dotum_Init},
+    {"Dotum,Bold",           Dotum_Bold_Init},
+    {"Dotum,Italic",         Dotum_Italic_Init},
+    {"Dotum,BoldItalic",     Dotum_BoldItalic_Init},
 
     /* BatangChe */
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "BatangChe",
-                BatangChe_Init);
-
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
-
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "BatangChe,Bold",
-                BatangChe_Bold_Init);
-
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
-
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "BatangChe,Italic",
-                BatangChe_Italic_Init);
-
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
-
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "BatangChe,BoldItalic",
-                BatangChe_BoldItalic_Init);
-
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
+    {"BatangChe",            BatangChe_Init},
+    {"BatangChe,Bold",       BatangChe_Bold_Init},
+    {"BatangChe,Italic",     BatangChe_Italic_Init},
+    {"BatangChe,BoldItalic", BatangChe_BoldItalic_Init},
 
     /* Batang */
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "Batang",
-                Batang_Init);
-
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
-
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "Batang,Bold",
-                Batang_Bold_Init);
-
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
-
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "Batang,Italic",
-                Batang_Italic_Init);
-
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
+    {"Batang",               Batang_Init},
+    {"Batang,Bold",          Batang_Bold_Init},
+    {"Batang,Italic",        Batang_Italic_Init},
+    {"Batang,BoldItalic",    Batang_BoldItalic_Init},
+    {NULL, NULL}
+};
 
-    fontdef = HPDF_CIDFontDef_New (pdf->mmgr,  "Batang,BoldItalic",
-                Batang_BoldItalic_Init);
 
-    if ((ret = HPDF_Doc_RegisterFontDef (pdf, fontdef)) != HPDF_OK)
-        return ret;
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_UseKRFonts   (HPDF_Doc   pdf)
+{
+    if (!HPDF_HasDoc (pdf))
+        return HPDF_INVALID_DOCUMENT;
 
-    return HPDF_OK;
+    return HPDF_Doc_RegisterCIDFontDefs (pdf, KR_FONTDEFS);
 }
 
@@ -19,6 +19,14 @@
 #include "hpdf_conf.h"
 #include "hpdf_utils.h"
 #include "hpdf_fontdef.h"
+#include "hpdf_lock.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
 
 
 #define HPDF_TTF_MAX_MEM_SIZ    10000
@@ -42,6 +50,86 @@ static const char * const REQUIRED_TAGS[HPDF_REQUIRED_TAGS_COUNT] = {
 };
 
 
+/*----- font cache ----------------------------------------------------------*/
+
+#define HPDF_TTF_MAX_CACHED_SUBSETS  32
+
+typedef struct _HPDF_TTFontSubset_Rec  *HPDF_TTFontSubset;
+
+/* the finished font data of a subset of a cached font, as it is written to
+ * the FontFile2 stream. it is found again by the glyphs used, the tag of
+ * the font name and the filters the data is encoded with.
+ */
+typedef struct _HPDF_TTFontSubset_Rec {
+    HPDF_TTFontSubset       next;
+    HPDF_UINT32             hash;
+    HPDF_BYTE              *flgs;
+    char                    tag_name[HPDF_TTF_FONT_TAG_LEN + 1];
+    HPDF_BOOL               compact;
+    HPDF_UINT               filter;
+    HPDF_UINT               length1;
+    HPDF_BYTE              *data;
+    HPDF_UINT               size;
+} HPDF_TTFontSubset_Rec;
+
+typedef struct _HPDF_TTFontCacheEntry_Rec  *HPDF_TTFontCacheEntry;
+
+/* one parsed font file, shared by the documents which use the font cache.
+ * each entry has its own memory manager, so that it does not depend on the
+ * document which loaded it first.
+ */
+typedef struct _HPDF_TTFontCacheEntry_Rec {
+    HPDF_TTFontCacheEntry   next;
+    char                   *file_name;
+    HPDF_INT                index;
+    HPDF_UINT               ref_count;
+    HPDF_Error_Rec          error;
+    HPDF_MMgr               mmgr;
+    HPDF_FontDef            fontdef;
+    HPDF_TTFontSubset       subsets;
+    HPDF_UINT               num_subsets;
+} HPDF_TTFontCacheEntry_Rec;
+
+static HPDF_TTFontCacheEntry cache_entries = NULL;
+
+/* the lock guards the list of entries and their reference counts */
+static HPDF_Lock cache_lock = HPDF_LOCK_INIT;
+#define HPDF_CACHE_LOCK()    HPDF_Lock_Acquire (&cache_lock)
+#define HPDF_CACHE_UNLOCK()  HPDF_Lock_Release (&cache_lock)
+
+
+/*----- saving font data on worker threads ----------------------------------*/
+
+#define HPDF_TTF_MAX_SAVE_THREADS  16
+
+/* the font data of one font definition saved by a worker thread. the job
+ * has its own memory manager and error object, since the ones of the
+ * document can be used by one thread only.
+ */
+typedef struct _HPDF_TTFontSaveJob_Rec {
+    HPDF_FontDef            fontdef;
+    HPDF_UINT               filter;
+    HPDF_Error_Rec          error;
+    HPDF_MMgr               mmgr;
+    HPDF_Stream             stream;
+    HPDF_STATUS             ret;
+} HPDF_TTFontSaveJob_Rec;
+
+typedef struct _HPDF_TTFontSaveJob_Rec  *HPDF_TTFontSaveJob;
+
+typedef struct _HPDF_TTFontSavePool_Rec {
+    HPDF_TTFontSaveJob     *jobs;
+    HPDF_UINT               count;
+#if defined(_WIN32)
+    volatile LONG           next;
+#else
+    HPDF_UINT               next;
+    pthread_mutex_t         lock;
+#endif
+} HPDF_TTFontSavePool_Rec;
+
+typedef struct _HPDF_TTFontSavePool_Rec  *HPDF_TTFontSavePool;
+
 static void
 FreeFunc (HPDF_FontDef  fontdef);
 
@@ -136,6 +224,11 @@ ParseCMAP_format4  (HPDF_FontDef  fontdef,
                     HPDF_UINT32   offset);
 
 
+static HPDF_STATUS
+ParseCMAP_format12  (HPDF_FontDef  fontdef,
+                     HPDF_UINT32   offset);
+
+
 static HPDF_STATUS
 ParseHmtx  (HPDF_FontDef  fontdef);
 
@@ -167,6 +260,19 @@ static void
 CleanFunc (HPDF_FontDef   fontdef);
 
 
+static void
+ReleaseCacheEntry  (HPDF_TTFontCacheEntry  entry);
+
+
+static void
+FreeSaveJob  (HPDF_FontDef         fontdef,
+              HPDF_TTFontSaveJob   job);
+
+
+static HPDF_STATUS
+CreateGidMap  (HPDF_FontDef   fontdef);
+
+
 static HPDF_STATUS
 CheckCompositGryph  (HPDF_FontDef   fontdef,
                      HPDF_UINT16    gid);
@@ -194,6 +300,10 @@ static void
 CleanFunc (HPDF_FontDef   fontdef)
 {
     HPDF_TTFontDefAttr attr = (HPDF_TTFontDefAttr)fontdef->attr;
+
+    FreeSaveJob (fontdef, attr->save_job);
+    attr->save_job = NULL;
+
     HPDF_MemSet (attr->glyph_tbl.flgs, 0,
             sizeof (HPDF_BYTE) * attr->num_glyphs);
     attr->glyph_tbl.flgs[0] = 1;
@@ -205,7 +315,23 @@ InitAttr (HPDF_FontDef  fontdef)
 {
     HPDF_TTFontDefAttr attr = (HPDF_TTFontDefAttr)fontdef->attr;
 
-    if (attr) {
+    if (attr)
+        FreeSaveJob (fontdef, attr->save_job);
+
+    if (attr && attr->cache_entry) {
+        /* the tables belong to the cache entry */
+        if (attr->glyph_tbl.flgs)
+            HPDF_FreeMem (fontdef->mmgr, attr->glyph_tbl.flgs);
+
+        if (attr->gid_map)
+            HPDF_FreeMem (fontdef->mmgr, attr->gid_map);
+
+        if (attr->stream)
+            HPDF_Stream_Free (attr->stream);
+
+        ReleaseCacheEntry (attr->cache_entry);
+        HPDF_MemSet (attr, 0, sizeof(HPDF_TTFontDefAttr_Rec));
+    } else if (attr) {
         if (attr->char_set)
             HPDF_FreeMem (fontdef->mmgr, attr->char_set);
 
@@ -230,6 +356,9 @@ InitAttr (HPDF_FontDef  fontdef)
         if (attr->cmap.glyph_id_array)
             HPDF_FreeMem (fontdef->mmgr, attr->cmap.glyph_id_array);
 
+        if (attr->cmap.groups)
+            HPDF_FreeMem (fontdef->mmgr, attr->cmap.groups);
+
         if (attr->offset_tbl.table)
             HPDF_FreeMem (fontdef->mmgr, attr->offset_tbl.table);
 
@@ -239,6 +368,9 @@ InitAttr (HPDF_FontDef  fontdef)
         if (attr->glyph_tbl.offsets)
             HPDF_FreeMem (fontdef->mmgr, attr->glyph_tbl.offsets);
 
+        if (attr->gid_map)
+            HPDF_FreeMem (fontdef->mmgr, attr->gid_map);
+
         if (attr->stream)
             HPDF_Stream_Free (attr->stream);
     }
@@ -337,6 +469,215 @@ HPDF_TTFontDef_Load2  (HPDF_MMgr     mmgr,
 }
 
 
+static void
+FreeCacheEntry  (HPDF_TTFontCacheEntry  entry)
+{
+    while (entry->subsets) {
+        HPDF_TTFontSubset subset = entry->subsets;
+
+        entry->subsets = subset->next;
+        HPDF_FreeMem (entry->mmgr, subset);
+    }
+
+    if (entry->fontdef)
+        HPDF_FontDef_Free (entry->fontdef);
+
+    if (entry->file_name)
+        HPDF_FreeMem (entry->mmgr, entry->file_name);
+
+    if (entry->mmgr)
+        HPDF_MMgr_Free (entry->mmgr);
+
+    HPDF_FREE (entry);
+}
+
+
+/* parses a font file into a new cache entry with the stream closed, the
+ * documents open the file again when they embed the font.
+ */
+static HPDF_TTFontCacheEntry
+NewCacheEntry  (HPDF_Error    error,
+                const char   *file_name,
+                HPDF_INT      index)
+{
+    HPDF_TTFontCacheEntry entry;
+    HPDF_Stream stream;
+    HPDF_UINT len = HPDF_StrLen (file_name, -1);
+
+    entry = HPDF_MALLOC (sizeof(HPDF_TTFontCacheEntry_Rec));
+    if (!entry) {
+        HPDF_SetError (error, HPDF_FAILD_TO_ALLOC_MEM, 0);
+        return NULL;
+    }
+
+    HPDF_MemSet (entry, 0, sizeof(HPDF_TTFontCacheEntry_Rec));
+    HPDF_Error_Init (&entry->error, NULL);
+    entry->index = index;
+
+    entry->mmgr = HPDF_MMgr_New (&entry->error, 0, NULL, NULL);
+    if (entry->mmgr)
+        entry->file_name = HPDF_GetMem (entry->mmgr, len + 1);
+
+    if (entry->file_name) {
+        HPDF_MemCpy ((HPDF_BYTE *)entry->file_name, (HPDF_BYTE *)file_name,
+                len + 1);
+
+        stream = HPDF_MappedFileReader_New (entry->mmgr, file_name);
+        if (stream) {
+            if (index < 0)
+                entry->fontdef = HPDF_TTFontDef_Load (entry->mmgr, stream,
+                        HPDF_FALSE);
+            else
+                entry->fontdef = HPDF_TTFontDef_Load2 (entry->mmgr, stream,
+                        (HPDF_UINT)index, HPDF_FALSE);
+        }
+    }
+
+    if (!entry->fontdef) {
+        HPDF_STATUS error_no = entry->error.error_no;
+
+        HPDF_SetError (error, error_no ? error_no : HPDF_FAILD_TO_ALLOC_MEM,
+                entry->error.detail_no);
+        FreeCacheEntry (entry);
+        return NULL;
+    }
+
+    return entry;
+}
+
+
+static void
+ReleaseCacheEntry  (HPDF_TTFontCacheEntry  entry)
+{
+    HPDF_CACHE_LOCK ();
+    entry->ref_count--;
+    HPDF_CACHE_UNLOCK ();
+}
+
+
+HPDF_FontDef
+HPDF_TTFontDef_LoadCached  (HPDF_MMgr     mmgr,
+                            const char   *file_name,
+                            HPDF_INT      index,
+                            HPDF_BOOL     embedding)
+{
+    HPDF_TTFontCacheEntry entry;
+    HPDF_FontDef fontdef;
+    HPDF_TTFontDefAttr attr;
+    HPDF_TTFontDefAttr src_attr;
+
+    HPDF_PTRACE ((" HPDF_TTFontDef_LoadCached\n"));
+
+    if (!file_name) {
+        HPDF_SetError (mmgr->error, HPDF_INVALID_PARAMETER, 0);
+        return NULL;
+    }
+
+    /* the file is parsed while holding the lock, so that two documents
+     * asking for the same font at the same time parse it once.
+     */
+    HPDF_CACHE_LOCK ();
+
+    entry = cache_entries;
+    while (entry) {
+        if (entry->index == index &&
+                HPDF_StrCmp (entry->file_name, file_name) == 0)
+            break;
+        entry = entry->next;
+    }
+
+    if (!entry) {
+        entry = NewCacheEntry (mmgr->error, file_name, index);
+        if (entry) {
+            entry->next = cache_entries;
+            cache_entries = entry;
+        }
+    }
+
+    if (entry)
+        entry->ref_count++;
+
+    HPDF_CACHE_UNLOCK ();
+
+    if (!entry)
+        return NULL;
+
+    /* the document gets a copy of the font definition which points to the
+     * shared tables, with its own table of used glyphs and stream.
+     */
+    fontdef = HPDF_TTFontDef_New (mmgr);
+    if (!fontdef) {
+        ReleaseCacheEntry (entry);
+        return NULL;
+    }
+
+    attr = (HPDF_TTFontDefAttr)fontdef->attr;
+    src_attr = (HPDF_TTFontDefAttr)entry->fontdef->attr;
+
+    HPDF_MemCpy ((HPDF_BYTE *)fontdef, (HPDF_BYTE *)entry->fontdef,
+            sizeof(HPDF_FontDef_Rec));
+    fontdef->mmgr = mmgr;
+    fontdef->error = mmgr->error;
+    fontdef->descriptor = NULL;
+    fontdef->data = NULL;
+    fontdef->attr = attr;
+
+    HPDF_MemCpy ((HPDF_BYTE *)attr, (HPDF_BYTE *)src_attr,
+            sizeof(HPDF_TTFontDefAttr_Rec));
+    attr->glyph_tbl.flgs = NULL;
+    attr->gid_map = NULL;
+    attr->stream = NULL;
+    attr->save_job = NULL;
+    attr->embedding = embedding;
+    attr->cache_entry = entry;
+
+    attr->glyph_tbl.flgs = HPDF_GetMem (mmgr,
+            sizeof (HPDF_BYTE) * attr->num_glyphs);
+    if (!attr->glyph_tbl.flgs) {
+        HPDF_FontDef_Free (fontdef);
+        return NULL;
+    }
+
+    HPDF_MemSet (attr->glyph_tbl.flgs, 0,
+            sizeof (HPDF_BYTE) * attr->num_glyphs);
+    attr->glyph_tbl.flgs[0] = 1;
+
+    if (embedding) {
+        attr->stream = HPDF_MappedFileReader_New (mmgr, file_name);
+        if (!attr->stream) {
+            HPDF_FontDef_Free (fontdef);
+            return NULL;
+        }
+    }
+
+    return fontdef;
+}
+
+
+void
+HPDF_TTFontDef_FreeCache  (void)
+{
+    HPDF_TTFontCacheEntry *pentry;
+
+    HPDF_PTRACE ((" HPDF_TTFontDef_FreeCache\n"));
+
+    HPDF_CACHE_LOCK ();
+
+    pentry = &cache_entries;
+    while (*pentry) {
+        HPDF_TTFontCacheEntry entry = *pentry;
+
+        if (entry->ref_count == 0) {
+            *pentry = entry->next;
+            FreeCacheEntry (entry);
+        } else
+            pentry = &entry->next;
+    }
+
+    HPDF_CACHE_UNLOCK ();
+}
+
+
 #ifdef HPDF_TTF_DEBUG
 static void
 DumpTable (HPDF_FontDef   fontdef)
@@ -582,6 +923,9 @@ HPDF_TTFontDef_GetCharBBox  (HPDF_FontDef   fontdef,
 }
 
 
+/* fields of fonts held in memory are taken from the buffer directly, other
+ * streams are read through HPDF_Stream_Read.
+ */
 static HPDF_STATUS
 GetUINT32 (HPDF_Stream         stream,
            HPDF_UINT32         *value)
@@ -589,6 +933,19 @@ GetUINT32 (HPDF_Stream         stream,
     HPDF_STATUS ret;
     HPDF_UINT size = sizeof (HPDF_UINT32);
 
+    if (stream->type == HPDF_STREAM_BUFFER) {
+        HPDF_BufferReaderAttr src = (HPDF_BufferReaderAttr)stream->attr;
+
+        if (src->size - src->pos >= 4) {
+            const HPDF_BYTE *p = src->buf + src->pos;
+
+            *value = (HPDF_UINT32)((HPDF_UINT32)p[0] << 24 | (HPDF_UINT32)p[1] << 16 |
+                    (HPDF_UINT32)p[2] << 8 | p[3]);
+            src->pos += 4;
+            return HPDF_OK;
+        }
+    }
+
     ret = HPDF_Stream_Read (stream, (HPDF_BYTE *)value, &size);
     if (ret != HPDF_OK) {
         *value = 0;
@@ -608,6 +965,18 @@ GetUINT16 (HPDF_Stream         stream,
     HPDF_STATUS ret;
     HPDF_UINT size = sizeof (HPDF_UINT16);
 
+    if (stream->type == HPDF_STREAM_BUFFER) {
+        HPDF_BufferReaderAttr src = (HPDF_BufferReaderAttr)stream->attr;
+
+        if (src->size - src->pos >= 2) {
+            const HPDF_BYTE *p = src->buf + src->pos;
+
+            *value = (HPDF_UINT16)(p[0] << 8 | p[1]);
+            src->pos += 2;
+            return HPDF_OK;
+        }
+    }
+
     ret = HPDF_Stream_Read (stream, (HPDF_BYTE *)value, &size);
     if (ret != HPDF_OK) {
         *value = 0;
@@ -627,6 +996,18 @@ GetINT16 (HPDF_Stream    stream,
     HPDF_STATUS ret;
     HPDF_UINT size = sizeof (HPDF_INT16);
 
+    if (stream->type == HPDF_STREAM_BUFFER) {
+        HPDF_BufferReaderAttr src = (HPDF_BufferReaderAttr)stream->attr;
+
+        if (src->size - src->pos >= 2) {
+            const HPDF_BYTE *p = src->buf + src->pos;
+
+            *value = (HPDF_INT16)(p[0] << 8 | p[1]);
+            src->pos += 2;
+            return HPDF_OK;
+        }
+    }
+
     ret = HPDF_Stream_Read (stream, (HPDF_BYTE *)value, &size);
     if (ret != HPDF_OK) {
         *value = 0;
@@ -875,6 +1256,7 @@ ParseCMap (HPDF_FontDef  fontdef)
     HPDF_UINT i;
     HPDF_UINT32 ms_unicode_encoding_offset = 0;
     HPDF_UINT32 byte_encoding_offset = 0;
+    HPDF_UINT32 full_unicode_encoding_offset = 0;
 
     HPDF_PTRACE ((" HPDF_TTFontDef_ParseCMap\n"));
 
@@ -927,10 +1309,15 @@ ParseCMap (HPDF_FontDef  fontdef)
                         encodingID, format, (HPDF_UINT)offset));
 
         /* MS-Unicode-CMAP is used for priority */
-        if (platformID == 3 && encodingID == 1 && format == 4) {
+        if (platformID == 3 && encodingID == 1 && format == 4 &&
+                ms_unicode_encoding_offset == 0)
             ms_unicode_encoding_offset = offset;
-            break;
-        }
+
+        /* a format 12 subtable adds the characters outside the BMP */
+        if (format == 12 && ((platformID == 3 && encodingID == 10) ||
+                (platformID == 0 && (encodingID == 4 || encodingID == 6))) &&
+                full_unicode_encoding_offset == 0)
+            full_unicode_encoding_offset = offset;
 
         /* Byte-Encoding-CMAP will be used if MS-Unicode-CMAP is not found */
         if (platformID == 1 && encodingID ==0 && format == 1)
@@ -941,6 +1328,20 @@ ParseCMap (HPDF_FontDef  fontdef)
            return ret;
     }
 
+    if (full_unicode_encoding_offset != 0) {
+        HPDF_PTRACE((" found full unicode cmap.\n"));
+        ret = ParseCMAP_format12(fontdef, full_unicode_encoding_offset +
+                tbl->offset);
+        if (ret != HPDF_OK)
+            return ret;
+
+        /* the BMP is looked up in the format 4 subtable if there is one */
+        if (ms_unicode_encoding_offset == 0) {
+            attr->cmap.format = 12;
+            return HPDF_OK;
+        }
+    }
+
     if (ms_unicode_encoding_offset != 0) {
         HPDF_PTRACE((" found microsoft unicode cmap.\n"));
         ret = ParseCMAP_format4(fontdef, ms_unicode_encoding_offset +
@@ -1126,17 +1527,128 @@ ParseCMAP_format4  (HPDF_FontDef  fontdef,
 }
 
 
+static HPDF_STATUS
+ParseCMAP_format12  (HPDF_FontDef  fontdef,
+                     HPDF_UINT32   offset)
+{
+    HPDF_TTFontDefAttr attr = (HPDF_TTFontDefAttr)fontdef->attr;
+    HPDF_STATUS ret;
+    HPDF_UINT16 format;
+    HPDF_UINT16 reserved;
+    HPDF_UINT32 length;
+    HPDF_UINT32 language;
+    HPDF_UINT32 num_groups;
+    HPDF_TTF_CmapGroup *pgroup;
+    HPDF_UINT i;
+
+    HPDF_PTRACE((" ParseCMAP_format12\n"));
+
+    if ((ret = HPDF_Stream_Seek (attr->stream, offset, HPDF_SEEK_SET)) !=
+            HPDF_OK)
+        return ret;
+
+    ret += GetUINT16 (attr->stream, &format);
+    ret += GetUINT16 (attr->stream, &reserved);
+    ret += GetUINT32 (attr->stream, &length);
+    ret += GetUINT32 (attr->stream, &language);
+    ret += GetUINT32 (attr->stream, &num_groups);
+
+    if (ret != HPDF_OK)
+        return HPDF_Error_GetCode (fontdef->error);
+
+    if (format != 12 || length < 16 || num_groups > (length - 16) / 12)
+        return HPDF_SetError (fontdef->error, HPDF_TTF_INVALID_CMAP, 0);
+
+    if (num_groups == 0)
+        return HPDF_OK;
+
+    attr->cmap.groups = HPDF_GetMem (fontdef->mmgr,
+            sizeof(HPDF_TTF_CmapGroup) * num_groups);
+    if (!attr->cmap.groups)
+        return HPDF_Error_GetCode (fontdef->error);
+
+    /* adjacent groups which continue each other are merged, so that the
+     * index stays as small as possible.
+     */
+    pgroup = attr->cmap.groups;
+    for (i = 0; i < num_groups; i++) {
+        HPDF_TTF_CmapGroup group;
+
+        ret += GetUINT32 (attr->stream, &group.start_code);
+        ret += GetUINT32 (attr->stream, &group.end_code);
+        ret += GetUINT32 (attr->stream, &group.start_glyph_id);
+        if (ret != HPDF_OK)
+            return HPDF_Error_GetCode (fontdef->error);
+
+        if (group.start_code > group.end_code || (pgroup >
+                attr->cmap.groups && group.start_code <= pgroup[-1].end_code))
+            return HPDF_SetError (fontdef->error, HPDF_TTF_INVALID_CMAP, 0);
+
+        if (pgroup > attr->cmap.groups &&
+                group.start_code == pgroup[-1].end_code + 1 &&
+                group.start_glyph_id == pgroup[-1].start_glyph_id +
+                (group.start_code - pgroup[-1].start_code))
+            pgroup[-1].end_code = group.end_code;
+        else
+            *pgroup++ = group;
+    }
+
+    attr->cmap.num_groups = (HPDF_UINT)(pgroup - attr->cmap.groups);
+
+    HPDF_PTRACE((" ParseCMAP_format12 %u groups, %u after merging\n",
+                (HPDF_UINT)num_groups, attr->cmap.num_groups));
+
+    return HPDF_OK;
+}
+
+
+static HPDF_UINT16
+GetGlyphidFromGroups  (HPDF_TTFontDefAttr  attr,
+                       HPDF_UINT32         unicode)
+{
+    const HPDF_TTF_CmapGroup *groups = attr->cmap.groups;
+    HPDF_UINT lo = 0;
+    HPDF_UINT hi = attr->cmap.num_groups;
+    HPDF_UINT32 gid;
+
+    /* search the first group which ends at or after the character */
+    while (lo < hi) {
+        HPDF_UINT mid = (lo + hi) / 2;
+
+        if (groups[mid].end_code < unicode)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo == attr->cmap.num_groups || groups[lo].start_code > unicode)
+        return 0;
+
+    gid = groups[lo].start_glyph_id + (unicode - groups[lo].start_code);
+    if (gid > 0xFFFF)
+        return 0;
+
+    return (HPDF_UINT16)gid;
+}
+
+
 HPDF_UINT16
 HPDF_TTFontDef_GetGlyphid  (HPDF_FontDef   fontdef,
-                            HPDF_UINT16    unicode)
+                            HPDF_UINT32    unicode)
 {
     HPDF_TTFontDefAttr attr = (HPDF_TTFontDefAttr)fontdef->attr;
     HPDF_UINT16 *pend_count = attr->cmap.end_count;
     HPDF_UINT seg_count = attr->cmap.seg_count_x2 / 2;
+    HPDF_UINT lo = 0;
+    HPDF_UINT hi = seg_count;
     HPDF_UINT i;
 
     HPDF_PTRACE((" HPDF_TTFontDef_GetGlyphid\n"));
 
+    /* format 12 */
+    if (unicode > 0xFFFF || attr->cmap.format == 12)
+        return GetGlyphidFromGroups (attr, unicode);
+
     /* format 0 */
     if (attr->cmap.format == 0) {
         unicode &= 0xFF;
@@ -1149,10 +1661,23 @@ HPDF_TTFontDef_GetGlyphid  (HPDF_FontDef   fontdef,
         return 0;
     }
 
-    for (i = 0; i < seg_count; i++) {
-        if (unicode <= *pend_count)
-            break;
-        pend_count++;
+    /* the segments are sorted by end code, search the first one which
+     * ends at or after the character.
+     */
+    while (lo < hi) {
+        HPDF_UINT mid = (lo + hi) / 2;
+
+        if (pend_count[mid] < unicode)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    i = lo;
+
+    if (i == seg_count) {
+        HPDF_PTRACE((" HPDF_TTFontDef_GetGlyphid undefined char(0x%04X)\n",
+                    unicode));
+        return 0;
     }
 
     if (attr->cmap.start_count[i] > unicode) {
@@ -1192,9 +1717,22 @@ HPDF_TTFontDef_EmbedAllGlyphs  (HPDF_FontDef  fontdef)
     HPDF_MemSet (attr->glyph_tbl.flgs, 1, sizeof (HPDF_BYTE) * attr->num_glyphs);
 }
 
+
+HPDF_UINT16
+HPDF_TTFontDef_GetSubsetGid  (HPDF_FontDef   fontdef,
+                              HPDF_UINT16    gid)
+{
+    HPDF_TTFontDefAttr attr = (HPDF_TTFontDefAttr)fontdef->attr;
+
+    if (!attr->gid_map)
+        return gid;
+
+    return (gid < attr->num_glyphs) ? attr->gid_map[gid] : 0;
+}
+
 HPDF_INT16
 HPDF_TTFontDef_GetCharWidth  (HPDF_FontDef   fontdef,
-                              HPDF_UINT16    unicode)
+                              HPDF_UINT32    unicode)
 {
     HPDF_UINT16 advance_width;
     HPDF_TTF_LongHorMetric hmetrics;
@@ -1346,6 +1884,28 @@ HPDF_TTFontDef_GetGidWidth  (HPDF_FontDef   fontdef,
 }
 
 
+HPDF_INT16
+HPDF_TTFontDef_UseGlyph  (HPDF_FontDef   fontdef,
+                          HPDF_UINT16    gid)
+{
+    HPDF_TTFontDefAttr attr = (HPDF_TTFontDefAttr)fontdef->attr;
+
+    HPDF_PTRACE((" HPDF_TTFontDef_UseGlyph\n"));
+
+    if (gid >= attr->num_glyphs)
+        return fontdef->missing_width;
+
+    if (!attr->glyph_tbl.flgs[gid]) {
+        attr->glyph_tbl.flgs[gid] = 1;
+
+        if (attr->embedding)
+            CheckCompositGryph (fontdef, gid);
+    }
+
+    return HPDF_TTFontDef_GetGidWidth (fontdef, gid);
+}
+
+
 
 static HPDF_STATUS
 ParseHmtx  (HPDF_FontDef  fontdef)
@@ -1781,28 +2341,330 @@ ParseOS2  (HPDF_FontDef  fontdef)
 }
 
 
+/* copies len bytes from the current position of src to dst, in one write
+ * when the font is held in memory.
+ */
 static HPDF_STATUS
-RecreateGLYF  (HPDF_FontDef   fontdef,
-               HPDF_UINT32   *new_offsets,
-               HPDF_Stream    stream)
+CopyFontData  (HPDF_Stream   src,
+               HPDF_Stream   dst,
+               HPDF_UINT32   len)
 {
-    HPDF_UINT32 save_offset = 0;
-    HPDF_UINT32 start_offset = stream->size;
-    HPDF_TTFontDefAttr attr = (HPDF_TTFontDefAttr)fontdef->attr;
+    HPDF_BYTE buf[HPDF_STREAM_BUF_SIZ];
     HPDF_STATUS ret;
-    HPDF_INT i;
 
-    HPDF_PTRACE ((" RecreateGLYF\n"));
+    if (src->type == HPDF_STREAM_BUFFER) {
+        HPDF_BufferReaderAttr battr = (HPDF_BufferReaderAttr)src->attr;
 
-    for (i = 0; i < attr->num_glyphs; i++) {
-        HPDF_BYTE buf[HPDF_STREAM_BUF_SIZ];
+        if (battr->size - battr->pos >= len) {
+            ret = HPDF_Stream_Write (dst, battr->buf + battr->pos, len);
+            battr->pos += len;
+            return ret;
+        }
+    }
 
-        if (attr->glyph_tbl.flgs[i] == 1) {
-            HPDF_UINT offset = attr->glyph_tbl.offsets[i];
-            HPDF_UINT len = attr->glyph_tbl.offsets[i + 1] - offset;
+    while (len > 0) {
+        HPDF_UINT tmp_len =
+            (len > HPDF_STREAM_BUF_SIZ) ? HPDF_STREAM_BUF_SIZ : len;
 
-            new_offsets[i] = stream->size - start_offset;
-            if (attr->header.index_to_loc_format == 0) {
+        if ((ret = HPDF_Stream_Read (src, buf, &tmp_len)) != HPDF_OK)
+            return ret;
+
+        if ((ret = HPDF_Stream_Write (dst, buf, tmp_len)) != HPDF_OK)
+            return ret;
+
+        len -= tmp_len;
+    }
+
+    return HPDF_OK;
+}
+
+
+/* sums the big-endian words of len bytes of a memory stream from offset,
+ * the last word padded with zeros. the buffers of the stream are read
+ * directly, a word may span two of them.
+ */
+static HPDF_UINT32
+CheckSum  (HPDF_Stream   stream,
+           HPDF_UINT32   offset,
+           HPDF_UINT32   len)
+{
+    HPDF_UINT buf_siz = HPDF_MemStream_GetBufSize (stream);
+    HPDF_UINT idx = offset / buf_siz;
+    HPDF_UINT pos = offset % buf_siz;
+    HPDF_UINT32 sum = 0;
+    HPDF_UINT32 word = 0;
+    HPDF_UINT nbytes = 0;
+
+    while (len > 0) {
+        HPDF_UINT buf_len;
+        HPDF_BYTE *p = HPDF_MemStream_GetBufPtr (stream, idx, &buf_len);
+        HPDF_UINT n;
+
+        if (!p || buf_len <= pos)
+            break;
+
+        p += pos;
+        n = buf_len - pos;
+        if (n > len)
+            n = len;
+        len -= n;
+
+        /* finish a word which began in the previous buffer */
+        while (nbytes > 0 && n > 0) {
+            word = (word << 8) | *p++;
+            n--;
+            if (++nbytes == 4) {
+                sum += word;
+                word = 0;
+                nbytes = 0;
+            }
+        }
+
+        while (n >= 4) {
+            sum += (HPDF_UINT32)p[0] << 24 | (HPDF_UINT32)p[1] << 16 |
+                (HPDF_UINT32)p[2] << 8 | p[3];
+            p += 4;
+            n -= 4;
+        }
+
+        while (n > 0) {
+            word = (word << 8) | *p++;
+            n--;
+            nbytes++;
+        }
+
+        idx++;
+        pos = 0;
+    }
+
+    if (nbytes > 0)
+        sum += word << (8 * (4 - nbytes));
+
+    return sum;
+}
+
+
+/* numbers the used glyphs densely in their original order */
+static HPDF_STATUS
+CreateGidMap  (HPDF_FontDef   fontdef)
+{
+    HPDF_TTFontDefAttr attr = (HPDF_TTFontDefAttr)fontdef->attr;
+    HPDF_UINT16 count = 0;
+    HPDF_UINT i;
+
+    if (!attr->gid_map) {
+        attr->gid_map = HPDF_GetMem (fontdef->mmgr,
+                sizeof (HPDF_UINT16) * attr->num_glyphs);
+        if (!attr->gid_map)
+            return HPDF_Error_GetCode (fontdef->error);
+    }
+
+    for (i = 0; i < attr->num_glyphs; i++)
+        attr->gid_map[i] = attr->glyph_tbl.flgs[i] ? count++ : 0;
+
+    attr->num_subset_glyphs = count;
+
+    return HPDF_OK;
+}
+
+
+/* changes the glyph indices of the components of a composite glyph to the
+ * numbers of the subset.
+ */
+static void
+RemapCompositeGlyph  (HPDF_TTFontDefAttr   attr,
+                      HPDF_BYTE           *buf,
+                      HPDF_UINT            len)
+{
+    const HPDF_UINT16 ARG_1_AND_2_ARE_WORDS = 1;
+    const HPDF_UINT16 WE_HAVE_A_SCALE  = 8;
+    const HPDF_UINT16 MORE_COMPONENTS = 32;
+    const HPDF_UINT16 WE_HAVE_AN_X_AND_Y_SCALE = 64;
+    const HPDF_UINT16 WE_HAVE_A_TWO_BY_TWO = 128;
+    HPDF_UINT pos = 10;
+    HPDF_UINT16 flags;
+
+    do {
+        HPDF_UINT16 gid;
+
+        if (pos + 4 > len)
+            return;
+
+        flags = (HPDF_UINT16)(buf[pos] << 8 | buf[pos + 1]);
+        gid = (HPDF_UINT16)(buf[pos + 2] << 8 | buf[pos + 3]);
+        gid = (gid < attr->num_glyphs) ? attr->gid_map[gid] : 0;
+
+        buf[pos + 2] = (HPDF_BYTE)(gid >> 8);
+        buf[pos + 3] = (HPDF_BYTE)gid;
+
+        pos += (flags & ARG_1_AND_2_ARE_WORDS) ? 8 : 6;
+
+        if (flags & WE_HAVE_A_SCALE)
+            pos += 2;
+        else if (flags & WE_HAVE_AN_X_AND_Y_SCALE)
+            pos += 4;
+        else if (flags & WE_HAVE_A_TWO_BY_TWO)
+            pos += 8;
+    } while (flags & MORE_COMPONENTS);
+}
+
+
+/* writes the used glyphs one after another, new_offsets is indexed by the
+ * numbers of the subset.
+ */
+static HPDF_STATUS
+RecreateCompactGLYF  (HPDF_FontDef   fontdef,
+                      HPDF_UINT32   *new_offsets,
+                      HPDF_Stream    stream)
+{
+    HPDF_UINT32 start_offset = stream->size;
+    HPDF_TTFontDefAttr attr = (HPDF_TTFontDefAttr)fontdef->attr;
+    HPDF_BYTE *buf = NULL;
+    HPDF_UINT buf_len = 0;
+    HPDF_UINT16 new_gid = 0;
+    HPDF_STATUS ret = HPDF_OK;
+    HPDF_INT i;
+
+    HPDF_PTRACE ((" RecreateCompactGLYF\n"));
+
+    for (i = 0; i < attr->num_glyphs; i++) {
+        HPDF_UINT offset = attr->glyph_tbl.offsets[i];
+        HPDF_UINT len = attr->glyph_tbl.offsets[i + 1] - offset;
+
+        if (!attr->glyph_tbl.flgs[i])
+            continue;
+
+        new_offsets[new_gid] = stream->size - start_offset;
+        if (attr->header.index_to_loc_format == 0) {
+            new_offsets[new_gid] /= 2;
+            offset *= 2;
+            len *= 2;
+        }
+        new_gid++;
+
+        if (len == 0)
+            continue;
+
+        if (len > buf_len) {
+            if (buf)
+                HPDF_FreeMem (fontdef->mmgr, buf);
+
+            buf = HPDF_GetMem (fontdef->mmgr, len);
+            if (!buf)
+                return HPDF_Error_GetCode (fontdef->error);
+            buf_len = len;
+        }
+
+        offset += attr->glyph_tbl.base_offset;
+
+        if ((ret = HPDF_Stream_Seek (attr->stream, offset, HPDF_SEEK_SET))
+                != HPDF_OK)
+            break;
+
+        if ((ret = HPDF_Stream_Read (attr->stream, buf, &len)) != HPDF_OK)
+            break;
+
+        /* numberOfContours is negative for a composite glyph */
+        if (len >= 10 && (buf[0] & 0x80))
+            RemapCompositeGlyph (attr, buf, len);
+
+        if ((ret = HPDF_Stream_Write (stream, buf, len)) != HPDF_OK)
+            break;
+    }
+
+    if (buf)
+        HPDF_FreeMem (fontdef->mmgr, buf);
+
+    new_offsets[new_gid] = stream->size - start_offset;
+    if (attr->header.index_to_loc_format == 0)
+        new_offsets[new_gid] /= 2;
+
+    return ret;
+}
+
+
+/* copies a table whose 16-bit field at field_offset is changed to value */
+static HPDF_STATUS
+CopyTablePatched  (HPDF_Stream   src,
+                   HPDF_Stream   dst,
+                   HPDF_UINT32   length,
+                   HPDF_UINT     field_offset,
+                   HPDF_UINT16   value)
+{
+    HPDF_STATUS ret;
+
+    if (length < field_offset + 2)
+        return CopyFontData (src, dst, length);
+
+    if ((ret = CopyFontData (src, dst, field_offset)) != HPDF_OK)
+        return ret;
+
+    if ((ret = WriteUINT16 (dst, value)) != HPDF_OK)
+        return ret;
+
+    if ((ret = HPDF_Stream_Seek (src, 2, HPDF_SEEK_CUR)) != HPDF_OK)
+        return ret;
+
+    return CopyFontData (src, dst, length - field_offset - 2);
+}
+
+
+/* a subset numbered densely is used through the CIDToGIDMap only, so its
+ * cmap maps no character.
+ */
+static HPDF_STATUS
+WriteEmptyCMap  (HPDF_Stream   stream)
+{
+    HPDF_STATUS ret = HPDF_OK;
+
+    ret += WriteUINT16 (stream, 0);        /* version */
+    ret += WriteUINT16 (stream, 1);        /* numTables */
+    ret += WriteUINT16 (stream, 3);        /* platformID */
+    ret += WriteUINT16 (stream, 1);        /* encodingID */
+    ret += WriteUINT32 (stream, 12);       /* offset */
+
+    ret += WriteUINT16 (stream, 4);        /* format */
+    ret += WriteUINT16 (stream, 24);       /* length */
+    ret += WriteUINT16 (stream, 0);        /* language */
+    ret += WriteUINT16 (stream, 2);        /* segCountX2 */
+    ret += WriteUINT16 (stream, 2);        /* searchRange */
+    ret += WriteUINT16 (stream, 0);        /* entrySelector */
+    ret += WriteUINT16 (stream, 0);        /* rangeShift */
+    ret += WriteUINT16 (stream, 0xFFFF);   /* endCode */
+    ret += WriteUINT16 (stream, 0);        /* reservedPad */
+    ret += WriteUINT16 (stream, 0xFFFF);   /* startCode */
+    ret += WriteINT16 (stream, 1);         /* idDelta */
+    ret += WriteUINT16 (stream, 0);        /* idRangeOffset */
+
+    return ret;
+}
+
+
+static HPDF_STATUS
+RecreateGLYF  (HPDF_FontDef   fontdef,
+               HPDF_UINT32   *new_offsets,
+               HPDF_Stream    stream)
+{
+    HPDF_UINT32 save_offset = 0;
+    HPDF_UINT32 start_offset = stream->size;
+    HPDF_TTFontDefAttr attr = (HPDF_TTFontDefAttr)fontdef->attr;
+    HPDF_UINT32 run_offset = 0;
+    HPDF_UINT32 run_len = 0;
+    HPDF_STATUS ret;
+    HPDF_INT i;
+
+    HPDF_PTRACE ((" RecreateGLYF\n"));
+
+    /* the used glyphs which lie next to each other in the font are copied
+     * as one run.
+     */
+    for (i = 0; i < attr->num_glyphs; i++) {
+        if (attr->glyph_tbl.flgs[i] == 1) {
+            HPDF_UINT offset = attr->glyph_tbl.offsets[i];
+            HPDF_UINT len = attr->glyph_tbl.offsets[i + 1] - offset;
+
+            new_offsets[i] = stream->size + run_len - start_offset;
+            if (attr->header.index_to_loc_format == 0) {
                 new_offsets[i] /= 2;
                 len *= 2;
             }
@@ -1816,28 +2678,23 @@ RecreateGLYF  (HPDF_FontDef   fontdef,
 
             offset += attr->glyph_tbl.base_offset;
 
-            if ((ret = HPDF_Stream_Seek (attr->stream, offset, HPDF_SEEK_SET))
-                    != HPDF_OK)
-                return ret;
-
-            while (len > 0) {
-                HPDF_UINT tmp_len =
-                    (len > HPDF_STREAM_BUF_SIZ) ? HPDF_STREAM_BUF_SIZ : len;
-
-                HPDF_MemSet (buf, 0, tmp_len);
-
-                if ((ret = HPDF_Stream_Read (attr->stream, buf, &tmp_len))
-                        != HPDF_OK)
+            if (run_len > 0 && run_offset + run_len != offset) {
+                if ((ret = HPDF_Stream_Seek (attr->stream, run_offset,
+                                HPDF_SEEK_SET)) != HPDF_OK)
                     return ret;
 
-                if ((ret = HPDF_Stream_Write (stream, buf, tmp_len)) !=
+                if ((ret = CopyFontData (attr->stream, stream, run_len)) !=
                         HPDF_OK)
                     return ret;
 
-                len -= tmp_len;
+                run_len = 0;
             }
 
-            save_offset = stream->size - start_offset;
+            if (run_len == 0)
+                run_offset = offset;
+            run_len += len;
+
+            save_offset = stream->size + run_len - start_offset;
             if (attr->header.index_to_loc_format == 0)
                 save_offset /= 2;
         } else {
@@ -1845,6 +2702,15 @@ RecreateGLYF  (HPDF_FontDef   fontdef,
         }
     }
 
+    if (run_len > 0) {
+        if ((ret = HPDF_Stream_Seek (attr->stream, run_offset, HPDF_SEEK_SET))
+                != HPDF_OK)
+            return ret;
+
+        if ((ret = CopyFontData (attr->stream, stream, run_len)) != HPDF_OK)
+            return ret;
+    }
+
     new_offsets[attr->num_glyphs] = save_offset;
 
 #ifdef DEBUG
@@ -2009,11 +2875,20 @@ HPDF_TTFontDef_SaveFontData  (HPDF_FontDef   fontdef,
     HPDF_UINT32 offset_base;
     HPDF_UINT32 tmp_check_sum = 0xB1B0AFBA;
     HPDF_TTFTable emptyTable;
+    HPDF_BOOL compact = attr->compact_subset && !attr->has_simple_font;
+    HPDF_UINT num_glyphs = attr->num_glyphs;
     emptyTable.length = 0;
     emptyTable.offset = 0;
 
     HPDF_PTRACE ((" SaveFontData\n"));
 
+    if (compact) {
+        if ((ret = CreateGidMap (fontdef)) != HPDF_OK)
+            return ret;
+
+        num_glyphs = attr->num_subset_glyphs;
+    }
+
     ret = WriteUINT32 (stream, attr->offset_tbl.sfnt_version);
     ret += WriteUINT16 (stream, HPDF_REQUIRED_TAGS_COUNT);
     ret += WriteUINT16 (stream, attr->offset_tbl.search_range);
@@ -2064,7 +2939,10 @@ HPDF_TTFontDef_SaveFontData  (HPDF_FontDef   fontdef,
         if (HPDF_MemCmp ((HPDF_BYTE *)tbl->tag, (HPDF_BYTE *)"head", 4) == 0) {
             ret = WriteHeader (fontdef, tmp_stream, &check_sum_ptr);
         } else if (HPDF_MemCmp ((HPDF_BYTE *)tbl->tag, (HPDF_BYTE *)"glyf", 4) == 0) {
-            ret = RecreateGLYF (fontdef, new_offsets, tmp_stream);
+            if (compact)
+                ret = RecreateCompactGLYF (fontdef, new_offsets, tmp_stream);
+            else
+                ret = RecreateGLYF (fontdef, new_offsets, tmp_stream);
         } else if (HPDF_MemCmp ((HPDF_BYTE *)tbl->tag, (HPDF_BYTE *)"loca", 4) == 0) {
             HPDF_UINT j;
 
@@ -2072,33 +2950,51 @@ HPDF_TTFontDef_SaveFontData  (HPDF_FontDef   fontdef,
             poffset = new_offsets;
 
             if (attr->header.index_to_loc_format == 0) {
-                for (j = 0; j <= attr->num_glyphs; j++) {
+                for (j = 0; j <= num_glyphs; j++) {
                     ret += WriteUINT16 (tmp_stream, (HPDF_UINT16)*poffset);
                     poffset++;
                 }
             } else {
-                for (j = 0; j <= attr->num_glyphs; j++) {
+                for (j = 0; j <= num_glyphs; j++) {
                     ret += WriteUINT32 (tmp_stream, *poffset);
                     poffset++;
                 }
             }
         } else if (HPDF_MemCmp ((HPDF_BYTE *)tbl->tag, (HPDF_BYTE *)"name", 4) == 0) {
             ret = RecreateName (fontdef, tmp_stream);
-        } else {
-            HPDF_UINT size = 4;
-
-            while (length > 4) {
-                value = 0;
-                size = 4;
-                ret = HPDF_Stream_Read (attr->stream, (HPDF_BYTE *)&value, &size);
-                ret += HPDF_Stream_Write (tmp_stream, (HPDF_BYTE *)&value, size);
-                length -= 4;
-            }
+        } else if (compact && HPDF_MemCmp ((HPDF_BYTE *)tbl->tag,
+                    (HPDF_BYTE *)"hmtx", 4) == 0) {
+            HPDF_UINT j;
 
-            value = 0;
-            size = length;
-            ret += HPDF_Stream_Read (attr->stream, (HPDF_BYTE *)&value, &size);
-            ret += HPDF_Stream_Write (tmp_stream, (HPDF_BYTE *)&value, size);
+            /* every glyph of the subset gets a full metric */
+            for (j = 0; j < attr->num_glyphs; j++) {
+                if (attr->glyph_tbl.flgs[j]) {
+                    ret += WriteUINT16 (tmp_stream,
+                            attr->h_metric[j].advance_width);
+                    ret += WriteINT16 (tmp_stream, attr->h_metric[j].lsb);
+                }
+            }
+        } else if (compact && HPDF_MemCmp ((HPDF_BYTE *)tbl->tag,
+                    (HPDF_BYTE *)"hhea", 4) == 0) {
+            /* numberOfHMetrics */
+            ret = CopyTablePatched (attr->stream, tmp_stream, length, 34,
+                    (HPDF_UINT16)num_glyphs);
+        } else if (compact && HPDF_MemCmp ((HPDF_BYTE *)tbl->tag,
+                    (HPDF_BYTE *)"maxp", 4) == 0) {
+            /* numGlyphs */
+            ret = CopyTablePatched (attr->stream, tmp_stream, length, 4,
+                    (HPDF_UINT16)num_glyphs);
+        } else if (compact && HPDF_MemCmp ((HPDF_BYTE *)tbl->tag,
+                    (HPDF_BYTE *)"post", 4) == 0 && length >= 32) {
+            /* version 3 keeps the header and drops the glyph names */
+            ret = WriteUINT32 (tmp_stream, 0x00030000);
+            ret += HPDF_Stream_Seek (attr->stream, 4, HPDF_SEEK_CUR);
+            ret += CopyFontData (attr->stream, tmp_stream, 28);
+        } else if (compact && HPDF_MemCmp ((HPDF_BYTE *)tbl->tag,
+                    (HPDF_BYTE *)"cmap", 4) == 0) {
+            ret = WriteEmptyCMap (tmp_stream);
+        } else {
+            ret = CopyFontData (attr->stream, tmp_stream, length);
         }
 
         tmp_tbl[i].offset = new_offset;
@@ -2111,31 +3007,11 @@ HPDF_TTFontDef_SaveFontData  (HPDF_FontDef   fontdef,
     /* recalcurate checksum */
     for (i = 0; i < HPDF_REQUIRED_TAGS_COUNT; i++) {
         HPDF_TTFTable tbl = tmp_tbl[i];
-        HPDF_UINT32 buf;
-        HPDF_UINT length = tbl.length;
 
         HPDF_PTRACE((" SaveFontData() tag[%s] length=%u\n",
-                REQUIRED_TAGS[i], length));
+                REQUIRED_TAGS[i], (HPDF_UINT)tbl.length));
 
-        if ((ret = HPDF_Stream_Seek (tmp_stream, tbl.offset, HPDF_SEEK_SET))
-                != HPDF_OK)
-            break;
-
-        tbl.check_sum = 0;
-        while (length > 0) {
-            HPDF_UINT rlen = (length > 4) ? 4 : length;
-            buf = 0;
-            if ((ret = HPDF_Stream_Read (tmp_stream, (HPDF_BYTE *)&buf, &rlen))
-                    != HPDF_OK)
-                break;
-
-            UINT32Swap (&buf);
-            tbl.check_sum += buf;
-            length -= rlen;
-        }
-
-        if (ret != HPDF_OK)
-            break;
+        tbl.check_sum = CheckSum (tmp_stream, tbl.offset, tbl.length);
 
         HPDF_PTRACE((" SaveFontData tag[%s] check-sum=%u offset=%u\n",
                     REQUIRED_TAGS[i], (HPDF_UINT)tbl.check_sum,
@@ -2154,28 +3030,10 @@ HPDF_TTFontDef_SaveFontData  (HPDF_FontDef   fontdef,
     if (ret != HPDF_OK)
         goto Exit;
 
-    /* calucurate checkSumAdjustment.*/
-    ret = HPDF_Stream_Seek (tmp_stream, 0, HPDF_SEEK_SET);
-    if (ret != HPDF_OK)
-        goto Exit;
-
-    for (;;) {
-        HPDF_UINT32 buf;
-        HPDF_UINT siz = sizeof(buf);
-
-        ret = HPDF_Stream_Read (tmp_stream, (HPDF_BYTE *)&buf, &siz);
-        if (ret != HPDF_OK || siz <= 0) {
-            if (ret == HPDF_STREAM_EOF)
-                ret = HPDF_OK;
-            break;
-        }
-
-        UINT32Swap (&buf);
-        tmp_check_sum -= buf;
-    }
-
-    if (ret != HPDF_OK)
-        goto Exit;
+    /* calucurate checkSumAdjustment. a partial word at the end is left out
+     * as it always was.
+     */
+    tmp_check_sum -= CheckSum (tmp_stream, 0, tmp_stream->size & ~3U);
 
     HPDF_PTRACE((" SaveFontData new checkSumAdjustment=%u\n",
                 (HPDF_UINT)tmp_check_sum));
@@ -2202,6 +3060,487 @@ Exit:
     return ret;
 }
 
+
+static HPDF_UINT32
+HashGlyphs  (const HPDF_BYTE  *flgs,
+             HPDF_UINT         count)
+{
+    HPDF_UINT32 hash = 2166136261U;
+    HPDF_UINT i;
+
+    for (i = 0; i < count; i++) {
+        hash ^= flgs[i];
+        hash *= 16777619U;
+    }
+
+    return hash;
+}
+
+
+/* looks for the subset of the glyphs used by the font definition in its
+ * cache entry, the cache lock must be held. a subset which is found moves
+ * to the front, so that the ones used least recently are dropped first.
+ */
+static HPDF_TTFontSubset
+FindSubset  (HPDF_FontDef   fontdef,
+             HPDF_UINT32    hash,
+             HPDF_BOOL      compact,
+             HPDF_UINT      filter)
+{
+    HPDF_TTFontDefAttr attr = (HPDF_TTFontDefAttr)fontdef->attr;
+    HPDF_TTFontCacheEntry entry = attr->cache_entry;
+    HPDF_TTFontSubset *psubset = &entry->subsets;
+
+    while (*psubset) {
+        HPDF_TTFontSubset subset = *psubset;
+
+        if (subset->hash == hash && subset->compact == compact &&
+                subset->filter == filter &&
+                HPDF_MemCmp ((HPDF_BYTE *)subset->tag_name,
+                    (HPDF_BYTE *)attr->tag_name,
+                    HPDF_TTF_FONT_TAG_LEN + 1) == 0 &&
+                HPDF_MemCmp (subset->flgs, attr->glyph_tbl.flgs,
+                    attr->num_glyphs) == 0) {
+            *psubset = subset->next;
+            subset->next = entry->subsets;
+            entry->subsets = subset;
+
+            return subset;
+        }
+
+        psubset = &subset->next;
+    }
+
+    return NULL;
+}
+
+
+/* adds the encoded font data in data to the cache entry of the font
+ * definition. a failure only leaves the subset out of the cache.
+ */
+static void
+StoreSubset  (HPDF_FontDef   fontdef,
+              HPDF_UINT32    hash,
+              HPDF_BOOL      compact,
+              HPDF_UINT      filter,
+              HPDF_Stream    data)
+{
+    HPDF_TTFontDefAttr attr = (HPDF_TTFontDefAttr)fontdef->attr;
+    HPDF_TTFontCacheEntry entry = attr->cache_entry;
+    HPDF_TTFontSubset subset;
+    HPDF_UINT size = data->size;
+
+    if (HPDF_Stream_Seek (data, 0, HPDF_SEEK_SET) != HPDF_OK)
+        return;
+
+    HPDF_CACHE_LOCK ();
+
+    /* another document may have stored it meanwhile */
+    if (FindSubset (fontdef, hash, compact, filter)) {
+        HPDF_CACHE_UNLOCK ();
+        return;
+    }
+
+    subset = HPDF_GetMem (entry->mmgr, sizeof(HPDF_TTFontSubset_Rec) +
+            attr->num_glyphs + size);
+    if (!subset) {
+        HPDF_Error_Reset (&entry->error);
+        HPDF_CACHE_UNLOCK ();
+        return;
+    }
+
+    HPDF_MemSet (subset, 0, sizeof(HPDF_TTFontSubset_Rec));
+    subset->hash = hash;
+    subset->flgs = (HPDF_BYTE *)(subset + 1);
+    subset->data = subset->flgs + attr->num_glyphs;
+    subset->compact = compact;
+    subset->filter = filter;
+    subset->length1 = attr->length1;
+    subset->size = size;
+    HPDF_MemCpy ((HPDF_BYTE *)subset->tag_name, (HPDF_BYTE *)attr->tag_name,
+            HPDF_TTF_FONT_TAG_LEN + 1);
+    HPDF_MemCpy (subset->flgs, attr->glyph_tbl.flgs, attr->num_glyphs);
+
+    if (HPDF_Stream_Read (data, subset->data, &size) != HPDF_OK ||
+            size != subset->size) {
+        HPDF_FreeMem (entry->mmgr, subset);
+        HPDF_CACHE_UNLOCK ();
+        return;
+    }
+
+    subset->next = entry->subsets;
+    entry->subsets = subset;
+
+    if (++entry->num_subsets > HPDF_TTF_MAX_CACHED_SUBSETS) {
+        HPDF_TTFontSubset *plast = &entry->subsets;
+
+        while ((*plast)->next)
+            plast = &(*plast)->next;
+
+        HPDF_FreeMem (entry->mmgr, *plast);
+        *plast = NULL;
+        entry->num_subsets--;
+    }
+
+    HPDF_CACHE_UNLOCK ();
+}
+
+
+/* saves the font data to stream, deflated when filter asks for it, and
+ * sets filter to the filters the data has been encoded with. the subsets
+ * of a cached font are taken from its cache entry when the font
+ * definition caches them.
+ */
+static HPDF_STATUS
+SaveEncodedFontData  (HPDF_FontDef   fontdef,
+                      HPDF_Stream    stream,
+                      HPDF_UINT     *filter)
+{
+    HPDF_TTFontDefAttr attr = (HPDF_TTFontDefAttr)fontdef->attr;
+    HPDF_BOOL compact = attr->compact_subset && !attr->has_simple_font;
+    HPDF_BOOL cached = attr->cache_subsets && attr->cache_entry;
+    HPDF_UINT32 hash = 0;
+    HPDF_Stream data;
+    HPDF_Stream encoded;
+    HPDF_STATUS ret = HPDF_OK;
+
+#ifndef LIBHPDF_HAVE_NOZLIB
+    *filter &= HPDF_STREAM_FILTER_FLATE_DECODE;
+#else
+    *filter = HPDF_STREAM_FILTER_NONE;
+#endif /* LIBHPDF_HAVE_NOZLIB */
+
+    if (cached) {
+        HPDF_TTFontSubset subset;
+
+        hash = HashGlyphs (attr->glyph_tbl.flgs, attr->num_glyphs);
+
+        HPDF_CACHE_LOCK ();
+        subset = FindSubset (fontdef, hash, compact, *filter);
+        if (subset) {
+            attr->length1 = subset->length1;
+            ret = HPDF_Stream_Write (stream, subset->data, subset->size);
+        }
+        HPDF_CACHE_UNLOCK ();
+
+        /* the glyph numbers of a compact subset are still needed */
+        if (subset) {
+            if (ret == HPDF_OK && compact)
+                ret = CreateGidMap (fontdef);
+
+            return ret;
+        }
+    } else if (*filter == HPDF_STREAM_FILTER_NONE)
+        return HPDF_TTFontDef_SaveFontData (fontdef, stream);
+
+    data = HPDF_MemStream_New (fontdef->mmgr, HPDF_STREAM_BUF_SIZ);
+    if (!data)
+        return HPDF_Error_GetCode (fontdef->error);
+
+    if ((ret = HPDF_TTFontDef_SaveFontData (fontdef, data)) != HPDF_OK) {
+        HPDF_Stream_Free (data);
+        return ret;
+    }
+
+    if (!cached) {
+        ret = HPDF_Stream_WriteToStream (data, stream, *filter, NULL);
+        HPDF_Stream_Free (data);
+        return ret;
+    }
+
+    encoded = data;
+    if (*filter != HPDF_STREAM_FILTER_NONE) {
+        encoded = HPDF_MemStream_New (fontdef->mmgr, HPDF_STREAM_BUF_SIZ);
+        if (!encoded)
+            ret = HPDF_Error_GetCode (fontdef->error);
+        else
+            ret = HPDF_Stream_WriteToStream (data, encoded, *filter, NULL);
+
+        HPDF_Stream_Free (data);
+    }
+
+    if (ret == HPDF_OK) {
+        StoreSubset (fontdef, hash, compact, *filter, encoded);
+        ret = HPDF_Stream_WriteToStream (encoded, stream,
+                HPDF_STREAM_FILTER_NONE, NULL);
+    }
+
+    if (encoded)
+        HPDF_Stream_Free (encoded);
+
+    return ret;
+}
+
+
+HPDF_STATUS
+HPDF_TTFontDef_SaveFontFile  (HPDF_FontDef   fontdef,
+                              HPDF_Stream    stream,
+                              HPDF_UINT      filter)
+{
+    HPDF_TTFontDefAttr attr = (HPDF_TTFontDefAttr)fontdef->attr;
+    HPDF_STATUS ret;
+
+    HPDF_PTRACE ((" HPDF_TTFontDef_SaveFontFile\n"));
+
+    attr->encoded_filter = HPDF_STREAM_FILTER_NONE;
+
+    /* the font data may have been saved by a worker thread already */
+    if (attr->save_job) {
+        HPDF_TTFontSaveJob job = attr->save_job;
+
+        attr->save_job = NULL;
+        ret = HPDF_Stream_WriteToStream (job->stream, stream,
+                HPDF_STREAM_FILTER_NONE, NULL);
+        attr->encoded_filter = job->filter;
+        FreeSaveJob (fontdef, job);
+
+        return ret;
+    }
+
+    if (!attr->cache_subsets || !attr->cache_entry)
+        return HPDF_TTFontDef_SaveFontData (fontdef, stream);
+
+    ret = SaveEncodedFontData (fontdef, stream, &filter);
+    attr->encoded_filter = filter;
+
+    return ret;
+}
+
+
+static void
+FreeSaveJob  (HPDF_FontDef         fontdef,
+              HPDF_TTFontSaveJob   job)
+{
+    if (!job)
+        return;
+
+    if (job->mmgr) {
+        if (job->stream)
+            HPDF_Stream_Free (job->stream);
+
+        HPDF_MMgr_Free (job->mmgr);
+    }
+
+    HPDF_FreeMem (fontdef->mmgr, job);
+}
+
+
+/* runs on a worker thread. the font definition is used by this job only
+ * while the workers run, so its memory manager and error object, and the
+ * ones of its font file, are swapped for the ones of the job.
+ */
+static void
+RunSaveJob  (HPDF_TTFontSaveJob   job)
+{
+    HPDF_FontDef fontdef = job->fontdef;
+    HPDF_TTFontDefAttr attr = (HPDF_TTFontDefAttr)fontdef->attr;
+    HPDF_MMgr mmgr = fontdef->mmgr;
+    HPDF_Error error = fontdef->error;
+    HPDF_MMgr stream_mmgr = attr->stream->mmgr;
+    HPDF_Error stream_error = attr->stream->error;
+
+    fontdef->mmgr = job->mmgr;
+    fontdef->error = &job->error;
+    attr->stream->mmgr = job->mmgr;
+    attr->stream->error = &job->error;
+
+    job->stream = HPDF_MemStream_New (job->mmgr, HPDF_STREAM_BUF_SIZ);
+    if (!job->stream)
+        job->ret = HPDF_Error_GetCode (&job->error);
+    else
+        job->ret = SaveEncodedFontData (fontdef, job->stream, &job->filter);
+
+    if (job->ret == HPDF_OK)
+        job->ret = HPDF_Error_GetCode (&job->error);
+
+    fontdef->mmgr = mmgr;
+    fontdef->error = error;
+    attr->stream->mmgr = stream_mmgr;
+    attr->stream->error = stream_error;
+}
+
+
+static HPDF_TTFontSaveJob
+NextSaveJob  (HPDF_TTFontSavePool   pool)
+{
+    HPDF_UINT i;
+
+#if defined(_WIN32)
+    i = (HPDF_UINT)InterlockedIncrement (&pool->next) - 1;
+#else
+    pthread_mutex_lock (&pool->lock);
+    i = pool->next++;
+    pthread_mutex_unlock (&pool->lock);
+#endif
+
+    return (i < pool->count) ? pool->jobs[i] : NULL;
+}
+
+
+#if defined(_WIN32)
+static DWORD WINAPI
+#else
+static void *
+#endif
+SaveWorker  (void  *arg)
+{
+    HPDF_TTFontSavePool pool = (HPDF_TTFontSavePool)arg;
+    HPDF_TTFontSaveJob job;
+
+    while ((job = NextSaveJob (pool)) != NULL)
+        RunSaveJob (job);
+
+    return 0;
+}
+
+
+static HPDF_UINT
+CountProcessors  (void)
+{
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+
+    GetSystemInfo (&info);
+    return (HPDF_UINT)info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+    long count = sysconf (_SC_NPROCESSORS_ONLN);
+
+    return (count > 0) ? (HPDF_UINT)count : 1;
+#else
+    return 1;
+#endif
+}
+
+
+HPDF_STATUS
+HPDF_TTFontDef_PrepareFontData  (HPDF_MMgr         mmgr,
+                                 HPDF_FontDef     *fontdefs,
+                                 const HPDF_UINT  *filters,
+                                 HPDF_UINT         count)
+{
+    HPDF_TTFontSavePool_Rec pool;
+#if defined(_WIN32)
+    HANDLE threads[HPDF_TTF_MAX_SAVE_THREADS];
+#else
+    pthread_t threads[HPDF_TTF_MAX_SAVE_THREADS];
+#endif
+    HPDF_UINT num_threads;
+    HPDF_UINT started = 0;
+    HPDF_UINT i;
+
+    HPDF_PTRACE ((" HPDF_TTFontDef_PrepareFontData\n"));
+
+    if (count == 0)
+        return HPDF_OK;
+
+    HPDF_MemSet (&pool, 0, sizeof(pool));
+    pool.jobs = HPDF_GetMem (mmgr, sizeof(HPDF_TTFontSaveJob) * count);
+    if (!pool.jobs)
+        return HPDF_Error_GetCode (mmgr->error);
+
+    for (i = 0; i < count; i++) {
+        HPDF_FontDef fontdef = fontdefs[i];
+        HPDF_TTFontDefAttr attr = (HPDF_TTFontDefAttr)fontdef->attr;
+        HPDF_TTFontSaveJob job;
+
+        FreeSaveJob (fontdef, attr->save_job);
+        attr->save_job = NULL;
+
+        /* the map of a compact subset belongs to the document, so it is
+         * allocated here. the worker fills it in again.
+         */
+        if (attr->compact_subset && !attr->has_simple_font &&
+                CreateGidMap (fontdef) != HPDF_OK)
+            break;
+
+        job = HPDF_GetMem (mmgr, sizeof(HPDF_TTFontSaveJob_Rec));
+        if (!job)
+            break;
+
+        HPDF_MemSet (job, 0, sizeof(HPDF_TTFontSaveJob_Rec));
+        HPDF_Error_Init (&job->error, NULL);
+        job->fontdef = fontdef;
+        job->filter = filters[i];
+
+        /* the memory of the job is not taken from the allocator given
+         * by the application, which need not be thread safe.
+         */
+        job->mmgr = HPDF_MMgr_New (&job->error, 0, NULL, NULL);
+        if (!job->mmgr) {
+            HPDF_FreeMem (mmgr, job);
+            continue;
+        }
+
+        pool.jobs[pool.count++] = job;
+    }
+
+    if (i < count) {
+        for (i = 0; i < pool.count; i++)
+            FreeSaveJob (pool.jobs[i]->fontdef, pool.jobs[i]);
+
+        HPDF_FreeMem (mmgr, pool.jobs);
+        return HPDF_Error_GetCode (mmgr->error);
+    }
+
+    num_threads = CountProcessors ();
+    if (num_threads > pool.count)
+        num_threads = pool.count;
+    if (num_threads > HPDF_TTF_MAX_SAVE_THREADS)
+        num_threads = HPDF_TTF_MAX_SAVE_THREADS;
+
+    /* the calling thread is one of the workers. when a thread cannot be
+     * started, the others do its share.
+     */
+#if defined(_WIN32)
+    while (started + 1 < num_threads) {
+        threads[started] = CreateThread (NULL, 0, SaveWorker, &pool, 0,
+                NULL);
+        if (!threads[started])
+            break;
+        started++;
+    }
+
+    SaveWorker (&pool);
+
+    for (i = 0; i < started; i++) {
+        WaitForSingleObject (threads[i], INFINITE);
+        CloseHandle (threads[i]);
+    }
+#else
+    pthread_mutex_init (&pool.lock, NULL);
+
+    while (started + 1 < num_threads) {
+        if (pthread_create (&threads[started], NULL, SaveWorker, &pool) != 0)
+            break;
+        started++;
+    }
+
+    SaveWorker (&pool);
+
+    for (i = 0; i < started; i++)
+        pthread_join (threads[i], NULL);
+
+    pthread_mutex_destroy (&pool.lock);
+#endif
+
+    /* the font data which failed to be saved is saved again while the
+     * document is written, where the error is reported as usual.
+     */
+    for (i = 0; i < pool.count; i++) {
+        HPDF_TTFontSaveJob job = pool.jobs[i];
+        HPDF_TTFontDefAttr attr = (HPDF_TTFontDefAttr)job->fontdef->attr;
+
+        if (job->ret == HPDF_OK)
+            attr->save_job = job;
+        else
+            FreeSaveJob (job->fontdef, job);
+    }
+
+    HPDF_FreeMem (mmgr, pool.jobs);
+
+    return HPDF_OK;
+}
+
 void
 HPDF_TTFontDef_SetTagName  (HPDF_FontDef   fontdef,
                             char     *tag)
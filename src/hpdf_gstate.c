@@ -66,6 +66,7 @@ HPDF_GState_New  (HPDF_MMgr    mmgr,
 
         gstate->prev = current;
         gstate->depth = current->depth + 1;
+        gstate->known = current->known;
     } else {
         HPDF_TransMatrix DEF_MATRIX = {1, 0, 0, 1, 0, 0};
         HPDF_RGBColor DEF_RGB_COLOR = {0, 0, 0};
@@ -102,6 +103,9 @@ HPDF_GState_New  (HPDF_MMgr    mmgr,
 
         gstate->prev = NULL;
         gstate->depth = 1;
+
+        /* the defaults above are the initial graphics state of a page */
+        gstate->known = HPDF_GSTATE_ALL & ~HPDF_GSTATE_FONT;
     }
 
     return gstate;
@@ -121,3 +125,15 @@ HPDF_GState_Free  (HPDF_MMgr    mmgr,
     return current;
 }
 
+
+/* Forgets which parameters are in effect, for the whole stack. Used when
+ * content the gstate does not track is written to the page.
+ */
+void
+HPDF_GState_Invalidate  (HPDF_GState  gstate)
+{
+    while (gstate) {
+        gstate->known = 0;
+        gstate = gstate->prev;
+    }
+}
@@ -28,7 +28,17 @@ static const HPDF_DashMode INIT_MODE = {{0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0
 
 static HPDF_STATUS
 InternalWriteText  (HPDF_PageAttr    attr,
-                    const char      *text);
+                    const char      *text,
+                    HPDF_UINT        len);
+
+static HPDF_STATUS
+InternalWriteTJOffset  (HPDF_PageAttr      attr,
+                        HPDF_WritingMode   wmode,
+                        HPDF_REAL          offset);
+
+static HPDF_STATUS
+InternalWriteTf  (HPDF_PageAttr   attr,
+                  const char     *local_name);
 
 static HPDF_STATUS
 InternalTextRect  (HPDF_Page            page,
@@ -37,11 +47,24 @@ InternalTextRect  (HPDF_Page            page,
                    HPDF_REAL            right,
                    HPDF_REAL            bottom,
                    const char          *text,
+                   HPDF_UINT            text_len,
                    HPDF_TextAlignment   align,
                    HPDF_UINT           *len,
                    HPDF_BOOL            force,
                    HPDF_BOOL            use_bbox);
 
+static HPDF_STATUS
+LayoutTextRect  (HPDF_Page            page,
+                 HPDF_TextLayout      layout,
+                 HPDF_REAL            left,
+                 HPDF_REAL            top,
+                 HPDF_REAL            right,
+                 HPDF_REAL            bottom,
+                 HPDF_TextAlignment   align,
+                 HPDF_UINT           *len,
+                 HPDF_BOOL            force,
+                 HPDF_BOOL            use_bbox);
+
 static HPDF_STATUS
 InternalArc  (HPDF_Page    page,
               HPDF_REAL    x,
@@ -55,7 +78,8 @@ InternalArc  (HPDF_Page    page,
 static HPDF_STATUS
 InternalShowTextNextLine  (HPDF_Page    page,
                            const char  *text,
-                           HPDF_UINT    len);
+                           HPDF_UINT    len,
+                           HPDF_REAL    tw);
 
 static HPDF_STATUS
 InternalBeginMarkedContentSequence  (HPDF_Page   page,
@@ -108,6 +132,23 @@ InternalAnnotationMatrix  (HPDF_MMgr mmgr,
                            HPDF_REAL height,
                            HPDF_REAL rotation);
 
+static HPDF_STATUS
+InternalOptimizeStream  (HPDF_Page    page,
+                         HPDF_Stream  stream);
+
+
+/* Returns HPDF_TRUE when HPDF_OPTIMIZE_GSTATE is on and the parameter
+ * given by flag is known to be in effect, so that a state operator which
+ * sets the value held in the gstate can be skipped.
+ */
+static HPDF_BOOL
+InternalGStateIsKnown  (HPDF_PageAttr  attr,
+                        HPDF_UINT      flag)
+{
+    return (attr->optimization_mode & HPDF_OPTIMIZE_GSTATE) &&
+            (attr->gstate->known & flag);
+}
+
 /*--- General graphics state ---------------------------------------------*/
 
 /* w */
@@ -129,6 +170,10 @@ HPDF_Page_SetLineWidth  (HPDF_Page  page,
     if (line_width < 0)
         return HPDF_RaiseError (page->error, HPDF_PAGE_OUT_OF_RANGE, 0);
 
+    if (InternalGStateIsKnown (attr, HPDF_GSTATE_LINE_WIDTH) &&
+            attr->gstate->line_width == line_width)
+        return ret;
+
     if (HPDF_Stream_WriteReal (attr->stream, line_width) != HPDF_OK)
         return HPDF_CheckError (page->error);
 
@@ -136,6 +181,7 @@ HPDF_Page_SetLineWidth  (HPDF_Page  page,
         return HPDF_CheckError (page->error);
 
     attr->gstate->line_width = line_width;
+    attr->gstate->known |= HPDF_GSTATE_LINE_WIDTH;
 
     return ret;
 }
@@ -160,6 +206,10 @@ HPDF_Page_SetLineCap  (HPDF_Page     page,
 
     attr = (HPDF_PageAttr)page->attr;
 
+    if (InternalGStateIsKnown (attr, HPDF_GSTATE_LINE_CAP) &&
+            attr->gstate->line_cap == line_cap)
+        return ret;
+
     if ((ret = HPDF_Stream_WriteInt (attr->stream,
                 (HPDF_UINT)line_cap)) != HPDF_OK)
         return ret;
@@ -169,6 +219,7 @@ HPDF_Page_SetLineCap  (HPDF_Page     page,
         return HPDF_CheckError (page->error);
 
     attr->gstate->line_cap = line_cap;
+    attr->gstate->known |= HPDF_GSTATE_LINE_CAP;
 
     return ret;
 }
@@ -193,6 +244,10 @@ HPDF_Page_SetLineJoin  (HPDF_Page      page,
 
     attr = (HPDF_PageAttr)page->attr;
 
+    if (InternalGStateIsKnown (attr, HPDF_GSTATE_LINE_JOIN) &&
+            attr->gstate->line_join == line_join)
+        return ret;
+
     if (HPDF_Stream_WriteInt (attr->stream, (HPDF_UINT)line_join) != HPDF_OK)
         return HPDF_CheckError (page->error);
 
@@ -200,6 +255,7 @@ HPDF_Page_SetLineJoin  (HPDF_Page      page,
         return HPDF_CheckError (page->error);
 
     attr->gstate->line_join = line_join;
+    attr->gstate->known |= HPDF_GSTATE_LINE_JOIN;
 
     return ret;
 }
@@ -223,6 +279,10 @@ HPDF_Page_SetMiterLimit  (HPDF_Page  page,
     if (miter_limit < 1)
         return HPDF_RaiseError (page->error, HPDF_PAGE_OUT_OF_RANGE, 0);
 
+    if (InternalGStateIsKnown (attr, HPDF_GSTATE_MITER_LIMIT) &&
+            attr->gstate->miter_limit == miter_limit)
+        return ret;
+
     if (HPDF_Stream_WriteReal (attr->stream, miter_limit) != HPDF_OK)
         return HPDF_CheckError (page->error);
 
@@ -230,6 +290,7 @@ HPDF_Page_SetMiterLimit  (HPDF_Page  page,
         return HPDF_CheckError (page->error);
 
     attr->gstate->miter_limit = miter_limit;
+    attr->gstate->known |= HPDF_GSTATE_MITER_LIMIT;
 
     return ret;
 }
@@ -263,7 +324,20 @@ HPDF_Page_SetDash  (HPDF_Page           page,
         return HPDF_RaiseError (page->error, HPDF_INVALID_PARAMETER,
                 phase);
 
-    HPDF_MemSet (buf, 0, HPDF_TMP_BUF_SIZ);
+    attr = (HPDF_PageAttr)page->attr;
+
+    if (InternalGStateIsKnown (attr, HPDF_GSTATE_DASH) &&
+            attr->gstate->dash_mode.num_ptn == num_param &&
+            attr->gstate->dash_mode.phase == phase) {
+        for (i = 0; i < num_param; i++) {
+            if (attr->gstate->dash_mode.ptn[i] != dash_ptn[i])
+                break;
+        }
+
+        if (i == num_param)
+            return ret;
+    }
+
     *pbuf++ = '[';
 
     for (i = 0; i < num_param; i++) {
@@ -281,8 +355,6 @@ HPDF_Page_SetDash  (HPDF_Page           page,
     pbuf = HPDF_FToA (pbuf, phase, eptr);
     HPDF_StrCpy (pbuf, " d\012", eptr);
 
-    attr = (HPDF_PageAttr)page->attr;
-
     if ((ret = HPDF_Stream_WriteStr (attr->stream, buf)) != HPDF_OK)
         return HPDF_CheckError (page->error);
 
@@ -295,6 +367,7 @@ HPDF_Page_SetDash  (HPDF_Page           page,
         attr->gstate->dash_mode.ptn[i] = *pdash_ptn;
         pdash_ptn++;
     }
+    attr->gstate->known |= HPDF_GSTATE_DASH;
 
     return ret;
 }
@@ -321,6 +394,10 @@ HPDF_Page_SetFlat  (HPDF_Page  page,
     if (flatness > 100 || flatness < 0)
         return HPDF_RaiseError (page->error, HPDF_PAGE_OUT_OF_RANGE, 0);
 
+    if (InternalGStateIsKnown (attr, HPDF_GSTATE_FLATNESS) &&
+            attr->gstate->flatness == flatness)
+        return ret;
+
     if (HPDF_Stream_WriteReal (attr->stream, flatness) != HPDF_OK)
         return HPDF_CheckError (page->error);
 
@@ -328,6 +405,7 @@ HPDF_Page_SetFlat  (HPDF_Page  page,
         return HPDF_CheckError (page->error);
 
     attr->gstate->flatness = flatness;
+    attr->gstate->known |= HPDF_GSTATE_FLATNESS;
 
     return ret;
 }
@@ -361,6 +439,8 @@ HPDF_Page_SetExtGState  (HPDF_Page        page,
     if (HPDF_Stream_WriteEscapeName (attr->stream, local_name) != HPDF_OK)
         return HPDF_CheckError (page->error);
 
+    /* an ExtGState only carries parameters which are not tracked in the
+       gstate, so the known flags remain valid */
     if (HPDF_Stream_WriteStr (attr->stream, " gs\012") != HPDF_OK)
         return HPDF_CheckError (page->error);
 
@@ -453,8 +533,6 @@ HPDF_Page_Concat  (HPDF_Page         page,
 
     attr = (HPDF_PageAttr)page->attr;
 
-    HPDF_MemSet (buf, 0, HPDF_TMP_BUF_SIZ);
-
     pbuf = HPDF_FToA (pbuf, a, eptr);
     *pbuf++ = ' ';
     pbuf = HPDF_FToA (pbuf, b, eptr);
@@ -505,8 +583,6 @@ HPDF_Page_MoveTo  (HPDF_Page  page,
 
     attr = (HPDF_PageAttr)page->attr;
 
-    HPDF_MemSet (buf, 0, HPDF_TMP_BUF_SIZ);
-
     pbuf = HPDF_FToA (pbuf, x, eptr);
     *pbuf++ = ' ';
     pbuf = HPDF_FToA (pbuf, y, eptr);
@@ -542,8 +618,6 @@ HPDF_Page_LineTo  (HPDF_Page  page,
 
     attr = (HPDF_PageAttr)page->attr;
 
-    HPDF_MemSet (buf, 0, HPDF_TMP_BUF_SIZ);
-
     pbuf = HPDF_FToA (pbuf, x, eptr);
     *pbuf++ = ' ';
     pbuf = HPDF_FToA (pbuf, y, eptr);
@@ -581,8 +655,6 @@ HPDF_Page_CurveTo  (HPDF_Page  page,
 
     attr = (HPDF_PageAttr)page->attr;
 
-    HPDF_MemSet (buf, 0, HPDF_TMP_BUF_SIZ);
-
     pbuf = HPDF_FToA (pbuf, x1, eptr);
     *pbuf++ = ' ';
     pbuf = HPDF_FToA (pbuf, y1, eptr);
@@ -626,8 +698,6 @@ HPDF_Page_CurveTo2  (HPDF_Page  page,
 
     attr = (HPDF_PageAttr)page->attr;
 
-    HPDF_MemSet (buf, 0, HPDF_TMP_BUF_SIZ);
-
     pbuf = HPDF_FToA (pbuf, x2, eptr);
     *pbuf++ = ' ';
     pbuf = HPDF_FToA (pbuf, y2, eptr);
@@ -667,8 +737,6 @@ HPDF_Page_CurveTo3  (HPDF_Page  page,
 
     attr = (HPDF_PageAttr)page->attr;
 
-    HPDF_MemSet (buf, 0, HPDF_TMP_BUF_SIZ);
-
     pbuf = HPDF_FToA (pbuf, x1, eptr);
     *pbuf++ = ' ';
     pbuf = HPDF_FToA (pbuf, y1, eptr);
@@ -731,8 +799,6 @@ HPDF_Page_Rectangle  (HPDF_Page  page,
 
     attr = (HPDF_PageAttr)page->attr;
 
-    HPDF_MemSet (buf, 0, HPDF_TMP_BUF_SIZ);
-
     pbuf = HPDF_FToA (pbuf, x, eptr);
     *pbuf++ = ' ';
     pbuf = HPDF_FToA (pbuf, y, eptr);
@@ -754,6 +820,158 @@ HPDF_Page_Rectangle  (HPDF_Page  page,
 }
 
 
+/* Writes the points in groups of points_per_op, each group followed by
+ * the operator op. The output is collected in a local buffer which is
+ * handed to the stream only when it is nearly full, so that long point
+ * arrays cost one stream write per few hundred bytes instead of one per
+ * operator.
+ */
+static HPDF_STATUS
+InternalWritePoints  (HPDF_PageAttr      attr,
+                      const HPDF_Point  *points,
+                      HPDF_UINT          num_points,
+                      HPDF_UINT          points_per_op,
+                      const char        *op)
+{
+    /* worst case of one operator: 2 numbers per point, each of them at
+     * most "-2147483647.99999" plus a separator, followed by op.
+     */
+    const HPDF_UINT max_op_len = points_per_op * 2 * (HPDF_REAL_LEN * 2 + 1) +
+            HPDF_StrLen (op, -1);
+    char buf[HPDF_TMP_BUF_SIZ];
+    char *pbuf = buf;
+    char *eptr = buf + HPDF_TMP_BUF_SIZ - 1;
+    HPDF_STATUS ret;
+    HPDF_UINT i;
+
+    for (i = 0; i < num_points; i++) {
+        if (i % points_per_op == 0 &&
+                (HPDF_UINT)(eptr - pbuf) < max_op_len) {
+            if ((ret = HPDF_Stream_Write (attr->stream, (HPDF_BYTE *)buf,
+                    (HPDF_UINT)(pbuf - buf))) != HPDF_OK)
+                return ret;
+            pbuf = buf;
+        }
+
+        pbuf = HPDF_FToA (pbuf, points[i].x, eptr);
+        *pbuf++ = ' ';
+        pbuf = HPDF_FToA (pbuf, points[i].y, eptr);
+
+        if ((i + 1) % points_per_op == 0)
+            pbuf = (char *)HPDF_StrCpy (pbuf, op, eptr);
+        else
+            *pbuf++ = ' ';
+    }
+
+    if (pbuf > buf)
+        return HPDF_Stream_Write (attr->stream, (HPDF_BYTE *)buf,
+                (HPDF_UINT)(pbuf - buf));
+
+    return HPDF_OK;
+}
+
+
+static HPDF_STATUS
+InternalPolyline  (HPDF_Page          page,
+                   const HPDF_Point  *points,
+                   HPDF_UINT          num_points)
+{
+    HPDF_PageAttr attr = (HPDF_PageAttr)page->attr;
+
+    if (!points || num_points == 0)
+        return HPDF_RaiseError (page->error, HPDF_INVALID_PARAMETER, 0);
+
+    if (InternalWritePoints (attr, points, 1, 1, " m\012") != HPDF_OK)
+        return HPDF_CheckError (page->error);
+
+    if (InternalWritePoints (attr, points + 1, num_points - 1, 1,
+                " l\012") != HPDF_OK)
+        return HPDF_CheckError (page->error);
+
+    attr->cur_pos = points[num_points - 1];
+    attr->str_pos = points[0];
+    attr->gmode = HPDF_GMODE_PATH_OBJECT;
+
+    return HPDF_OK;
+}
+
+
+/* m, l (bulk) */
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_Page_Polyline  (HPDF_Page          page,
+                     const HPDF_Point  *points,
+                     HPDF_UINT          num_points)
+{
+    HPDF_STATUS ret = HPDF_Page_CheckState (page, HPDF_GMODE_PAGE_DESCRIPTION |
+                    HPDF_GMODE_PATH_OBJECT);
+
+    HPDF_PTRACE ((" HPDF_Page_Polyline\n"));
+
+    if (ret != HPDF_OK)
+        return ret;
+
+    return InternalPolyline (page, points, num_points);
+}
+
+
+/* m, l, h (bulk) */
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_Page_Polygon  (HPDF_Page          page,
+                    const HPDF_Point  *points,
+                    HPDF_UINT          num_points)
+{
+    HPDF_STATUS ret = HPDF_Page_CheckState (page, HPDF_GMODE_PAGE_DESCRIPTION |
+                    HPDF_GMODE_PATH_OBJECT);
+    HPDF_PageAttr attr;
+
+    HPDF_PTRACE ((" HPDF_Page_Polygon\n"));
+
+    if (ret != HPDF_OK)
+        return ret;
+
+    if ((ret = InternalPolyline (page, points, num_points)) != HPDF_OK)
+        return ret;
+
+    attr = (HPDF_PageAttr)page->attr;
+
+    if (HPDF_Stream_WriteStr (attr->stream, "h\012") != HPDF_OK)
+        return HPDF_CheckError (page->error);
+
+    attr->cur_pos = attr->str_pos;
+
+    return ret;
+}
+
+
+/* c (bulk) */
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_Page_CurveToArray  (HPDF_Page          page,
+                         const HPDF_Point  *points,
+                         HPDF_UINT          num_points)
+{
+    HPDF_STATUS ret = HPDF_Page_CheckState (page, HPDF_GMODE_PATH_OBJECT);
+    HPDF_PageAttr attr;
+
+    HPDF_PTRACE ((" HPDF_Page_CurveToArray\n"));
+
+    if (ret != HPDF_OK)
+        return ret;
+
+    /* every curve segment takes two control points and an end point */
+    if (!points || num_points == 0 || num_points % 3 != 0)
+        return HPDF_RaiseError (page->error, HPDF_INVALID_PARAMETER, 0);
+
+    attr = (HPDF_PageAttr)page->attr;
+
+    if (InternalWritePoints (attr, points, num_points, 3, " c\012") != HPDF_OK)
+        return HPDF_CheckError (page->error);
+
+    attr->cur_pos = points[num_points - 1];
+
+    return ret;
+}
+
+
 /*--- Path painting operator ---------------------------------------------*/
 
 /* S */
@@ -1095,6 +1313,10 @@ HPDF_Page_SetCharSpace  (HPDF_Page  page,
     if (value < HPDF_MIN_CHARSPACE || value > HPDF_MAX_CHARSPACE)
         return HPDF_RaiseError (page->error, HPDF_PAGE_OUT_OF_RANGE, 0);
 
+    if (InternalGStateIsKnown (attr, HPDF_GSTATE_CHAR_SPACE) &&
+            attr->gstate->char_space == value)
+        return ret;
+
     if (HPDF_Stream_WriteReal (attr->stream, value) != HPDF_OK)
         return HPDF_CheckError (page->error);
 
@@ -1102,6 +1324,7 @@ HPDF_Page_SetCharSpace  (HPDF_Page  page,
         return HPDF_CheckError (page->error);
 
     attr->gstate->char_space = value;
+    attr->gstate->known |= HPDF_GSTATE_CHAR_SPACE;
 
     return ret;
 }
@@ -1125,6 +1348,10 @@ HPDF_Page_SetWordSpace  (HPDF_Page  page,
     if (value < HPDF_MIN_WORDSPACE || value > HPDF_MAX_WORDSPACE)
         return HPDF_RaiseError (page->error, HPDF_PAGE_OUT_OF_RANGE, 0);
 
+    if (InternalGStateIsKnown (attr, HPDF_GSTATE_WORD_SPACE) &&
+            attr->gstate->word_space == value)
+        return ret;
+
     if (HPDF_Stream_WriteReal (attr->stream, value) != HPDF_OK)
         return HPDF_CheckError (page->error);
 
@@ -1132,6 +1359,7 @@ HPDF_Page_SetWordSpace  (HPDF_Page  page,
         return HPDF_CheckError (page->error);
 
     attr->gstate->word_space = value;
+    attr->gstate->known |= HPDF_GSTATE_WORD_SPACE;
 
     return ret;
 }
@@ -1156,6 +1384,10 @@ HPDF_Page_SetHorizontalScalling  (HPDF_Page  page,
             value > HPDF_MAX_HORIZONTALSCALING)
         return HPDF_RaiseError (page->error, HPDF_PAGE_OUT_OF_RANGE, 0);
 
+    if (InternalGStateIsKnown (attr, HPDF_GSTATE_H_SCALING) &&
+            attr->gstate->h_scalling == value)
+        return ret;
+
     if (HPDF_Stream_WriteReal (attr->stream, value) != HPDF_OK)
         return HPDF_CheckError (page->error);
 
@@ -1163,6 +1395,7 @@ HPDF_Page_SetHorizontalScalling  (HPDF_Page  page,
         return HPDF_CheckError (page->error);
 
     attr->gstate->h_scalling = value;
+    attr->gstate->known |= HPDF_GSTATE_H_SCALING;
 
     return ret;
 }
@@ -1183,6 +1416,10 @@ HPDF_Page_SetTextLeading  (HPDF_Page  page,
 
     attr = (HPDF_PageAttr)page->attr;
 
+    if (InternalGStateIsKnown (attr, HPDF_GSTATE_TEXT_LEADING) &&
+            attr->gstate->text_leading == value)
+        return ret;
+
     if (HPDF_Stream_WriteReal (attr->stream, value) != HPDF_OK)
         return HPDF_CheckError (page->error);
 
@@ -1190,6 +1427,7 @@ HPDF_Page_SetTextLeading  (HPDF_Page  page,
         return HPDF_CheckError (page->error);
 
     attr->gstate->text_leading = value;
+    attr->gstate->known |= HPDF_GSTATE_TEXT_LEADING;
 
     return ret;
 }
@@ -1224,6 +1462,11 @@ HPDF_Page_SetFontAndSize  (HPDF_Page  page,
         return HPDF_RaiseError (page->error, HPDF_PAGE_INVALID_FONT, 0);
 
     attr = (HPDF_PageAttr)page->attr;
+
+    if (InternalGStateIsKnown (attr, HPDF_GSTATE_FONT) &&
+            attr->gstate->font == font && attr->gstate->font_size == size)
+        return ret;
+
     local_name = HPDF_Page_GetLocalFontName (page, font);
 
     if (!local_name)
@@ -1232,7 +1475,6 @@ HPDF_Page_SetFontAndSize  (HPDF_Page  page,
     if (HPDF_Stream_WriteEscapeName (attr->stream, local_name) != HPDF_OK)
         return HPDF_CheckError (page->error);
 
-    HPDF_MemSet (buf, 0, HPDF_TMP_BUF_SIZ);
     *pbuf++ = ' ';
     pbuf = HPDF_FToA (pbuf, size, eptr);
     HPDF_StrCpy (pbuf, " Tf\012", eptr);
@@ -1243,6 +1485,7 @@ HPDF_Page_SetFontAndSize  (HPDF_Page  page,
     attr->gstate->font = font;
     attr->gstate->font_size = size;
     attr->gstate->writing_mode = ((HPDF_FontAttr)font->attr)->writing_mode;
+    attr->gstate->known |= HPDF_GSTATE_FONT;
 
     return ret;
 }
@@ -1267,6 +1510,10 @@ HPDF_Page_SetTextRenderingMode  (HPDF_Page               page,
 
     attr = (HPDF_PageAttr)page->attr;
 
+    if (InternalGStateIsKnown (attr, HPDF_GSTATE_RENDERING_MODE) &&
+            attr->gstate->rendering_mode == mode)
+        return ret;
+
     if (HPDF_Stream_WriteInt (attr->stream, (HPDF_INT)mode) != HPDF_OK)
         return HPDF_CheckError (page->error);
 
@@ -1274,6 +1521,7 @@ HPDF_Page_SetTextRenderingMode  (HPDF_Page               page,
         return HPDF_CheckError (page->error);
 
     attr->gstate->rendering_mode = mode;
+    attr->gstate->known |= HPDF_GSTATE_RENDERING_MODE;
 
     return ret;
 }
@@ -1302,6 +1550,10 @@ HPDF_Page_SetTextRise  (HPDF_Page  page,
 
     attr = (HPDF_PageAttr)page->attr;
 
+    if (InternalGStateIsKnown (attr, HPDF_GSTATE_TEXT_RISE) &&
+            attr->gstate->text_rise == value)
+        return ret;
+
     if (HPDF_Stream_WriteReal (attr->stream, value) != HPDF_OK)
         return HPDF_CheckError (page->error);
 
@@ -1309,6 +1561,7 @@ HPDF_Page_SetTextRise  (HPDF_Page  page,
         return HPDF_CheckError (page->error);
 
     attr->gstate->text_rise = value;
+    attr->gstate->known |= HPDF_GSTATE_TEXT_RISE;
 
     return ret;
 }
@@ -1335,8 +1588,6 @@ HPDF_Page_MoveTextPos  (HPDF_Page  page,
 
     attr = (HPDF_PageAttr)page->attr;
 
-    HPDF_MemSet (buf, 0, HPDF_TMP_BUF_SIZ);
-
     pbuf = HPDF_FToA2 (pbuf, x, eptr, attr->text_placement_accuracy);
     *pbuf++ = ' ';
     pbuf = HPDF_FToA2 (pbuf, y, eptr, attr->text_placement_accuracy);
@@ -1376,8 +1627,6 @@ HPDF_Page_MoveTextPos2  (HPDF_Page  page,
 
     attr = (HPDF_PageAttr)page->attr;
 
-    HPDF_MemSet (buf, 0, HPDF_TMP_BUF_SIZ);
-
     pbuf = HPDF_FToA2 (pbuf, x, eptr, attr->text_placement_accuracy);
     *pbuf++ = ' ';
     pbuf = HPDF_FToA2 (pbuf, y, eptr, attr->text_placement_accuracy);
@@ -1395,6 +1644,7 @@ HPDF_Page_MoveTextPos2  (HPDF_Page  page,
     attr->text_pos.x = attr->text_matrix.x;
     attr->text_pos.y = attr->text_matrix.y;
     attr->gstate->text_leading = -y;
+    attr->gstate->known |= HPDF_GSTATE_TEXT_LEADING;
 
     return ret;
 }
@@ -1425,8 +1675,6 @@ HPDF_Page_SetTextMatrix  (HPDF_Page         page,
     if ((a == 0 || d == 0) && (b == 0 || c == 0))
         return HPDF_RaiseError (page->error, HPDF_INVALID_PARAMETER, 0);
 
-    HPDF_MemSet (buf, 0, HPDF_TMP_BUF_SIZ);
-
     pbuf = HPDF_FToA (pbuf, a, eptr);
     *pbuf++ = ' ';
     pbuf = HPDF_FToA (pbuf, b, eptr);
@@ -1489,6 +1737,16 @@ HPDF_Page_MoveToNextLine  (HPDF_Page  page)
 HPDF_EXPORT(HPDF_STATUS)
 HPDF_Page_ShowText  (HPDF_Page    page,
                      const char  *text)
+{
+    return HPDF_Page_ShowTextLen (page, text,
+            HPDF_StrLen (text, HPDF_LIMIT_MAX_STRING_LEN));
+}
+
+
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_Page_ShowTextLen  (HPDF_Page    page,
+                        const char  *text,
+                        HPDF_UINT    len)
 {
     HPDF_STATUS ret = HPDF_Page_CheckState (page, HPDF_GMODE_TEXT_OBJECT);
     HPDF_PageAttr attr;
@@ -1496,18 +1754,21 @@ HPDF_Page_ShowText  (HPDF_Page    page,
 
     HPDF_PTRACE ((" HPDF_Page_ShowText\n"));
 
-    if (ret != HPDF_OK || text == NULL || text[0] == 0)
+    if (ret != HPDF_OK || text == NULL || len == 0)
         return ret;
 
+    if (len > HPDF_LIMIT_MAX_STRING_LEN)
+        return HPDF_RaiseError (page->error, HPDF_STRING_OUT_OF_RANGE, 0);
+
     attr = (HPDF_PageAttr)page->attr;
 
     /* no font exists */
     if (!attr->gstate->font)
         return HPDF_RaiseError (page->error, HPDF_PAGE_FONT_NOT_FOUND, 0);
 
-    tw = HPDF_Page_TextWidth (page, text);
+    tw = HPDF_Page_TextWidthLen (page, text, len);
 
-    if (InternalWriteText (attr, text) != HPDF_OK)
+    if (InternalWriteText (attr, text, len) != HPDF_OK)
         return HPDF_CheckError (page->error);
 
     if (HPDF_Stream_WriteStr (attr->stream, " Tj\012") != HPDF_OK)
@@ -1526,44 +1787,65 @@ HPDF_Page_ShowText  (HPDF_Page    page,
 }
 
 /* TJ */
-/* ' */
 HPDF_EXPORT(HPDF_STATUS)
-HPDF_Page_ShowTextNextLine  (HPDF_Page    page,
-                             const char  *text)
+HPDF_Page_ShowTextRuns  (HPDF_Page             page,
+                         const HPDF_TextRun   *runs,
+                         HPDF_UINT             count)
 {
     HPDF_STATUS ret = HPDF_Page_CheckState (page, HPDF_GMODE_TEXT_OBJECT);
     HPDF_PageAttr attr;
-    HPDF_REAL tw;
+    HPDF_REAL tw = 0;
+    HPDF_REAL offset = 0;
+    HPDF_REAL pending = 0;
+    HPDF_UINT i;
 
-    HPDF_PTRACE ((" HPDF_Page_ShowTextNextLine\n"));
+    HPDF_PTRACE ((" HPDF_Page_ShowTextRuns\n"));
 
-    if (ret != HPDF_OK)
+    if (ret != HPDF_OK || count == 0)
         return ret;
 
+    if (!runs)
+        return HPDF_RaiseError (page->error, HPDF_INVALID_PARAMETER, 0);
+
     attr = (HPDF_PageAttr)page->attr;
 
     /* no font exists */
     if (!attr->gstate->font)
         return HPDF_RaiseError (page->error, HPDF_PAGE_FONT_NOT_FOUND, 0);
 
-    if (text == NULL || text[0] == 0)
-        return HPDF_Page_MoveToNextLine(page);
-
-    if (InternalWriteText (attr, text) != HPDF_OK)
+    if (HPDF_Stream_WriteChar (attr->stream, '[') != HPDF_OK)
         return HPDF_CheckError (page->error);
 
-    if (HPDF_Stream_WriteStr (attr->stream, " \'\012") != HPDF_OK)
-        return HPDF_CheckError (page->error);
+    for (i = 0; i < count; i++) {
+        const char *text = runs[i].text;
+        HPDF_UINT len = HPDF_StrLen (text, HPDF_LIMIT_MAX_STRING_LEN);
 
-    tw = HPDF_Page_TextWidth (page, text);
+        /* the offsets of empty runs are added to the next one */
+        offset += runs[i].offset;
+        pending += runs[i].offset;
 
-    /* calculate the reference point of text */
-    attr->text_matrix.x -= attr->gstate->text_leading * attr->text_matrix.c;
-    attr->text_matrix.y -= attr->gstate->text_leading * attr->text_matrix.d;
+        if (len == 0)
+            continue;
 
-    attr->text_pos.x = attr->text_matrix.x;
-    attr->text_pos.y = attr->text_matrix.y;
+        if (InternalWriteTJOffset (attr, attr->gstate->writing_mode,
+                    pending) != HPDF_OK)
+            return HPDF_CheckError (page->error);
+
+        pending = 0;
+        tw += HPDF_Page_TextWidthLen (page, text, len);
+
+        if (InternalWriteText (attr, text, len) != HPDF_OK)
+            return HPDF_CheckError (page->error);
+    }
+
+    if (InternalWriteTJOffset (attr, attr->gstate->writing_mode,
+                pending) != HPDF_OK ||
+            HPDF_Stream_WriteStr (attr->stream, "] TJ\012") != HPDF_OK)
+        return HPDF_CheckError (page->error);
 
+    tw += offset * attr->gstate->font_size / 1000;
+
+    /* calculate the reference point of text */
     if (attr->gstate->writing_mode == HPDF_WMODE_HORIZONTAL) {
         attr->text_pos.x += tw * attr->text_matrix.a;
         attr->text_pos.y += tw * attr->text_matrix.b;
@@ -1575,87 +1857,266 @@ HPDF_Page_ShowTextNextLine  (HPDF_Page    page,
     return ret;
 }
 
-/* " */
+/* Tj and TJ with the glyph font of a Type0 font based on a TrueType font.
+ * the glyph font is selected for the glyphs only, the font of the graphics
+ * state is selected again after them.
+ */
 HPDF_EXPORT(HPDF_STATUS)
-HPDF_Page_ShowTextNextLineEx  (HPDF_Page    page,
-                               HPDF_REAL    word_space,
-                               HPDF_REAL    char_space,
-                               const char  *text)
+HPDF_Page_ShowGlyphs  (HPDF_Page            page,
+                       const HPDF_UINT16   *glyphs,
+                       const HPDF_REAL     *advances,
+                       HPDF_UINT            count,
+                       const char          *text,
+                       const HPDF_UINT     *clusters)
 {
     HPDF_STATUS ret = HPDF_Page_CheckState (page, HPDF_GMODE_TEXT_OBJECT);
     HPDF_PageAttr attr;
+    HPDF_Font font;
+    HPDF_FontAttr font_attr;
+    HPDF_Font glyph_font;
+    const char *local_name;
+    HPDF_BYTE codes[HPDF_TEXT_DEFAULT_LEN];
+    HPDF_UINT num_codes = 0;
+    HPDF_BOOL in_string = HPDF_FALSE;
+    HPDF_REAL width = 0;
     HPDF_REAL tw;
-    char buf[HPDF_TMP_BUF_SIZ];
-    char *pbuf = buf;
-    char *eptr = buf + HPDF_TMP_BUF_SIZ - 1;
+    HPDF_UINT i;
 
-    HPDF_PTRACE ((" HPDF_Page_ShowTextNextLineEX\n"));
+    HPDF_PTRACE ((" HPDF_Page_ShowGlyphs\n"));
 
-    if (ret != HPDF_OK)
+    if (ret != HPDF_OK || count == 0)
         return ret;
 
-    if (word_space < HPDF_MIN_WORDSPACE || word_space > HPDF_MAX_WORDSPACE)
-        return HPDF_RaiseError (page->error, HPDF_PAGE_OUT_OF_RANGE, 0);
-
-    if (char_space < HPDF_MIN_CHARSPACE || char_space > HPDF_MAX_CHARSPACE)
-        return HPDF_RaiseError (page->error, HPDF_PAGE_OUT_OF_RANGE, 0);
+    if (!glyphs)
+        return HPDF_RaiseError (page->error, HPDF_INVALID_PARAMETER, 0);
 
     attr = (HPDF_PageAttr)page->attr;
+    font = attr->gstate->font;
 
     /* no font exists */
-    if (!attr->gstate->font)
+    if (!font)
         return HPDF_RaiseError (page->error, HPDF_PAGE_FONT_NOT_FOUND, 0);
 
-    if (text == NULL || text[0] == 0)
-        return HPDF_Page_MoveToNextLine(page);
-
-    HPDF_MemSet (buf, 0, HPDF_TMP_BUF_SIZ);
-    pbuf = HPDF_FToA (pbuf, word_space, eptr);
-    *pbuf++ = ' ';
-    pbuf = HPDF_FToA (pbuf, char_space, eptr);
-    *pbuf = ' ';
+    font_attr = (HPDF_FontAttr)font->attr;
+    if (font_attr->type != HPDF_FONT_TYPE0_TT)
+        return HPDF_RaiseError (page->error, HPDF_PAGE_INVALID_FONT, 0);
 
-    if (InternalWriteText (attr, buf) != HPDF_OK)
+    glyph_font = HPDF_Type0Font_GetGlyphFont (font);
+    if (!glyph_font)
         return HPDF_CheckError (page->error);
 
-    if (InternalWriteText (attr, text) != HPDF_OK)
+    if (HPDF_Type0Font_UseGlyphs (glyph_font, glyphs, count, text,
+                clusters) != HPDF_OK)
         return HPDF_CheckError (page->error);
 
-    if (HPDF_Stream_WriteStr (attr->stream, " \"\012") != HPDF_OK)
+    local_name = HPDF_Page_GetLocalFontName (page, glyph_font);
+    if (!local_name)
+        return HPDF_RaiseError (page->error, HPDF_PAGE_INVALID_FONT, 0);
+
+    if (InternalWriteTf (attr, local_name) != HPDF_OK ||
+            (advances && HPDF_Stream_WriteChar (attr->stream, '[') !=
+            HPDF_OK))
         return HPDF_CheckError (page->error);
 
-    attr->gstate->word_space = word_space;
-    attr->gstate->char_space = char_space;
+    /* the glyph ids are the codes of the glyph font, the advances which
+     * differ from the widths of the glyphs move the next glyph */
+    for (i = 0; i < count; i++) {
+        HPDF_INT w = HPDF_TTFontDef_GetGidWidth (font_attr->fontdef,
+                glyphs[i]);
 
-    tw = HPDF_Page_TextWidth (page, text);
+        if (!in_string) {
+            if (HPDF_Stream_WriteChar (attr->stream, '<') != HPDF_OK)
+                return HPDF_CheckError (page->error);
 
-    /* calculate the reference point of text */
-    attr->text_matrix.x += attr->gstate->text_leading * attr->text_matrix.b;
-    attr->text_matrix.y -= attr->gstate->text_leading * attr->text_matrix.a;
+            in_string = HPDF_TRUE;
+        }
 
-    attr->text_pos.x = attr->text_matrix.x;
-    attr->text_pos.y = attr->text_matrix.y;
+        codes[num_codes++] = (HPDF_BYTE)(glyphs[i] >> 8);
+        codes[num_codes++] = (HPDF_BYTE)glyphs[i];
 
-    if (attr->gstate->writing_mode == HPDF_WMODE_HORIZONTAL) {
-        attr->text_pos.x += tw * attr->text_matrix.a;
-        attr->text_pos.y += tw * attr->text_matrix.b;
-    } else {
-        attr->text_pos.x -= tw * attr->text_matrix.b;
-        attr->text_pos.y -= tw * attr->text_matrix.a;
-    }
+        if (num_codes == HPDF_TEXT_DEFAULT_LEN ||
+                (advances && advances[i] != w)) {
+            if (HPDF_Stream_WriteBinary (attr->stream, codes, num_codes,
+                        NULL) != HPDF_OK)
+                return HPDF_CheckError (page->error);
 
-    return ret;
-}
+            num_codes = 0;
+        }
 
+        if (advances && advances[i] != w) {
+            if (HPDF_Stream_WriteChar (attr->stream, '>') != HPDF_OK ||
+                    InternalWriteTJOffset (attr, HPDF_WMODE_HORIZONTAL,
+                    advances[i] - w) != HPDF_OK)
+                return HPDF_CheckError (page->error);
 
-/*--- Color showing ------------------------------------------------------*/
+            in_string = HPDF_FALSE;
+        }
 
-/* cs --not implemented yet */
-/* CS --not implemented yet */
-/* sc --not implemented yet */
-/* scn --not implemented yet */
-/* SC --not implemented yet */
-/* SCN --not implemented yet */
+        width += advances ? advances[i] : w;
+    }
+
+    if (in_string && (HPDF_Stream_WriteBinary (attr->stream, codes,
+                num_codes, NULL) != HPDF_OK ||
+            HPDF_Stream_WriteChar (attr->stream, '>') != HPDF_OK))
+        return HPDF_CheckError (page->error);
+
+    if (HPDF_Stream_WriteStr (attr->stream, advances ? "] TJ\012" :
+                " Tj\012") != HPDF_OK)
+        return HPDF_CheckError (page->error);
+
+    local_name = HPDF_Page_GetLocalFontName (page, font);
+    if (!local_name)
+        return HPDF_RaiseError (page->error, HPDF_PAGE_INVALID_FONT, 0);
+
+    if (InternalWriteTf (attr, local_name) != HPDF_OK)
+        return HPDF_CheckError (page->error);
+
+    tw = width * attr->gstate->font_size / 1000;
+    tw += attr->gstate->char_space * count;
+
+    /* calculate the reference point of text. the glyph font always writes
+     * horizontally, whatever the writing mode of the font it belongs to */
+    attr->text_pos.x += tw * attr->text_matrix.a;
+    attr->text_pos.y += tw * attr->text_matrix.b;
+
+    return ret;
+}
+
+/* ' */
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_Page_ShowTextNextLine  (HPDF_Page    page,
+                             const char  *text)
+{
+    HPDF_STATUS ret = HPDF_Page_CheckState (page, HPDF_GMODE_TEXT_OBJECT);
+    HPDF_PageAttr attr;
+    HPDF_REAL tw;
+    HPDF_UINT len;
+
+    HPDF_PTRACE ((" HPDF_Page_ShowTextNextLine\n"));
+
+    if (ret != HPDF_OK)
+        return ret;
+
+    attr = (HPDF_PageAttr)page->attr;
+
+    /* no font exists */
+    if (!attr->gstate->font)
+        return HPDF_RaiseError (page->error, HPDF_PAGE_FONT_NOT_FOUND, 0);
+
+    len = HPDF_StrLen (text, HPDF_LIMIT_MAX_STRING_LEN);
+    if (len == 0)
+        return HPDF_Page_MoveToNextLine(page);
+
+    if (InternalWriteText (attr, text, len) != HPDF_OK)
+        return HPDF_CheckError (page->error);
+
+    if (HPDF_Stream_WriteStr (attr->stream, " \'\012") != HPDF_OK)
+        return HPDF_CheckError (page->error);
+
+    tw = HPDF_Page_TextWidthLen (page, text, len);
+
+    /* calculate the reference point of text */
+    attr->text_matrix.x -= attr->gstate->text_leading * attr->text_matrix.c;
+    attr->text_matrix.y -= attr->gstate->text_leading * attr->text_matrix.d;
+
+    attr->text_pos.x = attr->text_matrix.x;
+    attr->text_pos.y = attr->text_matrix.y;
+
+    if (attr->gstate->writing_mode == HPDF_WMODE_HORIZONTAL) {
+        attr->text_pos.x += tw * attr->text_matrix.a;
+        attr->text_pos.y += tw * attr->text_matrix.b;
+    } else {
+        attr->text_pos.x -= tw * attr->text_matrix.b;
+        attr->text_pos.y -= tw * attr->text_matrix.a;
+    }
+
+    return ret;
+}
+
+/* " */
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_Page_ShowTextNextLineEx  (HPDF_Page    page,
+                               HPDF_REAL    word_space,
+                               HPDF_REAL    char_space,
+                               const char  *text)
+{
+    HPDF_STATUS ret = HPDF_Page_CheckState (page, HPDF_GMODE_TEXT_OBJECT);
+    HPDF_PageAttr attr;
+    HPDF_REAL tw;
+    char buf[HPDF_TMP_BUF_SIZ];
+    char *pbuf = buf;
+    char *eptr = buf + HPDF_TMP_BUF_SIZ - 1;
+    HPDF_UINT len;
+
+    HPDF_PTRACE ((" HPDF_Page_ShowTextNextLineEX\n"));
+
+    if (ret != HPDF_OK)
+        return ret;
+
+    if (word_space < HPDF_MIN_WORDSPACE || word_space > HPDF_MAX_WORDSPACE)
+        return HPDF_RaiseError (page->error, HPDF_PAGE_OUT_OF_RANGE, 0);
+
+    if (char_space < HPDF_MIN_CHARSPACE || char_space > HPDF_MAX_CHARSPACE)
+        return HPDF_RaiseError (page->error, HPDF_PAGE_OUT_OF_RANGE, 0);
+
+    attr = (HPDF_PageAttr)page->attr;
+
+    /* no font exists */
+    if (!attr->gstate->font)
+        return HPDF_RaiseError (page->error, HPDF_PAGE_FONT_NOT_FOUND, 0);
+
+    len = HPDF_StrLen (text, HPDF_LIMIT_MAX_STRING_LEN);
+    if (len == 0)
+        return HPDF_Page_MoveToNextLine(page);
+
+    pbuf = HPDF_FToA (pbuf, word_space, eptr);
+    *pbuf++ = ' ';
+    pbuf = HPDF_FToA (pbuf, char_space, eptr);
+    *pbuf++ = ' ';
+    *pbuf = 0;
+
+    if (InternalWriteText (attr, buf, (HPDF_UINT)(pbuf - buf)) != HPDF_OK)
+        return HPDF_CheckError (page->error);
+
+    if (InternalWriteText (attr, text, len) != HPDF_OK)
+        return HPDF_CheckError (page->error);
+
+    if (HPDF_Stream_WriteStr (attr->stream, " \"\012") != HPDF_OK)
+        return HPDF_CheckError (page->error);
+
+    attr->gstate->word_space = word_space;
+    attr->gstate->char_space = char_space;
+    attr->gstate->known |= HPDF_GSTATE_WORD_SPACE | HPDF_GSTATE_CHAR_SPACE;
+
+    tw = HPDF_Page_TextWidthLen (page, text, len);
+
+    /* calculate the reference point of text */
+    attr->text_matrix.x += attr->gstate->text_leading * attr->text_matrix.b;
+    attr->text_matrix.y -= attr->gstate->text_leading * attr->text_matrix.a;
+
+    attr->text_pos.x = attr->text_matrix.x;
+    attr->text_pos.y = attr->text_matrix.y;
+
+    if (attr->gstate->writing_mode == HPDF_WMODE_HORIZONTAL) {
+        attr->text_pos.x += tw * attr->text_matrix.a;
+        attr->text_pos.y += tw * attr->text_matrix.b;
+    } else {
+        attr->text_pos.x -= tw * attr->text_matrix.b;
+        attr->text_pos.y -= tw * attr->text_matrix.a;
+    }
+
+    return ret;
+}
+
+
+/*--- Color showing ------------------------------------------------------*/
+
+/* cs --not implemented yet */
+/* CS --not implemented yet */
+/* sc --not implemented yet */
+/* scn --not implemented yet */
+/* SC --not implemented yet */
+/* SCN --not implemented yet */
 
 /* g */
 
@@ -1677,6 +2138,11 @@ HPDF_Page_SetGrayFill  (HPDF_Page  page,
     if (gray < 0 || gray > 1)
         return HPDF_RaiseError (page->error, HPDF_PAGE_OUT_OF_RANGE, 0);
 
+    if (InternalGStateIsKnown (attr, HPDF_GSTATE_FILL_COLOR) &&
+            attr->gstate->cs_fill == HPDF_CS_DEVICE_GRAY &&
+            attr->gstate->gray_fill == gray)
+        return ret;
+
     if (HPDF_Stream_WriteReal (attr->stream, gray) != HPDF_OK)
         return HPDF_CheckError (page->error);
 
@@ -1685,6 +2151,7 @@ HPDF_Page_SetGrayFill  (HPDF_Page  page,
 
     attr->gstate->gray_fill = gray;
     attr->gstate->cs_fill = HPDF_CS_DEVICE_GRAY;
+    attr->gstate->known |= HPDF_GSTATE_FILL_COLOR;
 
     return ret;
 }
@@ -1708,6 +2175,11 @@ HPDF_Page_SetGrayStroke  (HPDF_Page  page,
     if (gray < 0 || gray > 1)
         return HPDF_RaiseError (page->error, HPDF_PAGE_OUT_OF_RANGE, 0);
 
+    if (InternalGStateIsKnown (attr, HPDF_GSTATE_STROKE_COLOR) &&
+            attr->gstate->cs_stroke == HPDF_CS_DEVICE_GRAY &&
+            attr->gstate->gray_stroke == gray)
+        return ret;
+
     if (HPDF_Stream_WriteReal (attr->stream, gray) != HPDF_OK)
         return HPDF_CheckError (page->error);
 
@@ -1716,6 +2188,7 @@ HPDF_Page_SetGrayStroke  (HPDF_Page  page,
 
     attr->gstate->gray_stroke = gray;
     attr->gstate->cs_stroke = HPDF_CS_DEVICE_GRAY;
+    attr->gstate->known |= HPDF_GSTATE_STROKE_COLOR;
 
     return ret;
 }
@@ -1744,7 +2217,11 @@ HPDF_Page_SetRGBFill  (HPDF_Page  page,
 
     attr = (HPDF_PageAttr)page->attr;
 
-    HPDF_MemSet (buf, 0, HPDF_TMP_BUF_SIZ);
+    if (InternalGStateIsKnown (attr, HPDF_GSTATE_FILL_COLOR) &&
+            attr->gstate->cs_fill == HPDF_CS_DEVICE_RGB &&
+            attr->gstate->rgb_fill.r == r && attr->gstate->rgb_fill.g == g &&
+            attr->gstate->rgb_fill.b == b)
+        return ret;
 
     pbuf = HPDF_FToA (pbuf, r, eptr);
     *pbuf++ = ' ';
@@ -1760,6 +2237,7 @@ HPDF_Page_SetRGBFill  (HPDF_Page  page,
     attr->gstate->rgb_fill.g = g;
     attr->gstate->rgb_fill.b = b;
     attr->gstate->cs_fill = HPDF_CS_DEVICE_RGB;
+    attr->gstate->known |= HPDF_GSTATE_FILL_COLOR;
 
     return ret;
 }
@@ -1788,7 +2266,11 @@ HPDF_Page_SetRGBStroke  (HPDF_Page  page,
 
     attr = (HPDF_PageAttr)page->attr;
 
-    HPDF_MemSet (buf, 0, HPDF_TMP_BUF_SIZ);
+    if (InternalGStateIsKnown (attr, HPDF_GSTATE_STROKE_COLOR) &&
+            attr->gstate->cs_stroke == HPDF_CS_DEVICE_RGB &&
+            attr->gstate->rgb_stroke.r == r && attr->gstate->rgb_stroke.g == g &&
+            attr->gstate->rgb_stroke.b == b)
+        return ret;
 
     pbuf = HPDF_FToA (pbuf, r, eptr);
     *pbuf++ = ' ';
@@ -1804,6 +2286,7 @@ HPDF_Page_SetRGBStroke  (HPDF_Page  page,
     attr->gstate->rgb_stroke.g = g;
     attr->gstate->rgb_stroke.b = b;
     attr->gstate->cs_stroke = HPDF_CS_DEVICE_RGB;
+    attr->gstate->known |= HPDF_GSTATE_STROKE_COLOR;
 
     return ret;
 }
@@ -1833,7 +2316,11 @@ HPDF_Page_SetCMYKFill  (HPDF_Page  page,
 
     attr = (HPDF_PageAttr)page->attr;
 
-    HPDF_MemSet (buf, 0, HPDF_TMP_BUF_SIZ);
+    if (InternalGStateIsKnown (attr, HPDF_GSTATE_FILL_COLOR) &&
+            attr->gstate->cs_fill == HPDF_CS_DEVICE_CMYK &&
+            attr->gstate->cmyk_fill.c == c && attr->gstate->cmyk_fill.m == m &&
+            attr->gstate->cmyk_fill.y == y && attr->gstate->cmyk_fill.k == k)
+        return ret;
 
     pbuf = HPDF_FToA (pbuf, c, eptr);
     *pbuf++ = ' ';
@@ -1852,6 +2339,7 @@ HPDF_Page_SetCMYKFill  (HPDF_Page  page,
     attr->gstate->cmyk_fill.y = y;
     attr->gstate->cmyk_fill.k = k;
     attr->gstate->cs_fill = HPDF_CS_DEVICE_CMYK;
+    attr->gstate->known |= HPDF_GSTATE_FILL_COLOR;
 
     return ret;
 }
@@ -1881,7 +2369,11 @@ HPDF_Page_SetCMYKStroke  (HPDF_Page  page,
 
     attr = (HPDF_PageAttr)page->attr;
 
-    HPDF_MemSet (buf, 0, HPDF_TMP_BUF_SIZ);
+    if (InternalGStateIsKnown (attr, HPDF_GSTATE_STROKE_COLOR) &&
+            attr->gstate->cs_stroke == HPDF_CS_DEVICE_CMYK &&
+            attr->gstate->cmyk_stroke.c == c && attr->gstate->cmyk_stroke.m == m &&
+            attr->gstate->cmyk_stroke.y == y && attr->gstate->cmyk_stroke.k == k)
+        return ret;
 
     pbuf = HPDF_FToA (pbuf, c, eptr);
     *pbuf++ = ' ';
@@ -1900,6 +2392,7 @@ HPDF_Page_SetCMYKStroke  (HPDF_Page  page,
     attr->gstate->cmyk_stroke.y = y;
     attr->gstate->cmyk_stroke.k = k;
     attr->gstate->cs_stroke = HPDF_CS_DEVICE_CMYK;
+    attr->gstate->known |= HPDF_GSTATE_STROKE_COLOR;
 
     return ret;
 }
@@ -2218,8 +2711,6 @@ HPDF_Page_Circle  (HPDF_Page     page,
 
     attr = (HPDF_PageAttr)page->attr;
 
-    HPDF_MemSet (buf, 0, HPDF_TMP_BUF_SIZ);
-
     pbuf = HPDF_FToA (pbuf, x - ray, eptr);
     *pbuf++ = ' ';
     pbuf = HPDF_FToA (pbuf, y, eptr);
@@ -2351,8 +2842,6 @@ HPDF_Page_Ellipse  (HPDF_Page   page,
 
     attr = (HPDF_PageAttr)page->attr;
 
-    HPDF_MemSet (buf, 0, HPDF_TMP_BUF_SIZ);
-
     pbuf = HPDF_FToA (pbuf, x - xray, eptr);
     *pbuf++ = ' ';
     pbuf = HPDF_FToA (pbuf, y, eptr);
@@ -2456,8 +2945,6 @@ InternalArc  (HPDF_Page    page,
 
     attr = (HPDF_PageAttr)page->attr;
 
-    HPDF_MemSet (buf, 0, HPDF_TMP_BUF_SIZ);
-
     delta_angle = (90 - (HPDF_DOUBLE)(ang1 + ang2) / 2) / 180 * PIE;
     new_angle = (HPDF_DOUBLE)(ang2 - ang1) / 2 / 180 * PIE;
 
@@ -2586,9 +3073,59 @@ HPDF_Page_DrawImage  (HPDF_Page    page,
 }
 
 
+static HPDF_STATUS
+InternalWriteTf  (HPDF_PageAttr   attr,
+                  const char     *local_name)
+{
+    char buf[HPDF_TMP_BUF_SIZ];
+    char *pbuf = buf;
+    char *eptr = buf + HPDF_TMP_BUF_SIZ - 1;
+    HPDF_STATUS ret;
+
+    if ((ret = HPDF_Stream_WriteEscapeName (attr->stream, local_name)) !=
+            HPDF_OK)
+        return ret;
+
+    *pbuf++ = ' ';
+    pbuf = HPDF_FToA (pbuf, attr->gstate->font_size, eptr);
+    HPDF_StrCpy (pbuf, " Tf\012", eptr);
+
+    return HPDF_Stream_WriteStr (attr->stream, buf);
+}
+
+
+static HPDF_STATUS
+InternalWriteTJOffset  (HPDF_PageAttr      attr,
+                        HPDF_WritingMode   wmode,
+                        HPDF_REAL          offset)
+{
+    char buf[HPDF_REAL_LEN + 2];
+    char *pbuf;
+
+    if (offset == 0)
+        return HPDF_OK;
+
+    /* the numbers of TJ move against the writing direction in horizontal
+     * writing, and along it in vertical writing */
+    if (wmode == HPDF_WMODE_HORIZONTAL)
+        offset = -offset;
+
+    pbuf = HPDF_FToA (buf, offset, buf + HPDF_REAL_LEN);
+    *pbuf++ = ' ';
+    *pbuf = 0;
+
+    return HPDF_Stream_WriteStr (attr->stream, buf);
+}
+
+
+/* writes the text as a string of the current font. the text of a Type0 font
+ * is encoded in pieces into a buffer on the stack, so no memory is allocated
+ * for it.
+ */
 static HPDF_STATUS
 InternalWriteText  (HPDF_PageAttr      attr,
-                    const char        *text)
+                    const char        *text,
+                    HPDF_UINT          len)
 {
     HPDF_FontAttr font_attr = (HPDF_FontAttr)attr->gstate->font->attr;
     HPDF_STATUS ret;
@@ -2597,39 +3134,40 @@ InternalWriteText  (HPDF_PageAttr      attr,
 
     if (font_attr->type == HPDF_FONT_TYPE0_TT ||
             font_attr->type == HPDF_FONT_TYPE0_CID) {
-        HPDF_Encoder encoder;
-	HPDF_UINT len;
+        HPDF_Encoder encoder = font_attr->encoder;
 
         if ((ret = HPDF_Stream_WriteStr (attr->stream, "<")) != HPDF_OK)
             return ret;
 
-        encoder = font_attr->encoder;
-        len = HPDF_StrLen (text, HPDF_LIMIT_MAX_STRING_LEN);
-
         if (encoder->encode_text_fn == NULL) {
-	    if ((ret = HPDF_Stream_WriteBinary (attr->stream, (HPDF_BYTE *)text,
-						len, NULL))
-		!= HPDF_OK)
-	        return ret;
+            if ((ret = HPDF_Stream_WriteBinary (attr->stream,
+                            (const HPDF_BYTE *)text, len, NULL)) != HPDF_OK)
+                return ret;
         } else {
-	    char *encoded;
-	    HPDF_UINT length;
+            HPDF_BYTE buf[HPDF_TEXT_DEFAULT_LEN];
+            HPDF_UINT i = 0;
 
-	    encoded = (encoder->encode_text_fn)(encoder, text, len, &length);
+            while (i < len) {
+                HPDF_UINT length;
+                HPDF_UINT n = encoder->encode_text_fn (encoder,
+                        &font_attr->ucs4_map, text + i, len - i, buf,
+                        HPDF_TEXT_DEFAULT_LEN, &length);
 
-	    ret = HPDF_Stream_WriteBinary (attr->stream, (HPDF_BYTE *)encoded,
-					   length, NULL);
+                if (n == 0)
+                    break;
 
-	    free(encoded);
+                if ((ret = HPDF_Stream_WriteBinary (attr->stream, buf,
+                                length, NULL)) != HPDF_OK)
+                    return ret;
 
-	    if (ret != HPDF_OK)
-                return ret;
+                i += n;
+            }
         }
 
         return HPDF_Stream_WriteStr (attr->stream, ">");
     }
 
-    return HPDF_Stream_WriteEscapeText (attr->stream, text);
+    return HPDF_Stream_WriteEscapeText2 (attr->stream, text, len);
 }
 
 
@@ -2665,6 +3203,18 @@ HPDF_Page_TextOut  (HPDF_Page    page,
                     HPDF_REAL    xpos,
                     HPDF_REAL    ypos,
                     const char  *text)
+{
+    return HPDF_Page_TextOutLen (page, xpos, ypos, text,
+            HPDF_StrLen (text, HPDF_LIMIT_MAX_STRING_LEN));
+}
+
+
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_Page_TextOutLen  (HPDF_Page    page,
+                       HPDF_REAL    xpos,
+                       HPDF_REAL    ypos,
+                       const char  *text,
+                       HPDF_UINT    len)
 {
     HPDF_STATUS ret = HPDF_Page_CheckState (page, HPDF_GMODE_TEXT_OBJECT);
     HPDF_REAL x;
@@ -2681,7 +3231,7 @@ HPDF_Page_TextOut  (HPDF_Page    page,
     if ((ret = HPDF_Page_MoveTextPos (page, x, y)) != HPDF_OK)
         return ret;
 
-    return  HPDF_Page_ShowText (page, text);
+    return  HPDF_Page_ShowTextLen (page, text, len);
 }
 
 
@@ -2696,7 +3246,50 @@ HPDF_Page_TextRect  (HPDF_Page            page,
                      HPDF_UINT           *len
                      )
 {
-    return InternalTextRect(page, left, top, right, bottom, text, align, len, HPDF_FALSE, HPDF_TRUE);
+    return InternalTextRect(page, left, top, right, bottom, text,
+            HPDF_StrLen (text, HPDF_LIMIT_MAX_STRING_LEN + 1), align, len,
+            HPDF_FALSE, HPDF_TRUE);
+}
+
+
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_Page_TextRectLen  (HPDF_Page            page,
+                        HPDF_REAL            left,
+                        HPDF_REAL            top,
+                        HPDF_REAL            right,
+                        HPDF_REAL            bottom,
+                        const char          *text,
+                        HPDF_UINT            text_len,
+                        HPDF_TextAlignment   align,
+                        HPDF_UINT           *len)
+{
+    return InternalTextRect(page, left, top, right, bottom, text, text_len,
+            align, len, HPDF_FALSE, HPDF_TRUE);
+}
+
+
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_Page_TextLayoutRect  (HPDF_Page            page,
+                           HPDF_TextLayout      layout,
+                           HPDF_REAL            left,
+                           HPDF_REAL            top,
+                           HPDF_REAL            right,
+                           HPDF_REAL            bottom,
+                           HPDF_TextAlignment   align,
+                           HPDF_UINT           *len)
+{
+    HPDF_STATUS ret = HPDF_Page_CheckState (page, HPDF_GMODE_TEXT_OBJECT);
+
+    HPDF_PTRACE ((" HPDF_Page_TextLayoutRect\n"));
+
+    if (ret != HPDF_OK)
+        return ret;
+
+    if (!layout)
+        return HPDF_RaiseError (page->error, HPDF_INVALID_PARAMETER, 0);
+
+    return LayoutTextRect (page, layout, left, top, right, bottom, align, len,
+            HPDF_FALSE, HPDF_TRUE);
 }
 
 static HPDF_STATUS
@@ -2706,6 +3299,7 @@ InternalTextRect  (HPDF_Page            page,
                    HPDF_REAL            right,
                    HPDF_REAL            bottom,
                    const char          *text,
+                   HPDF_UINT            text_len,
                    HPDF_TextAlignment   align,
                    HPDF_UINT           *len,
                    HPDF_BOOL            force,
@@ -2713,13 +3307,10 @@ InternalTextRect  (HPDF_Page            page,
 {
     HPDF_STATUS ret = HPDF_Page_CheckState (page, HPDF_GMODE_TEXT_OBJECT);
     HPDF_PageAttr attr;
-    const char *ptr = text;
-    HPDF_BOOL pos_initialized = HPDF_FALSE;
-    HPDF_REAL save_char_space = 0;
-    HPDF_BOOL is_insufficient_space = HPDF_FALSE;
+    HPDF_TextUnit buf[HPDF_TEXT_DEFAULT_LEN];
+    HPDF_TextUnit *units = buf;
+    HPDF_TextLayout_Rec layout;
     HPDF_UINT num_rest;
-    HPDF_Box bbox;
-    HPDF_BOOL char_space_changed = HPDF_FALSE;
 
     HPDF_PTRACE ((" HPDF_Page_TextRect\n"));
 
@@ -2735,13 +3326,78 @@ InternalTextRect  (HPDF_Page            page,
 
     if (len)
         *len = 0;
-    num_rest = HPDF_StrLen (text, HPDF_LIMIT_MAX_STRING_LEN + 1);
+    num_rest = text ? text_len : 0;
 
     if (num_rest > HPDF_LIMIT_MAX_STRING_LEN) {
         return HPDF_RaiseError (page->error, HPDF_STRING_OUT_OF_RANGE, 0);
     } else if (!num_rest)
         return HPDF_OK;
 
+    /* the text is measured once into units, which short texts keep on the
+     * stack.
+     */
+    if (num_rest >= HPDF_TEXT_DEFAULT_LEN) {
+        units = HPDF_GetMem (page->mmgr,
+                sizeof(HPDF_TextUnit) * (num_rest + 1));
+        if (!units)
+            return HPDF_CheckError (page->error);
+    }
+
+    HPDF_TextLayout_Init (&layout, page->mmgr, text, num_rest, units);
+
+    ret = LayoutTextRect (page, &layout, left, top, right, bottom, align, len,
+            force, use_bbox);
+
+    if (units != buf)
+        HPDF_FreeMem (page->mmgr, units);
+
+    return ret;
+}
+
+
+static HPDF_STATUS
+LayoutTextRect  (HPDF_Page            page,
+                 HPDF_TextLayout      layout,
+                 HPDF_REAL            left,
+                 HPDF_REAL            top,
+                 HPDF_REAL            right,
+                 HPDF_REAL            bottom,
+                 HPDF_TextAlignment   align,
+                 HPDF_UINT           *len,
+                 HPDF_BOOL            force,
+                 HPDF_BOOL            use_bbox)
+{
+    HPDF_STATUS ret;
+    HPDF_PageAttr attr = (HPDF_PageAttr )page->attr;
+    HPDF_BOOL pos_initialized = HPDF_FALSE;
+    HPDF_REAL save_char_space = 0;
+    HPDF_BOOL is_insufficient_space = HPDF_FALSE;
+    HPDF_Box bbox;
+    HPDF_BOOL char_space_changed = HPDF_FALSE;
+    HPDF_UINT first;
+    HPDF_TextWidth rest;
+
+    /* no font exists */
+    if (!attr->gstate->font) {
+        return HPDF_RaiseError (page->error, HPDF_PAGE_FONT_NOT_FOUND, 0);
+    }
+
+    if (len)
+        *len = 0;
+
+    if (layout->pos >= layout->len)
+        return HPDF_OK;
+
+    if ((ret = HPDF_TextLayout_Measure (layout, attr->gstate->font))
+            != HPDF_OK)
+        return ret;
+
+    /* the width of the rest of the text, which each line moves the text
+     * position by.
+     */
+    first = HPDF_TextLayout_FindUnit (layout, layout->pos);
+    rest = HPDF_TextLayout_TextWidth (layout, first, layout->num_units);
+
     if (use_bbox) {
         bbox = HPDF_Font_GetBBox (attr->gstate->font);
 
@@ -2768,25 +3424,41 @@ InternalTextRect  (HPDF_Page            page,
         attr->gstate->char_space = 0;
     }
 
+    /* char_space is zeroed below for measuring only, so the value in the
+     * gstate no longer reflects the content stream.
+     */
+    attr->gstate->known &= ~HPDF_GSTATE_CHAR_SPACE;
+
     for (;;) {
         HPDF_REAL x, y;
+        const char *ptr = layout->text + layout->units[first].offset;
+        HPDF_UINT next;
         HPDF_UINT line_len, tmp_len;
         HPDF_REAL rw;
+        HPDF_REAL tw;
+        HPDF_TextWidth line;
         HPDF_BOOL LineBreak;
 
         attr->gstate->char_space = 0;
-        line_len = tmp_len = HPDF_Page_MeasureText (page, ptr, right - left, HPDF_TRUE, &rw);
-        if (force && line_len == 0) {
-            line_len = tmp_len = HPDF_Page_MeasureText (page, ptr, right - left, HPDF_FALSE, &rw);
+        attr->gstate->known &= ~HPDF_GSTATE_CHAR_SPACE;
+        next = HPDF_TextLayout_MeasureLine (layout, first, right - left,
+                attr->gstate->font_size, attr->gstate->char_space,
+                attr->gstate->word_space, HPDF_TRUE, &rw);
+        if (force && next == first) {
+            next = HPDF_TextLayout_MeasureLine (layout, first, right - left,
+                    attr->gstate->font_size, attr->gstate->char_space,
+                    attr->gstate->word_space, HPDF_FALSE, &rw);
         }
-        if (line_len == 0) {
+        if (next == first) {
             is_insufficient_space = HPDF_TRUE;
             break;
         }
 
+        line_len = tmp_len = layout->units[next].offset -
+                layout->units[first].offset;
         if (len)
             *len += line_len;
-        num_rest -= line_len;
+        layout->pos = layout->units[next].offset;
 
         /* Shorten tmp_len by trailing whitespace and control characters. */
         LineBreak = HPDF_FALSE;
@@ -2830,7 +3502,7 @@ InternalTextRect  (HPDF_Page            page,
                 }
 
                 /* Do not justify last line of paragraph or text. */
-                if (LineBreak || num_rest <= 0) {
+                if (LineBreak || next == layout->num_units) {
                     if ((ret = HPDF_Page_SetCharSpace (page, save_char_space))
                                     != HPDF_OK)
                         return ret;
@@ -2869,10 +3541,16 @@ InternalTextRect  (HPDF_Page            page,
                 }
         }
 
-        if (InternalShowTextNextLine (page, ptr, tmp_len) != HPDF_OK)
+        /* the same as HPDF_Page_TextWidth of the rest of the text */
+        tw = 0;
+        tw += attr->gstate->word_space * rest.numspace;
+        tw += rest.width * attr->gstate->font_size / 1000;
+        tw += attr->gstate->char_space * rest.numchars;
+
+        if (InternalShowTextNextLine (page, ptr, tmp_len, tw) != HPDF_OK)
             return HPDF_CheckError (page->error);
 
-        if (num_rest <= 0)
+        if (next == layout->num_units)
             break;
 
         if (!force && attr->text_pos.y - attr->gstate->text_leading < bottom) {
@@ -2880,7 +3558,12 @@ InternalTextRect  (HPDF_Page            page,
             break;
         }
 
-        ptr += line_len;
+        line = HPDF_TextLayout_TextWidth (layout, first, next);
+        rest.width -= line.width;
+        rest.numchars -= line.numchars;
+        rest.numspace -= line.numspace;
+
+        first = next;
     }
 
     if (char_space_changed && save_char_space != attr->gstate->char_space) {
@@ -2898,54 +3581,22 @@ InternalTextRect  (HPDF_Page            page,
 static HPDF_STATUS
 InternalShowTextNextLine  (HPDF_Page    page,
                            const char  *text,
-                           HPDF_UINT    len)
+                           HPDF_UINT    len,
+                           HPDF_REAL    tw)
 {
     HPDF_STATUS ret;
     HPDF_PageAttr attr;
-    HPDF_REAL tw;
-    HPDF_FontAttr font_attr;
 
     HPDF_PTRACE ((" ShowTextNextLine\n"));
 
     attr = (HPDF_PageAttr)page->attr;
-    font_attr = (HPDF_FontAttr)attr->gstate->font->attr;
-
-    if (font_attr->type == HPDF_FONT_TYPE0_TT ||
-            font_attr->type == HPDF_FONT_TYPE0_CID) {
-        HPDF_Encoder encoder = font_attr->encoder;
-
-        if ((ret = HPDF_Stream_WriteStr (attr->stream, "<")) != HPDF_OK)
-            return ret;
-
-        if (encoder->encode_text_fn == NULL) {
-	    if ((ret = HPDF_Stream_WriteBinary (attr->stream, (HPDF_BYTE *)text,
-						len, NULL))
-		!= HPDF_OK)
-	        return ret;
-        } else {
-	    char *encoded;
-	    HPDF_UINT length;
-
-	    encoded = (encoder->encode_text_fn)(encoder, text, len, &length);
-	    ret = HPDF_Stream_WriteBinary (attr->stream, (HPDF_BYTE *)encoded,
-					   length, NULL);
-	    free(encoded);
-
-	    if (ret != HPDF_OK)
-	        return ret;
-        }
 
-        if ((ret = HPDF_Stream_WriteStr (attr->stream, ">")) != HPDF_OK)
-            return ret;
-    } else  if ((ret = HPDF_Stream_WriteEscapeText2 (attr->stream, text,
-                len)) != HPDF_OK)
+    if ((ret = InternalWriteText (attr, text, len)) != HPDF_OK)
         return ret;
 
     if ((ret = HPDF_Stream_WriteStr (attr->stream, " \'\012")) != HPDF_OK)
         return ret;
 
-    tw = HPDF_Page_TextWidth (page, text);
-
     /* calculate the reference point of text */
     attr->text_matrix.x -= attr->gstate->text_leading * attr->text_matrix.c;
     attr->text_matrix.y -= attr->gstate->text_leading * attr->text_matrix.d;
@@ -3117,6 +3768,14 @@ HPDF_Page_New_Content_Stream  (HPDF_Page page,
     attr = (HPDF_PageAttr)page->attr;
     filter = attr->contents->filter;
 
+    /* the current stream is finished, nothing is appended to it anymore */
+    if (attr->optimization_mode & HPDF_OPTIMIZE_PEEPHOLE) {
+        HPDF_STATUS opt_ret = InternalOptimizeStream (page, attr->stream);
+
+        if (opt_ret != HPDF_OK)
+            return opt_ret;
+    }
+
     /* check if there is already an array of contents */
     contents_array = (HPDF_Array) HPDF_Dict_GetItem(page,"Contents", HPDF_OCLASS_ARRAY);
     if (!contents_array) {
@@ -3138,6 +3797,10 @@ HPDF_Page_New_Content_Stream  (HPDF_Page page,
     if (!attr->contents)
         return HPDF_Error_GetCode (page->error);
 
+    /* the new stream may be shared with other pages, where the state set
+       by the previous streams of this page is not in effect */
+    HPDF_GState_Invalidate (attr->gstate);
+
     ret += HPDF_Array_Add (contents_array,attr->contents);
 
     /* return the value of the new stream, so that
@@ -3199,9 +3862,520 @@ HPDF_Page_WriteComment  (HPDF_Page    page,
 
     if (HPDF_Stream_WriteStr (attr->stream, text) != HPDF_OK)
         return HPDF_CheckError (page->error);
+
+    /* the text is not parsed, it might change any state parameter */
+    HPDF_GState_Invalidate (attr->gstate);
+
     return HPDF_OK;
 }
 
+/*----------------------------------------------------------------------------*/
+/*----- content stream peephole optimizer ------------------------------------*/
+
+/* The optimizer reads back a content stream written by the functions above
+ * and rewrites it into an equivalent, shorter operator sequence:
+ *   - "q" immediately followed by "Q" is removed, and so is a pair
+ *     left empty by removing the pairs nested in it ("q q Q Q").
+ *   - consecutive "Td" operators are merged into one.
+ *   - a run of "Tj" and "TJ" operators is merged into a single "TJ".
+ * Content it does not understand (e.g. inline images written by
+ * HPDF_Page_WriteComment) leaves the stream unchanged.
+ */
+
+#define HPDF_PEEPHOLE_NONE       0
+#define HPDF_PEEPHOLE_TD         1
+#define HPDF_PEEPHOLE_TD_MERGED  2
+#define HPDF_PEEPHOLE_SHOW       3
+#define HPDF_PEEPHOLE_SHOW_RUN   4
+
+/* Td operands are summed as fixed point numbers with 5 decimal places */
+#define HPDF_PEEPHOLE_FIXED_ONE  100000
+#define HPDF_PEEPHOLE_FIXED_MAX  1000000000
+
+typedef struct _HPDF_Peephole_Rec {
+    const HPDF_BYTE  *src;
+    HPDF_BYTE        *out;
+    HPDF_UINT         out_len;
+    HPDF_UINT         out_siz;
+    HPDF_BOOL         overflow;
+    HPDF_UINT         trailing_q;
+    HPDF_UINT         pending;
+    HPDF_UINT         op_start;
+    HPDF_UINT         op_end;
+    HPDF_UINT         arg_start;
+    HPDF_UINT         arg_end;
+    HPDF_INT32        tx;
+    HPDF_INT32        ty;
+} HPDF_Peephole_Rec;
+
+
+static HPDF_BOOL
+PeepholeIsRegular  (HPDF_BYTE  c)
+{
+    return !(HPDF_IS_WHITE_SPACE(c) || c == '(' || c == ')' || c == '<' ||
+            c == '>' || c == '[' || c == ']' || c == '{' || c == '}' ||
+            c == '/' || c == '%');
+}
+
+
+static void
+PeepholeWrite  (HPDF_Peephole_Rec  *ph,
+                const void         *data,
+                HPDF_UINT           len)
+{
+    if (ph->out_len + len > ph->out_siz) {
+        ph->overflow = HPDF_TRUE;
+        return;
+    }
+
+    HPDF_MemCpy (ph->out + ph->out_len, (const HPDF_BYTE *)data, len);
+    ph->out_len += len;
+    ph->trailing_q = 0;
+}
+
+
+/* writes an operator with its operands as found in the source */
+static void
+PeepholeWriteOp  (HPDF_Peephole_Rec  *ph,
+                  HPDF_UINT           start,
+                  HPDF_UINT           end)
+{
+    PeepholeWrite (ph, ph->src + start, end - start);
+    PeepholeWrite (ph, "\012", 1);
+}
+
+
+static void
+PeepholeWriteFixed  (HPDF_Peephole_Rec  *ph,
+                     HPDF_INT32          val)
+{
+    char buf[HPDF_REAL_LEN + 1];
+    char *pbuf = buf;
+    char *eptr = buf + HPDF_REAL_LEN;
+    HPDF_INT32 fpart;
+    HPDF_INT i;
+
+    if (val < 0) {
+        *pbuf++ = '-';
+        val = -val;
+    }
+
+    pbuf = HPDF_IToA (pbuf, val / HPDF_PEEPHOLE_FIXED_ONE, eptr);
+    fpart = val % HPDF_PEEPHOLE_FIXED_ONE;
+    if (fpart > 0) {
+        *pbuf++ = '.';
+        for (i = HPDF_MAX_DECIMAL_PLACES - 1; i >= 0; i--) {
+            pbuf[i] = (char)((char)(fpart % 10) + '0');
+            fpart /= 10;
+        }
+        pbuf += HPDF_MAX_DECIMAL_PLACES;
+        while (pbuf[-1] == '0')
+            pbuf--;
+    }
+
+    PeepholeWrite (ph, buf, (HPDF_UINT)(pbuf - buf));
+}
+
+
+/* appends the elements of a show operator to the open TJ array */
+static void
+PeepholeWriteShowItems  (HPDF_Peephole_Rec  *ph,
+                         HPDF_UINT           start,
+                         HPDF_UINT           end)
+{
+    /* the operand of TJ is an array, only its elements are copied */
+    if (ph->src[start] == '[') {
+        start++;
+        end--;
+        while (start < end && HPDF_IS_WHITE_SPACE(ph->src[start]))
+            start++;
+        while (start < end && HPDF_IS_WHITE_SPACE(ph->src[end - 1]))
+            end--;
+    }
+
+    if (start == end)
+        return;
+
+    if (ph->out_len > 0 && PeepholeIsRegular (ph->out[ph->out_len - 1]) &&
+            PeepholeIsRegular (ph->src[start]))
+        PeepholeWrite (ph, " ", 1);
+
+    PeepholeWrite (ph, ph->src + start, end - start);
+}
+
+
+static void
+PeepholeFlush  (HPDF_Peephole_Rec  *ph)
+{
+    switch (ph->pending) {
+        case HPDF_PEEPHOLE_TD:
+        case HPDF_PEEPHOLE_SHOW:
+            PeepholeWriteOp (ph, ph->op_start, ph->op_end);
+            break;
+        case HPDF_PEEPHOLE_TD_MERGED:
+            PeepholeWriteFixed (ph, ph->tx);
+            PeepholeWrite (ph, " ", 1);
+            PeepholeWriteFixed (ph, ph->ty);
+            PeepholeWrite (ph, " Td\012", 4);
+            break;
+        case HPDF_PEEPHOLE_SHOW_RUN:
+            PeepholeWrite (ph, "] TJ\012", 5);
+            break;
+        default:
+            break;
+    }
+
+    ph->pending = HPDF_PEEPHOLE_NONE;
+}
+
+
+/* parses a number written by HPDF_FToA2 or HPDF_IToA into fixed point */
+static HPDF_BOOL
+PeepholeParseFixed  (const HPDF_BYTE  *s,
+                     HPDF_UINT         len,
+                     HPDF_INT32       *val)
+{
+    HPDF_BOOL minus = HPDF_FALSE;
+    HPDF_INT32 v = 0;
+    HPDF_UINT places = 0;
+    HPDF_UINT digits = 0;
+    HPDF_UINT i = 0;
+
+    if (i < len && (s[i] == '-' || s[i] == '+'))
+        minus = (s[i++] == '-');
+
+    for (; i < len && s[i] >= '0' && s[i] <= '9'; i++, digits++) {
+        if (v >= HPDF_PEEPHOLE_FIXED_MAX / HPDF_PEEPHOLE_FIXED_ONE / 10)
+            return HPDF_FALSE;
+        v = v * 10 + (s[i] - '0');
+    }
+
+    if (i < len && s[i] == '.') {
+        for (i++; i < len && s[i] >= '0' && s[i] <= '9'; i++, digits++) {
+            if (places == HPDF_MAX_DECIMAL_PLACES)
+                return HPDF_FALSE;
+            v = v * 10 + (s[i] - '0');
+            places++;
+        }
+    }
+
+    if (i != len || digits == 0)
+        return HPDF_FALSE;
+
+    for (; places < HPDF_MAX_DECIMAL_PLACES; places++)
+        v *= 10;
+
+    *val = minus ? -v : v;
+
+    return HPDF_TRUE;
+}
+
+
+static void
+PeepholeTd  (HPDF_Peephole_Rec  *ph,
+             HPDF_UINT           op_start,
+             HPDF_UINT           op_end,
+             HPDF_INT32          tx,
+             HPDF_INT32          ty)
+{
+    if (ph->pending == HPDF_PEEPHOLE_TD ||
+            ph->pending == HPDF_PEEPHOLE_TD_MERGED) {
+        HPDF_INT32 sx = ph->tx + tx;
+        HPDF_INT32 sy = ph->ty + ty;
+
+        if (sx < HPDF_PEEPHOLE_FIXED_MAX && sx > -HPDF_PEEPHOLE_FIXED_MAX &&
+                sy < HPDF_PEEPHOLE_FIXED_MAX && sy > -HPDF_PEEPHOLE_FIXED_MAX) {
+            ph->tx = sx;
+            ph->ty = sy;
+            ph->pending = HPDF_PEEPHOLE_TD_MERGED;
+            return;
+        }
+    }
+
+    PeepholeFlush (ph);
+    ph->pending = HPDF_PEEPHOLE_TD;
+    ph->op_start = op_start;
+    ph->op_end = op_end;
+    ph->tx = tx;
+    ph->ty = ty;
+}
+
+
+static void
+PeepholeShow  (HPDF_Peephole_Rec  *ph,
+               HPDF_UINT           op_start,
+               HPDF_UINT           op_end,
+               HPDF_UINT           arg_start,
+               HPDF_UINT           arg_end)
+{
+    if (ph->pending == HPDF_PEEPHOLE_SHOW) {
+        PeepholeWrite (ph, "[", 1);
+        PeepholeWriteShowItems (ph, ph->arg_start, ph->arg_end);
+        ph->pending = HPDF_PEEPHOLE_SHOW_RUN;
+    }
+
+    if (ph->pending == HPDF_PEEPHOLE_SHOW_RUN) {
+        PeepholeWriteShowItems (ph, arg_start, arg_end);
+        return;
+    }
+
+    PeepholeFlush (ph);
+    ph->pending = HPDF_PEEPHOLE_SHOW;
+    ph->op_start = op_start;
+    ph->op_end = op_end;
+    ph->arg_start = arg_start;
+    ph->arg_end = arg_end;
+}
+
+
+#define HPDF_PEEPHOLE_IS_OP(s, len, name) \
+    (len == sizeof(name) - 1 && HPDF_MemCmp (s, (HPDF_BYTE *)name, len) == 0)
+
+/* rewrites src into ph->out, returns HPDF_FALSE when the content cannot be
+ * parsed.
+ */
+static HPDF_BOOL
+PeepholeRun  (HPDF_Peephole_Rec  *ph,
+              HPDF_UINT           len)
+{
+    const HPDF_BYTE *src = ph->src;
+    HPDF_UINT pos = 0;
+    HPDF_UINT depth = 0;
+    HPDF_UINT nargs = 0;
+    HPDF_UINT op_start = 0;
+    HPDF_UINT arg_start[2];
+    HPDF_UINT arg_end[2];
+
+    while (pos < len) {
+        HPDF_BYTE c = src[pos];
+        HPDF_UINT tok_start = pos;
+        HPDF_UINT tok_depth = depth;
+
+        if (HPDF_IS_WHITE_SPACE(c)) {
+            pos++;
+            continue;
+        }
+
+        if (c == '%') {
+            /* comments are kept, but nothing is merged across them */
+            if (nargs > 0 || depth > 0)
+                return HPDF_FALSE;
+            while (pos < len && src[pos] != 0x0A && src[pos] != 0x0D)
+                pos++;
+            PeepholeFlush (ph);
+            PeepholeWriteOp (ph, tok_start, pos);
+            continue;
+        }
+
+        if (c == '(') {
+            HPDF_UINT level = 1;
+
+            pos++;
+            while (pos < len && level > 0) {
+                if (src[pos] == '\\')
+                    pos++;
+                else if (src[pos] == '(')
+                    level++;
+                else if (src[pos] == ')')
+                    level--;
+                pos++;
+            }
+            if (level > 0)
+                return HPDF_FALSE;
+        } else if (c == '<' && pos + 1 < len && src[pos + 1] == '<') {
+            depth++;
+            pos += 2;
+        } else if (c == '<') {
+            while (pos < len && src[pos] != '>')
+                pos++;
+            if (pos == len)
+                return HPDF_FALSE;
+            pos++;
+        } else if (c == '>' && pos + 1 < len && src[pos + 1] == '>') {
+            if (depth == 0)
+                return HPDF_FALSE;
+            depth--;
+            pos += 2;
+        } else if (c == '[') {
+            depth++;
+            pos++;
+        } else if (c == ']') {
+            if (depth == 0)
+                return HPDF_FALSE;
+            depth--;
+            pos++;
+        } else if (c == '/') {
+            pos++;
+            while (pos < len && PeepholeIsRegular (src[pos]))
+                pos++;
+        } else if (PeepholeIsRegular (c)) {
+            while (pos < len && PeepholeIsRegular (src[pos]))
+                pos++;
+
+            if (depth == 0 && !(c == '+' || c == '-' || c == '.' ||
+                    (c >= '0' && c <= '9')) &&
+                    !HPDF_PEEPHOLE_IS_OP(src + tok_start, pos - tok_start,
+                        "true") &&
+                    !HPDF_PEEPHOLE_IS_OP(src + tok_start, pos - tok_start,
+                        "false") &&
+                    !HPDF_PEEPHOLE_IS_OP(src + tok_start, pos - tok_start,
+                        "null")) {
+                const HPDF_BYTE *op = src + tok_start;
+                HPDF_UINT op_len = pos - tok_start;
+                HPDF_INT32 tx;
+                HPDF_INT32 ty;
+
+                if (nargs == 0)
+                    op_start = tok_start;
+
+                if (HPDF_PEEPHOLE_IS_OP(op, op_len, "ID"))
+                    /* inline image data cannot be tokenized */
+                    return HPDF_FALSE;
+                else if (HPDF_PEEPHOLE_IS_OP(op, op_len, "q") && nargs == 0) {
+                    HPDF_UINT trailing_q;
+
+                    PeepholeFlush (ph);
+                    /* PeepholeWrite forgets the "q"s already at the end */
+                    trailing_q = ph->trailing_q;
+                    PeepholeWrite (ph, "q\012", 2);
+                    if (!ph->overflow)
+                        ph->trailing_q = trailing_q + 1;
+                } else if (HPDF_PEEPHOLE_IS_OP(op, op_len, "Q") &&
+                        nargs == 0) {
+                    PeepholeFlush (ph);
+                    if (ph->trailing_q > 0) {
+                        /* drop the "q\012" written last */
+                        ph->out_len -= 2;
+                        ph->trailing_q--;
+                    } else
+                        PeepholeWrite (ph, "Q\012", 2);
+                } else if (HPDF_PEEPHOLE_IS_OP(op, op_len, "Td") &&
+                        nargs == 2 &&
+                        PeepholeParseFixed (src + arg_start[0],
+                            arg_end[0] - arg_start[0], &tx) &&
+                        PeepholeParseFixed (src + arg_start[1],
+                            arg_end[1] - arg_start[1], &ty)) {
+                    PeepholeTd (ph, op_start, pos, tx, ty);
+                } else if (nargs == 1 &&
+                        ((HPDF_PEEPHOLE_IS_OP(op, op_len, "Tj") &&
+                        (src[arg_start[0]] == '(' || src[arg_start[0]] == '<'))
+                        || (HPDF_PEEPHOLE_IS_OP(op, op_len, "TJ") &&
+                        src[arg_start[0]] == '['))) {
+                    PeepholeShow (ph, op_start, pos, arg_start[0],
+                            arg_end[0]);
+                } else {
+                    PeepholeFlush (ph);
+                    PeepholeWriteOp (ph, op_start, pos);
+                }
+
+                nargs = 0;
+                continue;
+            }
+        } else
+            return HPDF_FALSE;
+
+        /* record the extent of the operands at the top level */
+        if (tok_depth == 0) {
+            if (nargs == 0)
+                op_start = tok_start;
+            if (nargs < 2)
+                arg_start[nargs] = tok_start;
+        }
+        if (depth == 0) {
+            if (nargs < 2)
+                arg_end[nargs] = pos;
+            nargs++;
+        }
+    }
+
+    if (nargs > 0 || depth > 0)
+        return HPDF_FALSE;
+
+    PeepholeFlush (ph);
+
+    return !ph->overflow;
+}
+
+
+static HPDF_STATUS
+InternalOptimizeStream  (HPDF_Page    page,
+                         HPDF_Stream  stream)
+{
+    HPDF_PageAttr attr = (HPDF_PageAttr)page->attr;
+    HPDF_Peephole_Rec ph;
+    HPDF_BYTE *src;
+    HPDF_UINT size = HPDF_Stream_Size (stream);
+    HPDF_UINT count = HPDF_MemStream_GetBufCount (stream);
+    HPDF_UINT pos = 0;
+    HPDF_UINT i;
+
+    if (size == 0 || stream->type != HPDF_STREAM_MEMORY)
+        return HPDF_OK;
+
+    src = HPDF_GetMem (page->mmgr, size * 2);
+    if (!src)
+        return HPDF_Error_GetCode (page->error);
+
+    for (i = 0; i < count; i++) {
+        HPDF_UINT len;
+        HPDF_BYTE *buf = HPDF_MemStream_GetBufPtr (stream, i, &len);
+
+        HPDF_MemCpy (src + pos, buf, len);
+        pos += len;
+    }
+
+    HPDF_MemSet (&ph, 0, sizeof(HPDF_Peephole_Rec));
+    ph.src = src;
+    ph.out = src + size;
+    ph.out_siz = size;
+
+    /* the stream is only replaced if the result is shorter */
+    if (PeepholeRun (&ph, size) && ph.out_len < size) {
+        HPDF_MemStream_FreeData (stream);
+        if (HPDF_Stream_Write (stream, ph.out, ph.out_len) != HPDF_OK) {
+            HPDF_FreeMem (page->mmgr, src);
+            return HPDF_CheckError (page->error);
+        }
+        attr->optimized_bytes += size - ph.out_len;
+    }
+
+    HPDF_FreeMem (page->mmgr, src);
+
+    return HPDF_OK;
+}
+
+
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_Page_OptimizeContents  (HPDF_Page  page)
+{
+    HPDF_PageAttr attr;
+
+    HPDF_PTRACE((" HPDF_Page_OptimizeContents\n"));
+
+    if (!HPDF_Page_Validate (page))
+        return HPDF_INVALID_PAGE;
+
+    attr = (HPDF_PageAttr)page->attr;
+
+    return InternalOptimizeStream (page, attr->stream);
+}
+
+
+HPDF_EXPORT(HPDF_UINT)
+HPDF_Page_GetOptimizedBytes  (HPDF_Page  page)
+{
+    HPDF_PageAttr attr;
+
+    HPDF_PTRACE((" HPDF_Page_GetOptimizedBytes\n"));
+
+    if (!HPDF_Page_Validate (page))
+        return 0;
+
+    attr = (HPDF_PageAttr)page->attr;
+
+    return attr->optimized_bytes;
+}
+
 /*
  * Inserts a form text field.
  * Parameter:
@@ -3530,7 +4704,7 @@ HPDF_Page_TextField  (HPDF_Page      page,
         }
 
         HPDF_REAL y_offset = field_height - padding / 2.0;
-        ret += InternalTextRect (fake_page, padding, y_offset, field_width - padding, 0, encoded_text, talign, NULL, HPDF_TRUE, HPDF_FALSE);
+        ret += InternalTextRect (fake_page, padding, y_offset, field_width - padding, 0, encoded_text, HPDF_StrLen (encoded_text, HPDF_LIMIT_MAX_STRING_LEN + 1), talign, NULL, HPDF_TRUE, HPDF_FALSE);
     } else {
         HPDF_REAL ascent = (HPDF_REAL)HPDF_Font_GetAscent (font) / 1000.0 * font_size;
         HPDF_REAL descent = (HPDF_REAL)HPDF_Font_GetDescent (font) / 1000.0 * font_size;
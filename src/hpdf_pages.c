@@ -261,6 +261,11 @@ Page_BeforeWrite  (HPDF_Dict    obj)
                 return ret;
         }
 
+    if (attr->optimization_mode & HPDF_OPTIMIZE_PEEPHOLE) {
+        if ((ret = HPDF_Page_OptimizeContents (page)) != HPDF_OK)
+            return ret;
+    }
+
     return HPDF_OK;
 }
 
@@ -1028,16 +1033,30 @@ AddAnnotation  (HPDF_Page        page,
 HPDF_EXPORT(HPDF_REAL)
 HPDF_Page_TextWidth  (HPDF_Page        page,
                       const char      *text)
+{
+    return HPDF_Page_TextWidthLen (page, text,
+            HPDF_StrLen (text, HPDF_LIMIT_MAX_STRING_LEN));
+}
+
+
+HPDF_EXPORT(HPDF_REAL)
+HPDF_Page_TextWidthLen  (HPDF_Page        page,
+                         const char      *text,
+                         HPDF_UINT        len)
 {
     HPDF_PageAttr attr;
     HPDF_TextWidth tw;
     HPDF_REAL ret = 0;
-    HPDF_UINT len = HPDF_StrLen(text, HPDF_LIMIT_MAX_STRING_LEN + 1);
 
     HPDF_PTRACE((" HPDF_Page_TextWidth\n"));
 
-    if (!HPDF_Page_Validate (page) || len == 0)
+    if (!HPDF_Page_Validate (page) || !text || len == 0)
+        return 0;
+
+    if (len > HPDF_LIMIT_MAX_STRING_LEN) {
+        HPDF_RaiseError (page->error, HPDF_STRING_OUT_OF_RANGE, 0);
         return 0;
+    }
 
     attr = (HPDF_PageAttr )page->attr;
 
@@ -1065,14 +1084,32 @@ HPDF_Page_MeasureText  (HPDF_Page          page,
                         HPDF_REAL          width,
                         HPDF_BOOL          wordwrap,
                         HPDF_REAL         *real_width)
+{
+    return HPDF_Page_MeasureTextLen (page, text,
+            HPDF_StrLen (text, HPDF_LIMIT_MAX_STRING_LEN), width,
+            wordwrap, real_width);
+}
+
+
+HPDF_EXPORT(HPDF_UINT)
+HPDF_Page_MeasureTextLen  (HPDF_Page          page,
+                           const char        *text,
+                           HPDF_UINT          len,
+                           HPDF_REAL          width,
+                           HPDF_BOOL          wordwrap,
+                           HPDF_REAL         *real_width)
 {
     HPDF_PageAttr attr;
-    HPDF_UINT len = HPDF_StrLen(text, HPDF_LIMIT_MAX_STRING_LEN + 1);
     HPDF_UINT ret;
 
-    if (!HPDF_Page_Validate (page) || len == 0)
+    if (!HPDF_Page_Validate (page) || !text || len == 0)
         return 0;
 
+    if (len > HPDF_LIMIT_MAX_STRING_LEN) {
+        HPDF_RaiseError (page->error, HPDF_STRING_OUT_OF_RANGE, 0);
+        return 0;
+    }
+
     attr = (HPDF_PageAttr )page->attr;
 
     HPDF_PTRACE((" HPDF_Page_MeasureText\n"));
@@ -2425,3 +2462,15 @@ HPDF_Page_SetTextPlacementAccuracy  (HPDF_Page    page,
     attr = (HPDF_PageAttr)page->attr;
     attr->text_placement_accuracy = decimal_places;
 }
+
+void
+HPDF_Page_SetOptimizationMode  (HPDF_Page    page,
+                                HPDF_UINT    mode)
+{
+    HPDF_PageAttr attr;
+
+    HPDF_PTRACE((" HPDF_Page_SetOptimizationMode\n"));
+
+    attr = (HPDF_PageAttr)page->attr;
+    attr->optimization_mode = mode;
+}
@@ -35,6 +35,14 @@
 #include <zconf.h>
 #endif /* LIBHPDF_HAVE_NOZLIB */
 
+#ifdef LIBHPDF_HAVE_SYS_MMAN_H
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif /* LIBHPDF_HAVE_SYS_MMAN_H */
+
 HPDF_STATUS
 HPDF_MemStream_WriteFunc  (HPDF_Stream      stream,
                            const HPDF_BYTE  *ptr,
@@ -104,6 +112,30 @@ void
 HPDF_FileStream_FreeFunc  (HPDF_Stream  stream);
 
 
+HPDF_STATUS
+HPDF_BufferReader_ReadFunc  (HPDF_Stream  stream,
+                             HPDF_BYTE    *ptr,
+                             HPDF_UINT    *siz);
+
+
+HPDF_STATUS
+HPDF_BufferReader_SeekFunc  (HPDF_Stream      stream,
+                             HPDF_INT         pos,
+                             HPDF_WhenceMode  mode);
+
+
+HPDF_INT32
+HPDF_BufferReader_TellFunc  (HPDF_Stream  stream);
+
+
+HPDF_UINT32
+HPDF_BufferReader_SizeFunc  (HPDF_Stream  stream);
+
+
+void
+HPDF_BufferReader_FreeFunc  (HPDF_Stream  stream);
+
+
 
 /*
  *  HPDF_Stream_Read
@@ -1000,6 +1032,236 @@ HPDF_FileStream_FreeFunc  (HPDF_Stream  stream)
     stream->attr = NULL;
 }
 
+HPDF_Stream
+HPDF_BufferReader_New  (HPDF_MMgr         mmgr,
+                        const HPDF_BYTE  *buf,
+                        HPDF_UINT         size)
+{
+    HPDF_Stream stream;
+    HPDF_BufferReaderAttr attr;
+
+    HPDF_PTRACE((" HPDF_BufferReader_New\n"));
+
+    if (!buf && size > 0) {
+        HPDF_SetError (mmgr->error, HPDF_INVALID_PARAMETER, 0);
+        return NULL;
+    }
+
+    stream = (HPDF_Stream)HPDF_GetMem (mmgr, sizeof(HPDF_Stream_Rec));
+    if (!stream)
+        return NULL;
+
+    attr = (HPDF_BufferReaderAttr)HPDF_GetMem (mmgr,
+            sizeof(HPDF_BufferReaderAttr_Rec));
+    if (!attr) {
+        HPDF_FreeMem (mmgr, stream);
+        return NULL;
+    }
+
+    HPDF_MemSet (stream, 0, sizeof(HPDF_Stream_Rec));
+    HPDF_MemSet (attr, 0, sizeof(HPDF_BufferReaderAttr_Rec));
+
+    attr->buf = buf;
+    attr->size = size;
+
+    stream->sig_bytes = HPDF_STREAM_SIG_BYTES;
+    stream->type = HPDF_STREAM_BUFFER;
+    stream->error = mmgr->error;
+    stream->mmgr = mmgr;
+    stream->read_fn = HPDF_BufferReader_ReadFunc;
+    stream->seek_fn = HPDF_BufferReader_SeekFunc;
+    stream->tell_fn = HPDF_BufferReader_TellFunc;
+    stream->size_fn = HPDF_BufferReader_SizeFunc;
+    stream->free_fn = HPDF_BufferReader_FreeFunc;
+    stream->attr = attr;
+
+    return stream;
+}
+
+
+HPDF_Stream
+HPDF_MappedFileReader_New  (HPDF_MMgr    mmgr,
+                            const char  *fname)
+{
+    HPDF_Stream stream;
+    HPDF_BufferReaderAttr attr;
+#ifdef LIBHPDF_HAVE_SYS_MMAN_H
+    struct stat st;
+    void *map = NULL;
+    int fd;
+
+    HPDF_PTRACE((" HPDF_MappedFileReader_New\n"));
+
+    fd = open (fname, O_RDONLY);
+    if (fd < 0) {
+        HPDF_SetError (mmgr->error, HPDF_FILE_OPEN_ERROR, errno);
+        return NULL;
+    }
+
+    if (fstat (fd, &st) != 0 || st.st_size > (off_t)HPDF_LIMIT_MAX_INT) {
+        HPDF_SetError (mmgr->error, HPDF_FILE_IO_ERROR, errno);
+        close (fd);
+        return NULL;
+    }
+
+    /* an empty file can not be mapped, it is read as an empty buffer */
+    if (st.st_size > 0) {
+        map = mmap (NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            HPDF_SetError (mmgr->error, HPDF_FILE_IO_ERROR, errno);
+            close (fd);
+            return NULL;
+        }
+    }
+
+    /* the mapping stays valid after the file is closed */
+    close (fd);
+
+    stream = HPDF_BufferReader_New (mmgr, (HPDF_BYTE *)map,
+            (HPDF_UINT)st.st_size);
+    if (!stream) {
+        if (map)
+            munmap (map, (size_t)st.st_size);
+        return NULL;
+    }
+
+    attr = (HPDF_BufferReaderAttr)stream->attr;
+    attr->mapped = HPDF_TRUE;
+#else
+    HPDF_Stream file;
+    HPDF_BYTE *buf = NULL;
+    HPDF_UINT size;
+
+    HPDF_PTRACE((" HPDF_MappedFileReader_New\n"));
+
+    file = HPDF_FileReader_New (mmgr, fname);
+    if (!file)
+        return NULL;
+
+    size = HPDF_Stream_Size (file);
+    if (size > 0) {
+        HPDF_UINT len = size;
+
+        buf = (HPDF_BYTE *)HPDF_GetMem (mmgr, size);
+        if (!buf || HPDF_Stream_Read (file, buf, &len) != HPDF_OK) {
+            if (buf)
+                HPDF_FreeMem (mmgr, buf);
+            HPDF_Stream_Free (file);
+            return NULL;
+        }
+    }
+
+    HPDF_Stream_Free (file);
+
+    stream = HPDF_BufferReader_New (mmgr, buf, size);
+    if (!stream) {
+        if (buf)
+            HPDF_FreeMem (mmgr, buf);
+        return NULL;
+    }
+
+    attr = (HPDF_BufferReaderAttr)stream->attr;
+    attr->own_buf = buf;
+#endif /* LIBHPDF_HAVE_SYS_MMAN_H */
+
+    return stream;
+}
+
+
+HPDF_STATUS
+HPDF_BufferReader_ReadFunc  (HPDF_Stream  stream,
+                             HPDF_BYTE    *ptr,
+                             HPDF_UINT    *siz)
+{
+    HPDF_BufferReaderAttr attr = (HPDF_BufferReaderAttr)stream->attr;
+    HPDF_UINT rsiz = attr->size - attr->pos;
+
+    HPDF_PTRACE((" HPDF_BufferReader_ReadFunc\n"));
+
+    if (rsiz >= *siz) {
+        HPDF_MemCpy (ptr, attr->buf + attr->pos, *siz);
+        attr->pos += *siz;
+        return HPDF_OK;
+    }
+
+    /* the rest of the buffer is filled with zeros like HPDF_FileReader */
+    HPDF_MemCpy (ptr, attr->buf + attr->pos, rsiz);
+    HPDF_MemSet (ptr + rsiz, 0, *siz - rsiz);
+    attr->pos = attr->size;
+    *siz = rsiz;
+
+    return HPDF_STREAM_EOF;
+}
+
+
+HPDF_STATUS
+HPDF_BufferReader_SeekFunc  (HPDF_Stream      stream,
+                             HPDF_INT         pos,
+                             HPDF_WhenceMode  mode)
+{
+    HPDF_BufferReaderAttr attr = (HPDF_BufferReaderAttr)stream->attr;
+
+    HPDF_PTRACE((" HPDF_BufferReader_SeekFunc\n"));
+
+    if (mode == HPDF_SEEK_CUR)
+        pos += attr->pos;
+    else if (mode == HPDF_SEEK_END)
+        pos += attr->size;
+
+    if (pos < 0 || pos > (HPDF_INT)attr->size)
+        return HPDF_SetError (stream->error, HPDF_STREAM_EOF, 0);
+
+    attr->pos = pos;
+
+    return HPDF_OK;
+}
+
+
+HPDF_INT32
+HPDF_BufferReader_TellFunc  (HPDF_Stream  stream)
+{
+    HPDF_BufferReaderAttr attr = (HPDF_BufferReaderAttr)stream->attr;
+
+    HPDF_PTRACE((" HPDF_BufferReader_TellFunc\n"));
+
+    return attr->pos;
+}
+
+
+HPDF_UINT32
+HPDF_BufferReader_SizeFunc  (HPDF_Stream  stream)
+{
+    HPDF_BufferReaderAttr attr = (HPDF_BufferReaderAttr)stream->attr;
+
+    HPDF_PTRACE((" HPDF_BufferReader_SizeFunc\n"));
+
+    return attr->size;
+}
+
+
+void
+HPDF_BufferReader_FreeFunc  (HPDF_Stream  stream)
+{
+    HPDF_BufferReaderAttr attr = (HPDF_BufferReaderAttr)stream->attr;
+
+    HPDF_PTRACE((" HPDF_BufferReader_FreeFunc\n"));
+
+    if (!attr)
+        return;
+
+#ifdef LIBHPDF_HAVE_SYS_MMAN_H
+    if (attr->mapped && attr->size > 0)
+        munmap ((void *)attr->buf, attr->size);
+#endif
+
+    if (attr->own_buf)
+        HPDF_FreeMem (stream->mmgr, attr->own_buf);
+
+    HPDF_FreeMem (stream->mmgr, attr);
+    stream->attr = NULL;
+}
+
+
 HPDF_STATUS
 HPDF_MemStream_InWrite  (HPDF_Stream      stream,
                          const HPDF_BYTE  **ptr,
@@ -174,11 +174,9 @@ HPDF_String_Write  (HPDF_String   obj,
     } else {
         HPDF_BYTE* src = obj->value;
         HPDF_BYTE buf[HPDF_TEXT_DEFAULT_LEN * 2];
-        HPDF_UINT tmp_len = 0;
-        HPDF_BYTE* pbuf = buf;
-        HPDF_INT32 len = obj->len;
-        HPDF_ParseText_Rec  parse_state;
-        HPDF_UINT i;
+        HPDF_UNICODE unicodes[HPDF_TEXT_DEFAULT_LEN];
+        HPDF_UINT len = obj->len;
+        HPDF_UINT i = 0;
 
         if ((ret = HPDF_Stream_WriteChar (stream, '<')) != HPDF_OK)
            return ret;
@@ -187,47 +185,25 @@ HPDF_String_Write  (HPDF_String   obj,
                         != HPDF_OK)
             return ret;
 
-        HPDF_Encoder_SetParseText (obj->encoder, &parse_state, src, len);
+        while (i < len) {
+            HPDF_UINT num_chars;
+            HPDF_UINT j;
 
-        for (i = 0; (HPDF_INT32)i < len; i++) {
-            HPDF_BYTE b = src[i];
-            HPDF_UNICODE tmp_unicode;
-            HPDF_ByteType btype = HPDF_Encoder_ByteType (obj->encoder,
-                    &parse_state);
+            i += HPDF_Encoder_DecodeText (obj->encoder, NULL, src + i, len - i,
+                    unicodes, NULL, HPDF_TEXT_DEFAULT_LEN, &num_chars);
 
-            if (tmp_len >= HPDF_TEXT_DEFAULT_LEN - 1) {
-                if ((ret = HPDF_Stream_WriteBinary (stream, buf,
-                            tmp_len * 2, e)) != HPDF_OK)
-                    return ret;
-
-                tmp_len = 0;
-                pbuf = buf;
+            for (j = 0; j < num_chars; j++) {
+                buf[j * 2] = (HPDF_BYTE)(unicodes[j] >> 8);
+                buf[j * 2 + 1] = (HPDF_BYTE)unicodes[j];
             }
 
-            if (btype != HPDF_BYTE_TYPE_TRIAL) {
-                if (btype == HPDF_BYTE_TYPE_LEAD) {
-                    HPDF_BYTE b2 = src[i + 1];
-                    HPDF_UINT16 char_code = (HPDF_UINT16)((HPDF_UINT) b * 256 + b2);
-
-                    tmp_unicode = HPDF_Encoder_ToUnicode (obj->encoder,
-                                char_code);
-                } else {
-                    tmp_unicode = HPDF_Encoder_ToUnicode (obj->encoder, b);
-                }
-
-                HPDF_UInt16Swap (&tmp_unicode);
-                HPDF_MemCpy (pbuf, (HPDF_BYTE*)&tmp_unicode, 2);
-                pbuf += 2;
-                tmp_len++;
+            if (num_chars > 0) {
+                if ((ret = HPDF_Stream_WriteBinary (stream, buf,
+                            num_chars * 2, e)) != HPDF_OK)
+                    return ret;
             }
         }
 
-        if (tmp_len > 0) {
-            if ((ret = HPDF_Stream_WriteBinary (stream, buf, tmp_len * 2, e))
-                            != HPDF_OK)
-                return ret;
-        }
-
         if ((ret = HPDF_Stream_WriteChar (stream, '>')) != HPDF_OK)
             return ret;
     }
@@ -186,6 +186,26 @@ HPDF_FToA  (char       *s,
 }
 
 
+/* 0.5 / HPDF_DECIMAL_ROUND_COEFFICIENT[n], i.e. the rounding term for n
+ * decimal places.
+ */
+static const HPDF_REAL HPDF_DECIMAL_ROUND_TERM[] =
+    {0.5f, 0.05f, 0.005f, 0.0005f, 0.00005f, 0.000005f};
+
+/* two-digit lookup table used by HPDF_FToA2 to emit digits in pairs */
+static const char HPDF_DIGIT_PAIRS[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+
 char*
 HPDF_FToA2  (char       *s,
              HPDF_REAL   val,
@@ -194,10 +214,18 @@ HPDF_FToA2  (char       *s,
 {
     HPDF_INT32 int_val;
     HPDF_INT32 fpart_val;
-    char buf[HPDF_REAL_LEN + 1];
-    char* sptr = s;
-    char* t;
-    HPDF_UINT32 i;
+    HPDF_INT32 coefficient;
+    HPDF_REAL round;
+    HPDF_BOOL minus = HPDF_FALSE;
+    /* sign + 10 integer digits + '.' + 5 decimal digits */
+    char buf[HPDF_REAL_LEN * 2];
+    char* end = buf + sizeof(buf);
+    char* t = end;
+    HPDF_UINT i;
+
+    if (decimal_places > HPDF_MAX_DECIMAL_PLACES)
+        decimal_places = HPDF_MAX_DECIMAL_PLACES;
+    coefficient = HPDF_DECIMAL_ROUND_COEFFICIENT[decimal_places];
 
     if (val > HPDF_LIMIT_MAX_REAL)
         val = HPDF_LIMIT_MAX_REAL;
@@ -205,56 +233,72 @@ HPDF_FToA2  (char       *s,
     if (val < HPDF_LIMIT_MIN_REAL)
         val = HPDF_LIMIT_MIN_REAL;
 
-    t = buf + HPDF_REAL_LEN;
-    *t-- = 0;
-
     if (val < 0) {
-        *s++ = '-';
+        minus = HPDF_TRUE;
         val = -val;
     }
 
-    /* separate an integer part and a decimal part. */
-    HPDF_REAL round = 0.5f / HPDF_DECIMAL_ROUND_COEFFICIENT[decimal_places];
-    int_val = (HPDF_INT32)(val + round);
-    fpart_val = (HPDF_INT32)((HPDF_REAL)(val - int_val + round) * HPDF_DECIMAL_ROUND_COEFFICIENT[decimal_places]);
-
-    /* process decimal part */
-    for (i = 0; i < decimal_places; i++) {
-        *t = (char)((char)(fpart_val % 10) + '0');
-        fpart_val /= 10;
-        t--;
+    /* separate an integer part and a decimal part. the arithmetic must stay
+     * in single precision, the rounding of existing documents depends on it.
+     */
+    round = HPDF_DECIMAL_ROUND_TERM[decimal_places];
+    if (val + round >= (HPDF_REAL)HPDF_LIMIT_MAX_INT) {
+        int_val = HPDF_LIMIT_MAX_INT;
+        fpart_val = 0;
+    } else {
+        int_val = (HPDF_INT32)(val + round);
+        fpart_val = (HPDF_INT32)((HPDF_REAL)(val - int_val + round) *
+                coefficient);
+        if (fpart_val < 0)
+            fpart_val = 0;
+        else if (fpart_val >= coefficient)
+            fpart_val %= coefficient;
     }
 
-    /* process integer part */
-    *t-- = '.';
-    *t = '0';
-    if (int_val == 0)
-        t--;
+    /* process decimal part, dropping the trailing zeros */
+    if (fpart_val > 0) {
+        for (i = decimal_places; i >= 2; i -= 2) {
+            t -= 2;
+            t[0] = HPDF_DIGIT_PAIRS[(fpart_val % 100) * 2];
+            t[1] = HPDF_DIGIT_PAIRS[(fpart_val % 100) * 2 + 1];
+            fpart_val /= 100;
+        }
+        if (i == 1)
+            *--t = (char)((char)(fpart_val % 10) + '0');
 
-    while (int_val > 0) {
-        *t = (char)((char)(int_val % 10) + '0');
-        int_val /= 10;
-        t--;
+        while (end[-1] == '0')
+            end--;
+
+        *--t = '.';
     }
 
-    t++;
-    while (s <= eptr && *t != 0)
-        *s++ = *t++;
-    s--;
-
-    /* delete an excessive decimal portion. */
-    while (s > sptr) {
-        if (*s == '0')
-            *s = 0;
-        else {
-            if (*s == '.')
-                *s = 0;
-            break;
-        }
-        s--;
+    /* process integer part */
+    while (int_val >= 100) {
+        t -= 2;
+        t[0] = HPDF_DIGIT_PAIRS[(int_val % 100) * 2];
+        t[1] = HPDF_DIGIT_PAIRS[(int_val % 100) * 2 + 1];
+        int_val /= 100;
+    }
+    if (int_val >= 10) {
+        t -= 2;
+        t[0] = HPDF_DIGIT_PAIRS[int_val * 2];
+        t[1] = HPDF_DIGIT_PAIRS[int_val * 2 + 1];
+    } else
+        *--t = (char)((char)int_val + '0');
+
+    if (minus)
+        *--t = '-';
+
+    if (end - t <= eptr - s) {
+        HPDF_MemCpy ((HPDF_BYTE *)s, (HPDF_BYTE *)t, (HPDF_UINT)(end - t));
+        s += end - t;
+        *s = 0;
+    } else {
+        while (s <= eptr && t < end)
+            *s++ = *t++;
     }
 
-    return (*s == 0) ? s : ++s;
+    return s;
 }
 
 